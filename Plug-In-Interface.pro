@@ -25,4 +25,5 @@ SUBDIRS += PluginOpenGL-Shaders/PluginChip8Opengl.pro
 }
 SUBDIRS += PluginRealTime/PluginRealTime.pro
 SUBDIRS += PluginRobotPilot/PluginRobotPilot.pro
+SUBDIRS += PluginSnapshotDataset/PluginSnapshotDataset.pro
 SUBDIRS += PluginCollisionSensor/PluginCollisionSensor.pro
@@ -85,14 +85,22 @@ CONFIG(release, debug|release) {
 HEADERS += \
     pluginopcua.h \
     opcua_server.h \
+    opcua_requests.h \
+    opcua_robots.h \
+    opcua_history.h \
     opcua_client.h \
+    opcua_pubsub.h \
     formopcsettings.h \
     opcua_tools.h
 
 SOURCES += \
     pluginopcua.cpp \
     opcua_server.cpp \
+    opcua_requests.cpp \
+    opcua_robots.cpp \
+    opcua_history.cpp \
     opcua_client.cpp \
+    opcua_pubsub.cpp \
     formopcsettings.cpp \
     opcua_tools.cpp
 
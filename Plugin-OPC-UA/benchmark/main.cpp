@@ -0,0 +1,236 @@
+// Throughput and latency benchmark of the RoboDK OPC-UA server.
+// Each client runs in its own thread with its own connection and repeats the same cycle:
+// getJoints, setJoints (same joints), and a read of the time, simulation speed and station value variables.
+// The latency of every call is recorded and the calls per second and p50/p99/p999 latencies are reported per operation.
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QVector>
+#include <QString>
+
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "open62541.h"
+
+
+/// Operations of a benchmark cycle
+enum Operation {
+    OpGetJoints = 0,
+    OpSetJoints,
+    OpReadTime,
+    OpReadSimulationSpeed,
+    OpReadStationValue,
+    OpCount
+};
+
+static const char *OperationNames[OpCount] = {
+    "getJoints",
+    "setJoints",
+    "read time",
+    "read SimulationSpeed",
+    "read StationValue"
+};
+
+/// Latencies (us) and errors recorded by one client
+struct client_result_t
+{
+    QVector<double> latency[OpCount];
+    int errors[OpCount] = { 0, 0, 0, 0, 0 };
+    QString failure;
+};
+
+
+// Node ids published by the server (see opc_server_thread)
+static UA_NodeId nodeOfOperation(int operation){
+    switch (operation){
+    case OpGetJoints:
+        return UA_NODEID_NUMERIC(1, 1001);
+    case OpSetJoints:
+        return UA_NODEID_NUMERIC(1, 2001);
+    case OpReadTime:
+        return UA_NODEID_STRING(1, "time");
+    case OpReadSimulationSpeed:
+        return UA_NODEID_NUMERIC(1, 3);
+    default:
+        return UA_NODEID_NUMERIC(1, 6);
+    }
+}
+
+// Retrieve the item id of a robot with the getItem method (0 if it fails)
+static UA_UInt64 retrieveItem(const QByteArray &endpoint, const QString &name){
+    UA_Client *client = UA_Client_new(UA_ClientConfig_standard);
+    UA_UInt64 item_id = 0;
+    if (UA_Client_connect(client, endpoint.constData()) == UA_STATUSCODE_GOOD){
+        QByteArray name_utf8 = name.toUtf8();
+        UA_String name_str = UA_STRING(name_utf8.data());
+        UA_Variant input;
+        UA_Variant_init(&input);
+        UA_Variant_setScalar(&input, &name_str, &UA_TYPES[UA_TYPES_STRING]);
+
+        size_t output_size = 0;
+        UA_Variant *output = nullptr;
+        UA_StatusCode status = UA_Client_call(client, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER), UA_NODEID_NUMERIC(1, 1000), 1, &input, &output_size, &output);
+        if (status == UA_STATUSCODE_GOOD && output_size > 0 && output[0].type == &UA_TYPES[UA_TYPES_UINT64]){
+            item_id = *(UA_UInt64*)output[0].data;
+        }
+        if (output != nullptr){
+            UA_Array_delete(output, output_size, &UA_TYPES[UA_TYPES_VARIANT]);
+        }
+        UA_Client_disconnect(client);
+    }
+    UA_Client_delete(client);
+    return item_id;
+}
+
+// Run the benchmark cycle until the deadline (monotonic time)
+static void runClient(QByteArray endpoint, UA_UInt64 item_id, UA_DateTime deadline, client_result_t *result){
+    UA_Client *client = UA_Client_new(UA_ClientConfig_standard);
+    UA_StatusCode status = UA_Client_connect(client, endpoint.constData());
+    if (status != UA_STATUSCODE_GOOD){
+        result->failure = QString("Connection failed: %1").arg(UA_StatusCode_name(status));
+        UA_Client_delete(client);
+        return;
+    }
+
+    UA_UInt64 item = item_id;
+    UA_Variant inputs[2];
+    UA_Variant_init(&inputs[0]);
+    UA_Variant_setScalar(&inputs[0], &item, &UA_TYPES[UA_TYPES_UINT64]);
+    UA_Variant joints;
+    UA_Variant_init(&joints);
+
+    UA_NodeId objects = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    while (UA_DateTime_nowMonotonic() < deadline){
+        for (int op = 0; op < OpCount; op++){
+            bool method = op == OpGetJoints || op == OpSetJoints;
+            if (method && item_id == 0){
+                continue;
+            }
+            if (op == OpSetJoints && joints.data == nullptr){
+                continue;
+            }
+
+            size_t output_size = 0;
+            UA_Variant *output = nullptr;
+            UA_Variant value;
+            UA_Variant_init(&value);
+
+            UA_DateTime t0 = UA_DateTime_nowMonotonic();
+            if (op == OpGetJoints){
+                status = UA_Client_call(client, objects, nodeOfOperation(op), 1, inputs, &output_size, &output);
+            } else if (op == OpSetJoints){
+                inputs[1] = joints;
+                status = UA_Client_call(client, objects, nodeOfOperation(op), 2, inputs, &output_size, &output);
+            } else {
+                status = UA_Client_readValueAttribute(client, nodeOfOperation(op), &value);
+            }
+            UA_DateTime t1 = UA_DateTime_nowMonotonic();
+
+            if (status == UA_STATUSCODE_GOOD){
+                result->latency[op].append(double(t1 - t0) / UA_USEC_TO_DATETIME);
+            } else {
+                result->errors[op]++;
+            }
+
+            // Send back the joints we read
+            if (op == OpGetJoints && status == UA_STATUSCODE_GOOD && output_size > 0){
+                UA_Variant_deleteMembers(&joints);
+                UA_Variant_copy(&output[0], &joints);
+            }
+            if (output != nullptr){
+                UA_Array_delete(output, output_size, &UA_TYPES[UA_TYPES_VARIANT]);
+            }
+            UA_Variant_deleteMembers(&value);
+        }
+    }
+
+    UA_Variant_deleteMembers(&joints);
+    UA_Client_disconnect(client);
+    UA_Client_delete(client);
+}
+
+// Percentile of sorted latencies (nearest rank)
+static double percentile(const QVector<double> &sorted, double p){
+    if (sorted.isEmpty()){
+        return 0;
+    }
+    int rank = int(std::ceil(p * sorted.size())) - 1;
+    return sorted[qBound(0, rank, sorted.size() - 1)];
+}
+
+
+int main(int argc, char *argv[]){
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("opcua_benchmark");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Throughput and latency benchmark of the RoboDK OPC-UA server");
+    parser.addHelpOption();
+    QCommandLineOption opt_endpoint("endpoint", "Endpoint URL of the server", "url", "opc.tcp://localhost:4840");
+    QCommandLineOption opt_clients("clients", "Number of concurrent clients", "n", "1");
+    QCommandLineOption opt_duration("duration", "Duration of the benchmark (s)", "s", "10");
+    QCommandLineOption opt_robot("robot", "Robot name used for getJoints/setJoints (methods are skipped if empty)", "name", "");
+    parser.addOption(opt_endpoint);
+    parser.addOption(opt_clients);
+    parser.addOption(opt_duration);
+    parser.addOption(opt_robot);
+    parser.process(app);
+
+    QByteArray endpoint = parser.value(opt_endpoint).toUtf8();
+    int nclients = qMax(1, parser.value(opt_clients).toInt());
+    double duration = qMax(0.1, parser.value(opt_duration).toDouble());
+    QString robot = parser.value(opt_robot);
+
+    UA_UInt64 item_id = 0;
+    if (!robot.isEmpty()){
+        item_id = retrieveItem(endpoint, robot);
+        if (item_id == 0){
+            fprintf(stderr, "Robot %s not found with getItem on %s\n", robot.toUtf8().constData(), endpoint.constData());
+            return 1;
+        }
+    }
+
+    printf("Endpoint: %s\nClients: %d\nDuration: %.1f s\n", endpoint.constData(), nclients, duration);
+    if (item_id == 0){
+        printf("No robot provided: getJoints and setJoints are skipped\n");
+    }
+
+    std::vector<client_result_t> results(nclients);
+    std::vector<std::thread> threads;
+    UA_DateTime start = UA_DateTime_nowMonotonic();
+    UA_DateTime deadline = start + (UA_DateTime)(duration * 1000.0 * UA_MSEC_TO_DATETIME);
+    for (int i = 0; i < nclients; i++){
+        threads.emplace_back(runClient, endpoint, item_id, deadline, &results[i]);
+    }
+    for (std::thread &thread : threads){
+        thread.join();
+    }
+    double elapsed = double(UA_DateTime_nowMonotonic() - start) / (1000.0 * UA_MSEC_TO_DATETIME);
+
+    for (int i = 0; i < nclients; i++){
+        if (!results[i].failure.isEmpty()){
+            fprintf(stderr, "Client %d: %s\n", i, results[i].failure.toUtf8().constData());
+        }
+    }
+
+    printf("\n%-22s %10s %8s %12s %10s %10s %10s\n", "Operation", "Calls", "Errors", "Calls/s", "p50 (ms)", "p99 (ms)", "p999 (ms)");
+    int total_calls = 0;
+    for (int op = 0; op < OpCount; op++){
+        QVector<double> latency;
+        int errors = 0;
+        for (const client_result_t &result : results){
+            latency += result.latency[op];
+            errors += result.errors[op];
+        }
+        std::sort(latency.begin(), latency.end());
+        total_calls += latency.size();
+        printf("%-22s %10d %8d %12.1f %10.3f %10.3f %10.3f\n", OperationNames[op], latency.size(), errors, latency.size() / elapsed,
+               percentile(latency, 0.50) / 1000.0, percentile(latency, 0.99) / 1000.0, percentile(latency, 0.999) / 1000.0);
+    }
+    printf("%-22s %10d %8s %12.1f\n", "Total", total_calls, "", total_calls / elapsed);
+    return 0;
+}
@@ -0,0 +1,29 @@
+#----------------- HELP --------------
+# Throughput and latency benchmark of the RoboDK OPC-UA server.
+# This is a console application (not a plugin): start RoboDK with the OPC-UA plugin and the server running, then run:
+# opcua_benchmark --endpoint opc.tcp://localhost:4840 --clients 4 --duration 10 --robot "UR10e"
+#------------------------------------
+
+TEMPLATE        = app
+CONFIG         += console c++11
+CONFIG         -= app_bundle
+QT             -= gui
+
+TARGET          = opcua_benchmark
+
+SOURCES += \
+    main.cpp
+
+
+# ------------------------
+# Flag to compile Open62541 source for any platform
+QMAKE_CFLAGS += -std=c99
+#--------------------------
+# Header and source files required for OPC UA
+HEADERS += ../opcua/open62541.h
+SOURCES += ../opcua/open62541.c
+win32{
+LIBS += -lws2_32
+}
+INCLUDEPATH += ../opcua
+#--------------------------
@@ -13,9 +13,344 @@
 #include <QTimer>
 #include <QAction>
 
-// Hold the pointer to the last client connection
-UA_Client *client = nullptr;
 
+// Convert the identifier of a node to a string
+static QString nodeIdToString(const UA_NodeId &id){
+    if(id.identifierType == UA_NODEIDTYPE_NUMERIC) {
+        return QString::number(id.identifier.numeric);
+    } else if (id.identifierType == UA_NODEIDTYPE_STRING){
+        return QString::fromUtf8((const char*)id.identifier.string.data, id.identifier.string.length);
+    }
+    return "Uknown";
+}
+
+
+// Collect the children of the Objects folder
+static UA_StatusCode callbackNodeCollect(UA_NodeId childId, UA_Boolean isInverse, UA_NodeId referenceTypeId, void *h) {
+    QVector<UA_NodeId> *children = (QVector<UA_NodeId>*)h;
+    if (!isInverse){
+        UA_NodeId id;
+        UA_NodeId_copy(&childId, &id);
+        children->append(id);
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+// Forward the value changes of the monitored items to the client
+static void callbackValueChanged(UA_UInt32 monId, UA_DataValue *value, void *context) {
+    ((opcua_client_worker*)context)->ValueChanged(monId, value);
+}
+
+
+//-------------------------------------------------------------------------
+// Client thread
+
+opcua_client_worker::opcua_client_worker() : QObject(NULL){
+    Client = nullptr;
+    SubscriptionId = 0;
+    SubscriptionInterval = 0;
+
+    // The timer is a child so it moves to the client thread with the worker
+    Timer = new QTimer(this);
+    connect(Timer, SIGNAL(timeout()), this, SLOT(Update()));
+}
+opcua_client_worker::~opcua_client_worker(){
+    Disconnect();
+}
+
+void opcua_client_worker::Start(const QString &endpoint_url, bool subscribe, double sampling_interval){
+    if (endpoint_url != EndpointUrl){
+        Disconnect();
+    }
+    Timer->stop();
+
+    bool just_connected = false;
+    UA_StatusCode statusCode = Connect(endpoint_url, &just_connected);
+    if (statusCode != UA_STATUSCODE_GOOD){
+        return;
+    }
+    statusCode = BrowseNodes();
+    if (statusCode == UA_STATUSCODE_GOOD){
+        statusCode = ReadNodes(false, just_connected);
+    }
+    if (statusCode != UA_STATUSCODE_GOOD){
+        Fail(tr("Unable to retrieve server nodes. Reason: %1"), statusCode);
+        return;
+    }
+
+    if (subscribe){
+        statusCode = Subscribe(sampling_interval);
+        if (statusCode != UA_STATUSCODE_GOOD){
+            Fail(tr("Unable to subscribe to the server nodes. Reason: %1"), statusCode);
+            return;
+        }
+        Timer->start(qMax(1, qRound(sampling_interval)));
+    } else {
+        Unsubscribe();
+        Timer->start(PollInterval);
+    }
+
+    if (just_connected){
+        emit Notify(tr("Server variables retrieved. Right click the station item and select 'Station parameters' to see the variables"));
+    }
+}
+
+void opcua_client_worker::Browse(const QString &endpoint_url, bool close_connection){
+    if (endpoint_url != EndpointUrl){
+        Disconnect();
+    }
+
+    bool just_connected = false;
+    UA_StatusCode statusCode = Connect(endpoint_url, &just_connected);
+    if (statusCode != UA_STATUSCODE_GOOD){
+        return;
+    }
+    statusCode = BrowseNodes();
+    if (statusCode == UA_STATUSCODE_GOOD){
+        statusCode = ReadNodes(false, true);
+    }
+    if (statusCode != UA_STATUSCODE_GOOD){
+        Fail(tr("Unable to retrieve server nodes. Reason: %1"), statusCode);
+        return;
+    }
+
+    if (just_connected){
+        emit Notify(tr("Server variables retrieved. Right click the station item and select 'Station parameters' to see the variables"));
+    }
+
+    if (close_connection){
+        emit Notify(tr("OPC-UA nodes updated as station variables. Connection closed."));
+        // Disconnect from server and free memory
+        Disconnect();
+    }
+}
+
+void opcua_client_worker::Stop(){
+    Disconnect();
+}
+
+void opcua_client_worker::Update(){
+    if (Client == nullptr){
+        Timer->stop();
+        return;
+    }
+
+    UA_StatusCode statusCode;
+    if (SubscriptionId != 0){
+        // The notifications call ValueChanged
+        statusCode = UA_Client_Subscriptions_manuallySendPublishRequest(Client);
+        FlushChanges();
+    } else {
+        statusCode = ReadNodes(true, false);
+    }
+    if (statusCode != UA_STATUSCODE_GOOD){
+        Fail(tr("Unable to retrieve server nodes. Reason: %1"), statusCode);
+    }
+}
+
+UA_StatusCode opcua_client_worker::Connect(const QString &endpoint_url, bool *just_connected){
+    *just_connected = false;
+    if (Client != nullptr){
+        return UA_STATUSCODE_GOOD;
+    }
+
+    EndpointUrl = endpoint_url;
+    Client = UA_Client_new(UA_ClientConfig_standard);
+    // Connect to a server
+    // anonymous connect would be: retval = UA_Client_connect(client, "opc.tcp://localhost:4840");
+    // retval = UA_Client_connect_username(client, "opc.tcp://localhost:4840", "user1", "password");
+    emit Message(tr("Connecting to OPC-UA server %1").arg(EndpointUrl));
+    UA_StatusCode statusCode = UA_Client_connect(Client, EndpointUrl.toUtf8().constData());
+    if(statusCode != UA_STATUSCODE_GOOD) {
+        UA_Client_delete(Client);
+        Client = nullptr;
+        Fail(tr("Connecting to OPC-UA server failed. Reason: %1"), statusCode);
+        return statusCode;
+    }
+    *just_connected = true;
+    return UA_STATUSCODE_GOOD;
+}
+
+void opcua_client_worker::Disconnect(){
+    Timer->stop();
+    ClearNodes();
+    if (Client != nullptr) {
+        UA_Client_disconnect(Client);
+        UA_Client_delete(Client);
+        Client = nullptr;
+    }
+}
+
+void opcua_client_worker::Fail(const QString &reason, UA_StatusCode status){
+    const UA_StatusCodeDescription *statusDesc = UA_StatusCode_description(status);
+    emit Message(reason.arg(statusDesc->explanation));
+    Disconnect();
+    emit Stopped();
+}
+
+UA_StatusCode opcua_client_worker::BrowseNodes(){
+    if (!Nodes.isEmpty()){
+        return UA_STATUSCODE_GOOD;
+    }
+
+    // Browse objects using the node iterator
+    QVector<UA_NodeId> children;
+    UA_StatusCode statusCode = UA_Client_forEachChildNodeCall(Client, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER), callbackNodeCollect, (void *) &children);
+    for (const UA_NodeId &id : children){
+        client_node_t node;
+        node.id = id;
+        node.identifier = nodeIdToString(id);
+        node.name = node.identifier;
+        Nodes.append(node);
+    }
+    return statusCode;
+}
+
+UA_StatusCode opcua_client_worker::ReadNodes(bool changed_only, bool log){
+    if (Nodes.isEmpty()){
+        return UA_STATUSCODE_GOOD;
+    }
+
+    // Read the value and the display name of all the nodes at once (the node ids are not copied)
+    QVector<UA_ReadValueId> nodes_to_read(2 * Nodes.size());
+    for (int i = 0; i < Nodes.size(); i++){
+        UA_ReadValueId_init(&nodes_to_read[2 * i]);
+        nodes_to_read[2 * i].nodeId = Nodes[i].id;
+        nodes_to_read[2 * i].attributeId = UA_ATTRIBUTEID_VALUE;
+        UA_ReadValueId_init(&nodes_to_read[2 * i + 1]);
+        nodes_to_read[2 * i + 1].nodeId = Nodes[i].id;
+        nodes_to_read[2 * i + 1].attributeId = UA_ATTRIBUTEID_DISPLAYNAME;
+    }
+    UA_ReadRequest request;
+    UA_ReadRequest_init(&request);
+    request.nodesToRead = nodes_to_read.data();
+    request.nodesToReadSize = nodes_to_read.size();
+    request.timestampsToReturn = UA_TIMESTAMPSTORETURN_NEITHER;
+
+    UA_ReadResponse response = UA_Client_Service_read(Client, request);
+    UA_StatusCode statusCode = response.responseHeader.serviceResult;
+    if (statusCode == UA_STATUSCODE_GOOD && response.resultsSize != (size_t)nodes_to_read.size()){
+        statusCode = UA_STATUSCODE_BADUNEXPECTEDERROR;
+    }
+
+    for (int i = 0; statusCode == UA_STATUSCODE_GOOD && i < Nodes.size(); i++){
+        client_node_t &node = Nodes[i];
+        const UA_DataValue &value = response.results[2 * i];
+        const UA_DataValue &name = response.results[2 * i + 1];
+        if (name.hasValue && name.value.type == &UA_TYPES[UA_TYPES_LOCALIZEDTEXT]){
+            const UA_LocalizedText *text = (const UA_LocalizedText*)name.value.data;
+            QString displayname = QString::fromUtf8((const char*)text->text.data, text->text.length);
+            node.name = displayname.isEmpty() ? node.identifier : displayname;
+        }
+
+        node.variable = value.hasValue && value.value.type != nullptr && (!value.hasStatus || value.status == UA_STATUSCODE_GOOD);
+        if (!node.variable){
+            if (log){
+                emit Log(tr("  node %1 is not a variable").arg(node.identifier));
+            }
+            continue;
+        }
+
+        // important: skip reserved variables used by the server to update other parameters
+        if (node.name == "StationParameter" || node.name == "StationValue"){
+            node.variable = false;
+            continue;
+        }
+
+        // The value is only converted to a string if it changed
+        bool changed = Var_2_Value(&value.value, node.value);
+        if (log){
+            emit Log(QString("  %1 (%2): %3").arg(node.name).arg(node.identifier).arg(Value_2_Str(node.value)));
+        }
+        if (changed_only && !changed){
+            continue;
+        }
+        ChangedNames.append(node.name);
+        ChangedValues.append(Value_2_Str(node.value));
+    }
+    UA_ReadResponse_deleteMembers(&response);
+
+    FlushChanges();
+    return statusCode;
+}
+
+UA_StatusCode opcua_client_worker::Subscribe(double sampling_interval){
+    // Start is called again with the same server: keep the subscription, or replace it so the values are not notified twice
+    if (SubscriptionId != 0 && SubscriptionInterval == sampling_interval){
+        return UA_STATUSCODE_GOOD;
+    }
+    Unsubscribe();
+
+    // The sampling interval of the monitored items is the publishing interval of the subscription
+    UA_SubscriptionSettings settings = UA_SubscriptionSettings_standard;
+    settings.requestedPublishingInterval = sampling_interval;
+    settings.maxNotificationsPerPublish = 0; // no limit
+    UA_StatusCode statusCode = UA_Client_Subscriptions_new(Client, settings, &SubscriptionId);
+    if (statusCode != UA_STATUSCODE_GOOD){
+        SubscriptionId = 0;
+        return statusCode;
+    }
+    SubscriptionInterval = sampling_interval;
+
+    // Monitor the variables (the names and initial values were read already)
+    for (int i = 0; i < Nodes.size(); i++){
+        if (!Nodes[i].variable){
+            continue;
+        }
+        UA_UInt32 monitored_id = 0;
+        if (UA_Client_Subscriptions_addMonitoredItem(Client, SubscriptionId, Nodes[i].id, UA_ATTRIBUTEID_VALUE, callbackValueChanged, this, &monitored_id) == UA_STATUSCODE_GOOD){
+            MonitoredNodes.insert(monitored_id, i);
+        }
+    }
+    emit Log(tr("Monitoring %1 OPC-UA nodes every %2 ms").arg(MonitoredNodes.size()).arg(sampling_interval));
+    return UA_STATUSCODE_GOOD;
+}
+
+void opcua_client_worker::ValueChanged(UA_UInt32 monitored_id, const UA_DataValue *value){
+    auto index = MonitoredNodes.find(monitored_id);
+    if (index == MonitoredNodes.end() || !value->hasValue || value->value.type == nullptr){
+        return;
+    }
+
+    // Only update the station parameters that changed
+    client_node_t &node = Nodes[index.value()];
+    if (!Var_2_Value(&value->value, node.value)){
+        return;
+    }
+    ChangedNames.append(node.name);
+    ChangedValues.append(Value_2_Str(node.value));
+}
+
+void opcua_client_worker::Unsubscribe(){
+    if (Client != nullptr && SubscriptionId != 0){
+        UA_Client_Subscriptions_remove(Client, SubscriptionId);
+    }
+    SubscriptionId = 0;
+    MonitoredNodes.clear();
+}
+
+void opcua_client_worker::ClearNodes(){
+    Unsubscribe();
+    for (client_node_t &node : Nodes){
+        UA_NodeId_deleteMembers(&node.id);
+    }
+    Nodes.clear();
+    ChangedNames.clear();
+    ChangedValues.clear();
+}
+
+void opcua_client_worker::FlushChanges(){
+    if (ChangedNames.isEmpty()){
+        return;
+    }
+    emit ParametersChanged(ChangedNames, ChangedValues);
+    ChangedNames.clear();
+    ChangedValues.clear();
+}
+
+
+//-------------------------------------------------------------------------
+// Client interface (GUI thread)
 
 opcua_client::opcua_client(PluginOPCUA *plugin) : QObject(NULL){
     pPlugin = plugin;
@@ -25,28 +360,40 @@ opcua_client::opcua_client(PluginOPCUA *plugin) : QObject(NULL){
     AutoStart = false;    
     KeepConnected = true;
 
-    // set interval to retrieve nodes (in milliseconds)
-    BrowseServer.setInterval(100);
-    connect(&BrowseServer, SIGNAL(timeout()), this, SLOT(Browse()));
-
+    // Monitor the variables instead of reading them every time
+    Subscribe = true;
+    SamplingInterval = 100;
+
+    // Run the client in its own thread
+    Worker = new opcua_client_worker();
+    Worker->moveToThread(&Thread);
+    connect(&Thread, SIGNAL(finished()), Worker, SLOT(deleteLater()));
+    connect(Worker, SIGNAL(ParametersChanged(QStringList,QStringList)), this, SLOT(ApplyParameters(QStringList,QStringList)));
+    connect(Worker, SIGNAL(Message(QString)), pPlugin, SLOT(ShowMessage(QString)));
+    connect(Worker, SIGNAL(Log(QString)), pPlugin, SLOT(LogAdd(QString)));
+    connect(Worker, SIGNAL(Notify(QString)), this, SLOT(Notify(QString)));
+    connect(Worker, SIGNAL(Stopped()), this, SLOT(WorkerStopped()));
+    Thread.start();
 }
 opcua_client::~opcua_client(){
+    // Disconnect before stopping the thread
+    QMetaObject::invokeMethod(Worker, "Stop", Qt::BlockingQueuedConnection);
+    disconnect(Worker, nullptr, this, nullptr);
     pPlugin = nullptr; // prevent using the plugin interface when we are closing the plugin
-    Stop();
+    Thread.quit();
+    Thread.wait();
 }
 
 void opcua_client::Start(){
     if (KeepConnected){
-        // start timer if we want to remain connected
-        BrowseServer.start();
+        // keep the variables updated in the client thread
+        QMetaObject::invokeMethod(Worker, "Start", Qt::QueuedConnection, Q_ARG(QString, EndpointUrl), Q_ARG(bool, Subscribe), Q_ARG(double, SamplingInterval));
 
         // change button status
         pPlugin->action_StartClient->setChecked(true);
     } else {
         // Run a quick browse and close connection
-        BrowseServer.stop();
-        int status = Browse(true);
-        bool success = status == 0;
+        Browse(true);
 
         // change button status
         pPlugin->action_StartClient->setChecked(false);
@@ -57,15 +404,7 @@ void opcua_client::Stop(){
     if (pPlugin != nullptr){
         pPlugin->action_StartClient->setChecked(false);
     }
-
-    BrowseServer.stop();
-
-    // clear data
-    if (client != nullptr) {
-        UA_Client_disconnect(client);
-        UA_Client_delete(client);
-        client = nullptr;
-    }
+    QMetaObject::invokeMethod(Worker, "Stop", Qt::QueuedConnection);
 }
 
 QString opcua_client::Status(){
@@ -100,129 +439,29 @@ QStringList opcua_client::ListEndpoints(){
     return endpoints;
 }
 
-static UA_StatusCode callbackNodeIter(UA_NodeId childId, UA_Boolean isInverse, UA_NodeId referenceTypeId, void *h) {
-    PluginOPCUA *plugin = (PluginOPCUA*)h;
-    if(isInverse){
-        return UA_STATUSCODE_GOOD;
-    }
-
-    // Retrieve the identifier
-    QString str_identifier;
-    if(childId.identifierType == UA_NODEIDTYPE_NUMERIC) {
-        str_identifier = QString::number(childId.identifier.numeric);
-    } else if (childId.identifierType == UA_NODEIDTYPE_STRING){
-        str_identifier = QString::fromUtf8((const char*)childId.identifier.string.data, childId.identifier.string.length);
-    } else {
-        str_identifier = "Uknown";
-    }
-
-    // Read the attribute and the display name
-    UA_LocalizedText nodeDisplayName = UA_LOCALIZEDTEXT("en_US","name to read");
-    UA_Variant *nodeValue = UA_Variant_new();
-    UA_StatusCode retval = UA_Client_readValueAttribute(client, childId, nodeValue);
-    UA_StatusCode retval2 = UA_Client_readDisplayNameAttribute(client, childId, &nodeDisplayName);
-    if(retval == UA_STATUSCODE_GOOD && retval2 == UA_STATUSCODE_GOOD){
-        QString strvalue;
-        if (nodeValue->type->typeId.identifier.numeric == UA_TYPES[UA_TYPES_BOOLEAN].typeId.identifier.numeric) {
-            UA_Boolean value = *((UA_Boolean*)nodeValue->data);
-            strvalue = value ? "1" : "0";
-        } else if (nodeValue->type->typeId.identifier.numeric == UA_TYPES[UA_TYPES_DOUBLE].typeId.identifier.numeric) {
-            UA_Double value = *((UA_Double*)nodeValue->data);
-            strvalue = QString::number(value);
-        } else if (nodeValue->type->typeId.identifier.numeric == UA_TYPES[UA_TYPES_INT64].typeId.identifier.numeric) {
-            UA_Int64 value = *((UA_Int64*)nodeValue->data);
-            strvalue = QString::number(value);
-        } else if (nodeValue->type->typeId.identifier.numeric == UA_TYPES[UA_TYPES_INT32].typeId.identifier.numeric) {
-            UA_Int32 value = *((UA_Int32*)nodeValue->data);
-            strvalue = QString::number(value);
-        } else if (nodeValue->type->typeId.identifier.numeric == UA_TYPES[UA_TYPES_INT16].typeId.identifier.numeric) {
-            UA_Int16 value = *((UA_Int16*)nodeValue->data);
-            strvalue = QString::number(value);
-        } else if (nodeValue->type->typeId.identifier.numeric == UA_TYPES[UA_TYPES_STRING].typeId.identifier.numeric) {
-            UA_String *value = (UA_String*) nodeValue->data;
-            strvalue = QString::fromUtf8((const char*)value->data, value->length);
-        } else if (nodeValue->type->typeId.identifier.numeric == UA_TYPES[UA_TYPES_DATETIME].typeId.identifier.numeric) {
-            UA_DateTime *value = (UA_DateTime*) nodeValue->data;
-            UA_String strval = UA_DateTime_toString(*value);
-            //QString str(name->data, name->length);
-            strvalue = QString::fromUtf8((const char*)strval.data, strval.length);
-        } else {
-            strvalue = QObject::tr("Unknown value type %1").arg(nodeValue->type->typeId.identifier.numeric);
-        }
-        QString displayname = QString::fromUtf8((const char*)nodeDisplayName.text.data, nodeDisplayName.text.length);
-
-        // important: skip reserved variables used by the server to update other parameters
-        if (displayname != "StationParameter" && displayname != "StationValue"){
-            plugin->LogAdd(QString("  %1 (%2): %3").arg(displayname).arg(str_identifier).arg(strvalue));
-
-            QString stationparam(displayname);
-            if (stationparam.isEmpty()){
-                stationparam = str_identifier;
-            }
-            if (!str_identifier.isEmpty()){
-                plugin->RDK->setParam(displayname, strvalue);
-            }
-        }
-    } else {
-        plugin->LogAdd(QObject::tr("  node %1 is not a variable").arg(str_identifier));
-    }
-    UA_Variant_delete(nodeValue);
 
-    //UA_NodeId *parent = (UA_NodeId *)handle;
-    //printf("%d, %d --- %d ---> NodeId %d, %d\n", parent->namespaceIndex, parent->identifier.numeric,
-    // referenceTypeId.identifier.numeric, childId.namespaceIndex, childId.identifier.numeric);
-    return UA_STATUSCODE_GOOD;
+int opcua_client::Browse(bool close_connection){
+    QMetaObject::invokeMethod(Worker, "Browse", Qt::QueuedConnection, Q_ARG(QString, EndpointUrl), Q_ARG(bool, close_connection));
+    return 0;
 }
 
-int opcua_client::Browse(bool close_connection){
-    UA_StatusCode statusCode;
-    bool just_connected = false;
-    if (client == nullptr){
-        client = UA_Client_new(UA_ClientConfig_standard);
-        // Connect to a server
-        // anonymous connect would be: retval = UA_Client_connect(client, "opc.tcp://localhost:4840");
-        // retval = UA_Client_connect_username(client, "opc.tcp://localhost:4840", "user1", "password");
-        pPlugin->ShowMessage(tr("Connecting to OPC-UA server %1").arg(EndpointUrl));
-        statusCode = UA_Client_connect(client, EndpointUrl.toUtf8().constData());
-        if(statusCode != UA_STATUSCODE_GOOD) {
-            UA_Client_delete(client);
-            client = nullptr;
-            const UA_StatusCodeDescription *statusDesc = UA_StatusCode_description(statusCode);
-            pPlugin->ShowMessage(tr("Connecting to OPC-UA server failed. Reason: %1").arg(statusDesc->explanation));
-
-            // stop timer to prevent reconnection attempt
-            Stop();
-            return (int)statusCode;
-        }
-        just_connected = true;
+void opcua_client::ApplyParameters(const QStringList &names, const QStringList &values){
+    if (pPlugin == nullptr){
+        return;
     }
-
-    // Browse objects using the node iterator
-    //UA_NodeId *parent = UA_NodeId_new();
-    //*parent = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
-    statusCode = UA_Client_forEachChildNodeCall(client, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER), callbackNodeIter, (void *) pPlugin);
-    if(statusCode != UA_STATUSCODE_GOOD) {
-        UA_Client_disconnect(client);
-        UA_Client_delete(client);
-        client = nullptr;
-        const UA_StatusCodeDescription *statusDesc = UA_StatusCode_description(statusCode);
-        pPlugin->ShowMessage(tr("Unable to retrieve server nodes. Reason: %1").arg(statusDesc->explanation));
-        return (int)statusCode;
+    for (int i = 0; i < names.size() && i < values.size(); i++){
+        pPlugin->RDK->setParam(names[i], values[i]);
     }
+}
 
-    if (just_connected){
-        pPlugin->RDK->ShowMessage(tr("Server variables retrieved. Right click the station item and select 'Station parameters' to see the variables"), false);
+void opcua_client::Notify(const QString &msg){
+    if (pPlugin != nullptr){
+        pPlugin->RDK->ShowMessage(msg, false);
     }
+}
 
-    if (close_connection){
-        pPlugin->RDK->ShowMessage(tr("OPC-UA nodes updated as station variables. Connection closed."), false);
-        // Disconnect from server and free memory
-        UA_Client_disconnect(client);
-        UA_Client_delete(client);
-        client = nullptr;
+void opcua_client::WorkerStopped(){
+    if (pPlugin != nullptr){
+        pPlugin->action_StartClient->setChecked(false);
     }
-    return 0;
 }
-
-
-
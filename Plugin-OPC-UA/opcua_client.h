@@ -3,9 +3,121 @@
 
 #include <QObject>
 #include <QTimer>
+#include <QThread>
+#include <QVector>
+#include <QHash>
+#include <QStringList>
+
+#include "open62541.h"
+#include "opcua_tools.h"
 
 class PluginOPCUA;
 
+
+/// This class runs the OPC-UA client in its own thread, so a slow server never blocks RoboDK.
+/// The variables of the server are read with one Read request per cycle (or monitored with a subscription)
+/// and the variables that changed are sent to the GUI thread as one batch.
+class opcua_client_worker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit opcua_client_worker();
+    ~opcua_client_worker();
+
+    /// Called by the subscription when the value of a monitored node changes
+    void ValueChanged(UA_UInt32 monitored_id, const UA_DataValue *value);
+
+    /// Interval to read the variables when a subscription is not used (ms)
+    static const int PollInterval = 100;
+
+public slots:
+    /// Connect to the server and keep the variables updated: with a subscription if subscribe is set, otherwise by reading all the variables every PollInterval
+    void Start(const QString &endpoint_url, bool subscribe, double sampling_interval);
+
+    /// Connect to the server, read all the variables once and optionally close the connection
+    void Browse(const QString &endpoint_url, bool close_connection);
+
+    /// Disconnect from the server
+    void Stop();
+
+private slots:
+    /// Read the variables or request the notifications of the subscription
+    void Update();
+
+signals:
+    /// Station parameters that changed
+    void ParametersChanged(const QStringList &names, const QStringList &values);
+
+    /// Show a message in the status bar and the log
+    void Message(const QString &msg);
+
+    /// Add a message to the log
+    void Log(const QString &msg);
+
+    /// Show a (non blocking) message in RoboDK
+    void Notify(const QString &msg);
+
+    /// The client was disconnected because of an error
+    void Stopped();
+
+private:
+    /// Connect to the server if the client is not connected
+    UA_StatusCode Connect(const QString &endpoint_url, bool *just_connected);
+
+    /// Disconnect from the server and free memory
+    void Disconnect();
+
+    /// Disconnect after an error
+    void Fail(const QString &reason, UA_StatusCode status);
+
+    /// Browse the Objects folder once and cache the node ids
+    UA_StatusCode BrowseNodes();
+
+    /// Read the values and display names of all the nodes with a single Read request
+    UA_StatusCode ReadNodes(bool changed_only, bool log);
+
+    /// Monitor the values of the variables (the subscription is kept if it already uses the same interval)
+    UA_StatusCode Subscribe(double sampling_interval);
+
+    /// Remove the subscription and its monitored items
+    void Unsubscribe();
+
+    /// Remove the subscription and the cached nodes
+    void ClearNodes();
+
+    /// Send the station parameters that changed to the GUI thread
+    void FlushChanges();
+
+private:
+    /// Node of the Objects folder of the server
+    struct client_node_t
+    {
+        UA_NodeId id;
+        QString identifier;
+        QString name; // display name, used as station parameter
+        opcua_value_t value; // last value set as station parameter
+        bool variable { false };
+    };
+
+    UA_Client *Client;
+    QString EndpointUrl;
+    QTimer *Timer;
+
+    /// Cached nodes, and index of the node for each monitored item
+    QVector<client_node_t> Nodes;
+    QHash<UA_UInt32, int> MonitoredNodes;
+
+    /// Subscription of the monitored items (0 if none) and its sampling interval
+    UA_UInt32 SubscriptionId;
+    double SubscriptionInterval;
+
+    /// Station parameters that changed and were not sent yet
+    QStringList ChangedNames;
+    QStringList ChangedValues;
+};
+
+
 class opcua_client : public QObject
 {
     Q_OBJECT
@@ -28,9 +140,20 @@ public:
     QStringList ListEndpoints();
 
 public slots:
-    /// Use the OPC-UA client to connect to the server and retrieve the server variables as RoboDK station variables
+    /// Use the OPC-UA client to connect to the server and retrieve the server variables as RoboDK station variables.
+    /// The variables are retrieved in the background.
     int Browse(bool close_connection = false);
 
+private slots:
+    /// Set the station parameters received by the client thread
+    void ApplyParameters(const QStringList &names, const QStringList &values);
+
+    /// Show a message from the client thread
+    void Notify(const QString &msg);
+
+    /// Called when the client thread disconnects because of an error
+    void WorkerStopped();
+
 public:
     /// End Point URL: It contains the IP and port (for example: "opc.tcp://localhost:4840")
     QString EndpointUrl;
@@ -39,14 +162,21 @@ public:
     bool AutoStart;
     bool KeepConnected;
 
-    /// Timer to update variables from the server
-    QTimer BrowseServer;
+    /// Monitor the server variables with a subscription instead of reading them periodically
+    bool Subscribe;
+
+    /// Sampling interval of the monitored variables (ms)
+    double SamplingInterval;
 
 public:
 
     /// Pointer to the RoboDK plugin interface
     PluginOPCUA *pPlugin;
 
+private:
+    /// Thread of the client
+    QThread Thread;
+    opcua_client_worker *Worker;
 };
 
 #endif // OPCUA_CLIENT_H
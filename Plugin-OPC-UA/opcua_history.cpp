@@ -0,0 +1,58 @@
+#include "opcua_history.h"
+
+#include <algorithm>
+
+
+opcua_joint_history::opcua_joint_history(int capacity) : Samples(qMax(1, capacity)), Count(0){
+}
+
+void opcua_joint_history::Append(UA_DateTime time, const tJoints &joints){
+    quint64 index = Count.load(std::memory_order_relaxed);
+    opcua_joint_sample_t &sample = Samples[index % Samples.size()];
+    sample.time = time;
+    sample.ndofs = qMin(joints.Length(), RDK_SIZE_JOINTS_MAX);
+    std::copy(joints.ValuesD(), joints.ValuesD() + sample.ndofs, sample.joints);
+
+    // Publish the sample after it is written
+    Count.store(index + 1, std::memory_order_release);
+}
+
+int opcua_joint_history::Read(UA_DateTime start, UA_DateTime end, int max_samples, QVector<opcua_joint_sample_t> &samples) const {
+    samples.clear();
+    const quint64 capacity = Samples.size();
+    const quint64 count = Count.load(std::memory_order_acquire);
+    quint64 first = count > capacity ? count - capacity : 0;
+
+    // Samples are appended in time order: find the first sample at or after the start time
+    quint64 lo = first;
+    quint64 hi = count;
+    while (lo < hi){
+        quint64 mid = lo + (hi - lo) / 2;
+        if (Samples[mid % capacity].time < start){
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    quint64 copied_from = lo;
+    for (quint64 i = lo; i < count && samples.size() < max_samples; i++){
+        const opcua_joint_sample_t &sample = Samples[i % capacity];
+        if (sample.time > end){
+            break;
+        }
+        samples.append(sample);
+    }
+
+    // Discard the samples the writer overwrote while we were copying (the writer may be writing the slot of index count_now - capacity)
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const quint64 count_now = Count.load(std::memory_order_relaxed);
+    if (count_now >= capacity){
+        quint64 oldest_valid = count_now - capacity + 1;
+        if (copied_from < oldest_valid){
+            int overwritten = int(qMin<quint64>(oldest_valid - copied_from, samples.size()));
+            samples.remove(0, overwritten);
+        }
+    }
+    return samples.size();
+}
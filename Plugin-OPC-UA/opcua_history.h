@@ -0,0 +1,51 @@
+#ifndef OPCUA_HISTORY_H
+#define OPCUA_HISTORY_H
+
+#include <QVector>
+
+#include <atomic>
+#include <vector>
+
+#include "robodktypes.h"
+#include "open62541.h"
+
+
+/// Timestamped joint sample of a robot
+struct opcua_joint_sample_t
+{
+    /// Time of the sample (UTC)
+    UA_DateTime time;
+
+    /// Number of joints
+    int ndofs;
+
+    /// Robot joints (deg or mm)
+    double joints[RDK_SIZE_JOINTS_MAX];
+};
+
+
+/// Fixed-size ring buffer of the joint samples of one robot.
+/// The GUI thread is the only writer and never waits: readers (the server thread) copy the samples
+/// and discard the ones that were overwritten while copying, like a sequence lock.
+class opcua_joint_history
+{
+public:
+    explicit opcua_joint_history(int capacity = Capacity);
+
+    /// Add a sample (GUI thread). The oldest sample is overwritten when the buffer is full.
+    void Append(UA_DateTime time, const tJoints &joints);
+
+    /// Copy up to max_samples samples with start <= time <= end, oldest first (any thread). Returns the number of samples.
+    int Read(UA_DateTime start, UA_DateTime end, int max_samples, QVector<opcua_joint_sample_t> &samples) const;
+
+    /// Default number of samples kept per robot (5 minutes at 100 Hz)
+    static const int Capacity = 30000;
+
+private:
+    std::vector<opcua_joint_sample_t> Samples;
+
+    /// Number of samples appended since the buffer was created
+    std::atomic<quint64> Count;
+};
+
+#endif // OPCUA_HISTORY_H
@@ -0,0 +1,333 @@
+#include "opcua_pubsub.h"
+
+#include "pluginopcua.h"
+#include "irobodk.h"
+#include "iitem.h"
+
+#include <QUrl>
+#include <QtEndian>
+#include <QDebug>
+
+#include <cstring>
+#include <limits>
+
+
+// UADP network message flags (OPC-UA Part 14, 7.2.2)
+static const quint8 UadpVersion = 1;
+static const quint8 UadpPublisherIdEnabled = 0x10;
+static const quint8 UadpGroupHeaderEnabled = 0x20;
+static const quint8 UadpPayloadHeaderEnabled = 0x40;
+static const quint8 UadpExtendedFlags1Enabled = 0x80;
+static const quint8 UadpPublisherIdUInt16 = 0x01;
+static const quint8 UadpTimestampEnabled = 0x20;
+static const quint8 UadpGroupFlags = 0x0F; // WriterGroupId, GroupVersion, NetworkMessageNumber and SequenceNumber
+
+// DataSetMessage flags: valid, RawData fields, sequence number, configuration version and timestamp of a key frame
+static const quint8 DataSetFlags1 = 0x01 | 0x02 | 0x08 | 0x20 | 0x40 | 0x80;
+static const quint8 DataSetFlags2 = 0x10;
+
+
+// Write a value in little endian (the OPC-UA binary encoding)
+template <typename T>
+static void writeValue(char *dest, T value){
+    qToLittleEndian<T>(value, dest);
+}
+static void writeDouble(char *dest, double value){
+    quint64 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    qToLittleEndian<quint64>(bits, dest);
+}
+
+// Append a value to the message template and return its offset
+template <typename T>
+static int appendValue(QByteArray &message, T value){
+    int offset = message.size();
+    message.resize(offset + int(sizeof(T)));
+    writeValue<T>(message.data() + offset, value);
+    return offset;
+}
+static int appendDouble(QByteArray &message, double value){
+    int offset = message.size();
+    message.resize(offset + int(sizeof(double)));
+    writeDouble(message.data() + offset, value);
+    return offset;
+}
+
+
+opcua_publisher::opcua_publisher(PluginOPCUA *plugin) : QObject(NULL){
+    pPlugin = plugin;
+    Url = "opc.udp://224.0.0.22:4840";
+    Interval = 10;
+    ParametersInterval = 100;
+    PublisherId = 1;
+    WriterGroupId = 1;
+    DataSetWriterId = 1;
+    Port = 4840;
+    SequenceNumber = 0;
+    ConfigVersion = 0;
+    OffsetSequenceNumber = -1;
+    OffsetTimestamp = -1;
+    OffsetDataSetSequenceNumber = -1;
+    OffsetDataSetTimestamp = -1;
+    OffsetTime = -1;
+    OffsetSimulationSpeed = -1;
+    OffsetParameters = -1;
+
+    Timer.setTimerType(Qt::PreciseTimer);
+    connect(&Timer, SIGNAL(timeout()), this, SLOT(Publish()));
+    connect(&ParametersTimer, SIGNAL(timeout()), this, SLOT(UpdateParameters()));
+}
+opcua_publisher::~opcua_publisher(){
+    Timer.stop();
+    ParametersTimer.stop();
+}
+
+bool opcua_publisher::Start(){
+    QUrl url(Url);
+    if (url.scheme() != "opc.udp" || url.host().isEmpty()){
+        pPlugin->ShowMessage(tr("Invalid OPC-UA PubSub URL: %1 (use opc.udp://address:port)").arg(Url));
+        return false;
+    }
+    Address = url.host() == "localhost" ? QHostAddress(QHostAddress::LocalHost) : QHostAddress(url.host());
+    Port = url.port(4840);
+    if (Address.isNull()){
+        pPlugin->ShowMessage(tr("Invalid OPC-UA PubSub address: %1").arg(url.host()));
+        return false;
+    }
+
+    Socket.close();
+    Socket.bind(QHostAddress(QHostAddress::AnyIPv4), 0);
+    if (Address.isMulticast()){
+        // Stay in the local network and let local subscribers receive the messages
+        Socket.setSocketOption(QAbstractSocket::MulticastTtlOption, 1);
+        Socket.setSocketOption(QAbstractSocket::MulticastLoopbackOption, 1);
+    }
+
+    UpdateLayout();
+    Timer.start(qMax(1, Interval));
+    ParametersTimer.start(qMax(Interval, ParametersInterval));
+    pPlugin->ShowMessage(tr("Publishing OPC-UA PubSub messages to %1 every %2 ms").arg(Url).arg(Interval));
+    return true;
+}
+
+void opcua_publisher::Stop(){
+    if (!Timer.isActive()){
+        return;
+    }
+    Timer.stop();
+    ParametersTimer.stop();
+    Socket.close();
+    if (pPlugin != nullptr){
+        pPlugin->ShowMessage(tr("OPC-UA PubSub publisher stopped"));
+    }
+}
+
+bool opcua_publisher::IsRunning(){
+    return Timer.isActive();
+}
+
+void opcua_publisher::UpdateLayout(){
+    QList<Item> robots = pPlugin->RDK->getItemList(IItem::ITEM_TYPE_ROBOT);
+
+    // Subscribers detect the new layout with the configuration version
+    ConfigVersion++;
+    Message.clear();
+    Robots.clear();
+
+    // NetworkMessage header
+    appendValue<quint8>(Message, UadpVersion | UadpPublisherIdEnabled | UadpGroupHeaderEnabled | UadpPayloadHeaderEnabled | UadpExtendedFlags1Enabled);
+    appendValue<quint8>(Message, UadpPublisherIdUInt16 | UadpTimestampEnabled);
+    appendValue<UA_UInt16>(Message, PublisherId);
+    appendValue<quint8>(Message, UadpGroupFlags);
+    appendValue<UA_UInt16>(Message, WriterGroupId);
+    appendValue<UA_UInt32>(Message, ConfigVersion); // group version
+    appendValue<UA_UInt16>(Message, 1); // network message number
+    OffsetSequenceNumber = appendValue<UA_UInt16>(Message, 0);
+    appendValue<quint8>(Message, 1); // one DataSetMessage
+    appendValue<UA_UInt16>(Message, DataSetWriterId);
+    OffsetTimestamp = appendValue<UA_DateTime>(Message, 0);
+
+    // DataSetMessage header
+    appendValue<quint8>(Message, DataSetFlags1);
+    appendValue<quint8>(Message, DataSetFlags2);
+    OffsetDataSetSequenceNumber = appendValue<UA_UInt16>(Message, 0);
+    OffsetDataSetTimestamp = appendValue<UA_DateTime>(Message, 0);
+    appendValue<UA_UInt32>(Message, ConfigVersion); // major version
+    appendValue<UA_UInt32>(Message, ConfigVersion); // minor version
+
+    // Fields (RawData)
+    OffsetTime = appendValue<UA_DateTime>(Message, 0);
+    OffsetSimulationSpeed = appendDouble(Message, 1.0);
+    for (Item robot : robots){
+        publisher_robot_t published;
+        published.robot = robot;
+        published.ndofs = robot->Joints().Length();
+        appendValue<UA_Int32>(Message, published.ndofs);
+        published.offset = Message.size();
+        for (int i = 0; i < published.ndofs; i++){
+            appendDouble(Message, 0.0);
+        }
+        Robots.append(published);
+    }
+    OffsetParameters = Message.size();
+    for (int i = 0; i < Parameters.size(); i++){
+        appendDouble(Message, std::numeric_limits<double>::quiet_NaN());
+    }
+    UpdateParameters();
+
+    QStringList names;
+    names.append(QString("Time (at byte %1)").arg(OffsetTime));
+    names.append(QString("SimulationSpeed (at byte %1)").arg(OffsetSimulationSpeed));
+    for (const publisher_robot_t &published : Robots){
+        names.append(QString("%1 (%2 joints at byte %3)").arg(published.robot->Name()).arg(published.ndofs).arg(published.offset));
+    }
+    if (!Parameters.isEmpty()){
+        names.append(QString("%1 (at byte %2)").arg(Parameters.join(", ")).arg(OffsetParameters));
+    }
+    pPlugin->LogAdd(tr("OPC-UA PubSub layout version %1 (%2 bytes): %3").arg(ConfigVersion).arg(Message.size()).arg(names.join(", ")));
+}
+
+void opcua_publisher::UpdateParameters(){
+    ParameterValues.resize(Parameters.size());
+    for (int i = 0; i < Parameters.size(); i++){
+        bool ok = false;
+        double value = pPlugin->RDK->getParam(Parameters[i]).toDouble(&ok);
+        ParameterValues[i] = ok ? value : std::numeric_limits<double>::quiet_NaN();
+    }
+}
+
+void opcua_publisher::Publish(){
+    if (Message.isEmpty()){
+        return;
+    }
+    WriteValues();
+    Socket.writeDatagram(Message.constData(), Message.size(), Address, Port);
+}
+
+void opcua_publisher::WriteValues(){
+    // Write the values in the encoded message
+    char *data = Message.data();
+    UA_DateTime now = UA_DateTime_now();
+    SequenceNumber++;
+    writeValue<UA_UInt16>(data + OffsetSequenceNumber, SequenceNumber);
+    writeValue<UA_UInt16>(data + OffsetDataSetSequenceNumber, SequenceNumber);
+    writeValue<UA_DateTime>(data + OffsetTimestamp, now);
+    writeValue<UA_DateTime>(data + OffsetDataSetTimestamp, now);
+    writeValue<UA_DateTime>(data + OffsetTime, now);
+    writeDouble(data + OffsetSimulationSpeed, pPlugin->RDK->SimulationSpeed());
+
+    for (const publisher_robot_t &published : Robots){
+        if (!pPlugin->RDK->Valid(published.robot)){
+            continue;
+        }
+        tJoints joints = published.robot->Joints();
+        int ndofs = qMin(published.ndofs, joints.Length());
+        for (int i = 0; i < ndofs; i++){
+            writeDouble(data + published.offset + i * int(sizeof(double)), joints.ValuesD()[i]);
+        }
+    }
+    // The parameters may have been read before the layout was updated
+    int nparams = qMin(ParameterValues.size(), (Message.size() - OffsetParameters) / int(sizeof(double)));
+    for (int i = 0; i < nparams; i++){
+        writeDouble(data + OffsetParameters + i * int(sizeof(double)), ParameterValues[i]);
+    }
+}
+
+QString opcua_publisher::CheckLoopback(){
+    QUdpSocket receiver;
+    if (!receiver.bind(QHostAddress(QHostAddress::LocalHost), 0)){
+        return tr("Unable to open a local socket");
+    }
+    UpdateLayout();
+    WriteValues();
+    QUdpSocket sender;
+    sender.writeDatagram(Message.constData(), Message.size(), QHostAddress(QHostAddress::LocalHost), receiver.localPort());
+    if (!receiver.waitForReadyRead(1000)){
+        return tr("No message received");
+    }
+    QByteArray received(int(receiver.pendingDatagramSize()), 0);
+    receiver.readDatagram(received.data(), received.size());
+
+    // Walk the headers from the flags of the message (OPC-UA Part 14, 7.2.2), without the offsets of the encoder
+    const uchar *data = reinterpret_cast<const uchar*>(received.constData());
+    int size = received.size();
+    int pos = 0;
+    auto need = [&](int bytes){ return pos + bytes <= size; };
+    if (!need(2)){
+        return tr("Message too short");
+    }
+    quint8 flags = data[pos++];
+    quint8 extended = (flags & UadpExtendedFlags1Enabled) ? data[pos++] : 0;
+    if ((flags & 0x0F) != UadpVersion){
+        return tr("Invalid UADP version");
+    }
+    if (flags & UadpPublisherIdEnabled){
+        pos += (extended & 0x07) == UadpPublisherIdUInt16 ? 2 : 1;
+    }
+    if (flags & UadpGroupHeaderEnabled){
+        quint8 group = data[pos++];
+        pos += ((group & 0x01) ? 2 : 0) + ((group & 0x02) ? 4 : 0) + ((group & 0x04) ? 2 : 0) + ((group & 0x08) ? 2 : 0);
+    }
+    if (flags & UadpPayloadHeaderEnabled){
+        if (!need(1)){
+            return tr("Message too short");
+        }
+        pos += 1 + 2 * data[pos];
+    }
+    if (extended & UadpTimestampEnabled){
+        pos += 8;
+    }
+    if (!need(2)){
+        return tr("Message too short");
+    }
+    quint8 ds_flags1 = data[pos++];
+    quint8 ds_flags2 = (ds_flags1 & 0x80) ? data[pos++] : 0;
+    if ((ds_flags1 & 0x06) != 0x02){
+        return tr("The DataSetMessage is not encoded as RawData");
+    }
+    pos += ((ds_flags1 & 0x08) ? 2 : 0) + ((ds_flags2 & 0x10) ? 8 : 0) + ((ds_flags1 & 0x20) ? 4 : 0) + ((ds_flags1 & 0x40) ? 4 : 0);
+
+    // Fields
+    if (pos != 46 || pos != OffsetTime || !need(8)){
+        return tr("Time is at byte %1 (expected 46)").arg(pos);
+    }
+    qint64 time = qFromLittleEndian<qint64>(data + pos);
+    pos += 8;
+    if (pos != 54 || pos != OffsetSimulationSpeed || !need(8)){
+        return tr("SimulationSpeed is at byte %1 (expected 54)").arg(pos);
+    }
+    quint64 bits = qFromLittleEndian<quint64>(data + pos);
+    double speed;
+    std::memcpy(&speed, &bits, sizeof(speed));
+    pos += 8;
+    if (time <= 0 || speed != pPlugin->RDK->SimulationSpeed()){
+        return tr("Invalid Time or SimulationSpeed values");
+    }
+    for (int r = 0; r < Robots.size(); r++){
+        if (!need(4)){
+            return tr("Message too short");
+        }
+        if (r == 0 && pos != 62){
+            return tr("The joints of the first robot are at byte %1 (expected 62)").arg(pos);
+        }
+        qint32 ndofs = qFromLittleEndian<qint32>(data + pos);
+        pos += 4;
+        if (ndofs != Robots[r].ndofs || pos != Robots[r].offset || !need(ndofs * 8)){
+            return tr("Invalid joints of %1 at byte %2").arg(Robots[r].robot->Name()).arg(pos);
+        }
+        tJoints joints = Robots[r].robot->Joints();
+        for (int i = 0; i < ndofs && i < joints.Length(); i++){
+            bits = qFromLittleEndian<quint64>(data + pos + 8 * i);
+            double value;
+            std::memcpy(&value, &bits, sizeof(value));
+            if (value != joints.ValuesD()[i]){
+                return tr("Invalid joint %1 of %2").arg(i + 1).arg(Robots[r].robot->Name());
+            }
+        }
+        pos += 8 * ndofs;
+    }
+    if (pos != OffsetParameters || pos + 8 * Parameters.size() != size){
+        return tr("The station parameters are at byte %1 and the message has %2 bytes").arg(pos).arg(size);
+    }
+    return QString();
+}
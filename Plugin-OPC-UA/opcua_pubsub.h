@@ -0,0 +1,112 @@
+#ifndef OPCUA_PUBSUB_H
+#define OPCUA_PUBSUB_H
+
+#include <QObject>
+#include <QTimer>
+#include <QUdpSocket>
+#include <QHostAddress>
+#include <QByteArray>
+#include <QStringList>
+#include <QVector>
+
+#include "robodktypes.h"
+#include "open62541.h"
+
+class PluginOPCUA;
+
+
+/// This class publishes the state of the station as OPC-UA PubSub UADP network messages over UDP (multicast or unicast).
+/// Each message holds one key frame DataSetMessage with RawData field encoding and a fixed layout:
+/// Time (DateTime), SimulationSpeed (Double), the joints of each robot (Double array) and the selected station parameters (Double, NaN if not numeric).
+/// The message is encoded once as a template when the layout changes. Each cycle only writes the sequence numbers, the timestamp and the values in place.
+/// The station parameters are read on a slower timer (ParametersInterval) so that each cycle doesn't build strings.
+class opcua_publisher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit opcua_publisher(PluginOPCUA *plugin);
+    ~opcua_publisher();
+
+    /// Start publishing to Url every Interval ms. Returns false if the URL is not valid.
+    bool Start();
+
+    /// Stop publishing
+    void Stop();
+
+    /// Returns true if the publisher is running
+    bool IsRunning();
+
+    /// Encode the message template again with the robots of the active station (the configuration version changes)
+    void UpdateLayout();
+
+    /// Send one message to a local socket and decode it independently of the encoder.
+    /// Returns an empty string if the offsets and values are the expected ones, or a description of the first mismatch.
+    QString CheckLoopback();
+
+public slots:
+    /// Write the current values in the message and send it
+    void Publish();
+
+    /// Read the station parameters published as numbers
+    void UpdateParameters();
+
+public:
+    /// Destination of the messages (for example: "opc.udp://224.0.0.22:4840" or "opc.udp://localhost:4840")
+    QString Url;
+
+    /// Publishing interval (ms)
+    int Interval;
+
+    /// Interval to read the station parameters (ms)
+    int ParametersInterval;
+
+    /// Station parameters published as numbers
+    QStringList Parameters;
+
+    /// Identifiers of the publisher, the writer group and the dataset writer
+    UA_UInt16 PublisherId;
+    UA_UInt16 WriterGroupId;
+    UA_UInt16 DataSetWriterId;
+
+    /// Pointer to the RoboDK plugin interface
+    PluginOPCUA *pPlugin;
+
+private:
+    /// Write the sequence numbers, the timestamps and the current values in the message
+    void WriteValues();
+
+    /// Robot published in the dataset and offset of its joints in the message
+    struct publisher_robot_t
+    {
+        Item robot;
+        int ndofs;
+        int offset;
+    };
+
+    QTimer Timer;
+    QTimer ParametersTimer;
+    QUdpSocket Socket;
+    QHostAddress Address;
+    quint16 Port;
+
+    /// Encoded message and offsets of the values written every cycle
+    QByteArray Message;
+    int OffsetSequenceNumber;
+    int OffsetTimestamp;
+    int OffsetDataSetSequenceNumber;
+    int OffsetDataSetTimestamp;
+    int OffsetTime;
+    int OffsetSimulationSpeed;
+    int OffsetParameters;
+    QVector<publisher_robot_t> Robots;
+
+    /// Last values of the station parameters (NaN if not numeric)
+    QVector<double> ParameterValues;
+
+    /// Sequence number of the messages and version of the layout
+    UA_UInt16 SequenceNumber;
+    UA_UInt32 ConfigVersion;
+};
+
+#endif // OPCUA_PUBSUB_H
@@ -0,0 +1,119 @@
+#include "opcua_requests.h"
+
+#include "pluginopcua.h"
+#include "irobodk.h"
+#include "iitem.h"
+
+#include <QThread>
+#include <QMetaObject>
+#include <QMutexLocker>
+#include <QDebug>
+
+
+opcua_requests::opcua_requests(PluginOPCUA *plugin) : QObject(NULL){
+    pPlugin = plugin;
+    SnapshotMaxAge = 50;
+    Enabled = false;
+    SnapshotValid = false;
+}
+
+UA_StatusCode opcua_requests::Run(const std::function<UA_StatusCode()> &request){
+    return Enqueue(request, false);
+}
+
+UA_StatusCode opcua_requests::Enqueue(const std::function<UA_StatusCode()> &request, bool read_only){
+    // Requests from the GUI thread don't need to be queued
+    if (QThread::currentThread() == thread()){
+        UA_StatusCode status = request();
+        if (!read_only){
+            QMutexLocker locker(&Lock);
+            SnapshotValid = false;
+        }
+        return status;
+    }
+
+    request_t queued;
+    queued.run = request;
+    queued.read_only = read_only;
+    std::future<UA_StatusCode> result = queued.result.get_future();
+    {
+        QMutexLocker locker(&Lock);
+        if (!Enabled){
+            return UA_STATUSCODE_BADSHUTDOWN;
+        }
+
+        // The GUI thread processes all the requests queued when it wakes up (only one with the single threaded server)
+        Queue.append(&queued);
+        if (Queue.size() == 1){
+            QMetaObject::invokeMethod(this, "ProcessQueue", Qt::QueuedConnection);
+        }
+    }
+    return result.get();
+}
+
+bool opcua_requests::Snapshot(const QString &station_parameter, opcua_snapshot_t &snapshot){
+    {
+        QMutexLocker locker(&Lock);
+        if (SnapshotValid && LastSnapshot.station_parameter == station_parameter && SnapshotAge.elapsed() < SnapshotMaxAge){
+            snapshot = LastSnapshot;
+            return true;
+        }
+    }
+
+    // Refresh all the values at once
+    UA_StatusCode status = Enqueue([&](){
+        snapshot.simulation_speed = pPlugin->RDK->SimulationSpeed();
+        snapshot.station_name = pPlugin->RDK->getActiveStation()->Name();
+        snapshot.station_parameter = station_parameter;
+        snapshot.station_value = station_parameter.isEmpty() ? QString() : pPlugin->RDK->getParam(station_parameter);
+
+        QMutexLocker locker(&Lock);
+        LastSnapshot = snapshot;
+        SnapshotAge.start();
+        SnapshotValid = true;
+        return UA_STATUSCODE_GOOD;
+    }, true);
+    return status == UA_STATUSCODE_GOOD;
+}
+
+void opcua_requests::setEnabled(bool enabled){
+    QList<request_t*> rejected;
+    {
+        QMutexLocker locker(&Lock);
+        Enabled = enabled;
+        SnapshotValid = false;
+        if (!enabled){
+            rejected.swap(Queue);
+        }
+    }
+
+    // Release the server thread if it is waiting for a request
+    for (request_t *request : rejected){
+        request->result.set_value(UA_STATUSCODE_BADSHUTDOWN);
+    }
+}
+
+void opcua_requests::ProcessQueue(){
+    QList<request_t*> pending;
+    {
+        QMutexLocker locker(&Lock);
+        pending.swap(Queue);
+    }
+    if (pending.isEmpty()){
+        return;
+    }
+
+    bool modified = false;
+    for (request_t *request : pending){
+        modified = modified || !request->read_only;
+        UA_StatusCode status = request->run();
+
+        // The request can't be used after the result is set: the caller owns it
+        request->result.set_value(status);
+    }
+
+    if (modified){
+        QMutexLocker locker(&Lock);
+        SnapshotValid = false;
+    }
+}
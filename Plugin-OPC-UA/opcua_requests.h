@@ -0,0 +1,86 @@
+#ifndef OPCUA_REQUESTS_H
+#define OPCUA_REQUESTS_H
+
+#include <QObject>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <QList>
+#include <QString>
+
+#include <functional>
+#include <future>
+
+#include "open62541.h"
+
+class PluginOPCUA;
+
+
+/// Snapshot of the RoboDK values that OPC-UA clients read the most
+struct opcua_snapshot_t
+{
+    /// Simulation speed ratio
+    double simulation_speed { 1.0 };
+
+    /// Name of the active station
+    QString station_name;
+
+    /// Name and value of the active station parameter
+    QString station_parameter;
+    QString station_value;
+};
+
+
+/// This class marshals the requests of the OPC-UA server thread to the GUI thread (the RoboDK API is not thread safe).
+/// The server runs in a single thread and waits for the result of each request through a future, so requests are processed one at a time
+/// and each one costs a turn of the GUI event loop. Pure reads are served from a snapshot of the RoboDK values, refreshed at most every SnapshotMaxAge ms,
+/// so most variable reads don't wait for the GUI thread.
+class opcua_requests : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit opcua_requests(PluginOPCUA *plugin);
+
+    /// Run a request on the GUI thread and wait for the result. Returns UA_STATUSCODE_BADSHUTDOWN if the requests are disabled.
+    UA_StatusCode Run(const std::function<UA_StatusCode()> &request);
+
+    /// Retrieve the snapshot of the RoboDK values for a station parameter. Returns false if the requests are disabled.
+    bool Snapshot(const QString &station_parameter, opcua_snapshot_t &snapshot);
+
+    /// Accept requests (when the server starts) or reject pending and new requests (when the server stops)
+    void setEnabled(bool enabled);
+
+public slots:
+    /// Process the queued requests (GUI thread)
+    void ProcessQueue();
+
+public:
+    /// Maximum age of the snapshot, in ms
+    int SnapshotMaxAge;
+
+private:
+    /// A queued request. It lives on the stack of the caller, which waits for the result.
+    struct request_t
+    {
+        std::function<UA_StatusCode()> run;
+        std::promise<UA_StatusCode> result;
+        bool read_only;
+    };
+
+    /// Queue a request and wait for the result. Requests that are not read only invalidate the snapshot.
+    UA_StatusCode Enqueue(const std::function<UA_StatusCode()> &request, bool read_only);
+
+    /// Pointer to the RoboDK plugin interface
+    PluginOPCUA *pPlugin;
+
+    /// Protects the queue, the enabled flag and the snapshot
+    QMutex Lock;
+    QList<request_t*> Queue;
+    bool Enabled;
+
+    opcua_snapshot_t LastSnapshot;
+    QElapsedTimer SnapshotAge;
+    bool SnapshotValid;
+};
+
+#endif // OPCUA_REQUESTS_H
@@ -0,0 +1,330 @@
+#include "opcua_robots.h"
+
+#include "irobodk.h"
+#include "iitem.h"
+
+#include <QMutexLocker>
+#include <QDebug>
+
+#include <algorithm>
+
+
+/// Node id of the folder holding the robot objects
+static const char *RobotsFolder = "Robots";
+
+// Node id of a robot object ("Robot_<key>") or one of its variables ("Robot_<key>.Joints"). Delete the members of the returned node id.
+static UA_NodeId robotNodeId(const QString &key, const char *variable = nullptr){
+    QByteArray name = QString("Robot_%1").arg(key).toUtf8();
+    if (variable != nullptr){
+        name += '.';
+        name += variable;
+    }
+    return UA_NODEID_STRING_ALLOC(1, name.constData());
+}
+
+// Add a read only variable to a robot object
+static void addRobotVariable(UA_Server *server, const QString &key, const char *variable, const char *description, const UA_Variant &value, UA_Int32 value_rank){
+    UA_NodeId parent = robotNodeId(key);
+    UA_NodeId node = robotNodeId(key, variable);
+
+    UA_VariableAttributes attr;
+    UA_VariableAttributes_init(&attr);
+    attr.description = UA_LOCALIZEDTEXT("en_US", description);
+    attr.displayName = UA_LOCALIZEDTEXT("en_US", variable);
+    attr.dataType = value.type->typeId;
+    attr.valueRank = value_rank;
+    attr.accessLevel = UA_ACCESSLEVELMASK_READ;
+    attr.value = value;
+    UA_Server_addVariableNode(server, node, parent, UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT),
+                              UA_QUALIFIEDNAME(1, variable), UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE), attr, NULL, NULL);
+
+    UA_NodeId_deleteMembers(&node);
+    UA_NodeId_deleteMembers(&parent);
+}
+
+// Write the value of a robot variable
+static void writeRobotVariable(UA_Server *server, const QString &key, const char *variable, const UA_Variant &value){
+    UA_NodeId node = robotNodeId(key, variable);
+    UA_Server_writeValue(server, node, value);
+    UA_NodeId_deleteMembers(&node);
+}
+
+// Add a suffix to a name until it is not in the list of used names ("Name", "Name_2", "Name_3"...)
+static QString uniqueName(const QString &name, QSet<QString> &used){
+    QString unique = name;
+    for (int n = 2; used.contains(unique); n++){
+        unique = QString("%1_%2").arg(name).arg(n);
+    }
+    used.insert(unique);
+    return unique;
+}
+
+
+opcua_robots::opcua_robots(){
+    ListChanged = false;
+}
+
+void opcua_robots::UpdateList(RoboDK *rdk){
+    Items = rdk->getItemList(IItem::ITEM_TYPE_ROBOT);
+
+    // Forget the last published states: everything is published again
+    Last.clear();
+    {
+        QMutexLocker locker(&Lock);
+        Pending.clear();
+
+        // Robots that are still in the station keep their node id, new robots get a node id based on their name.
+        // The browse names follow the robot names (renamed robots are updated when the list is retrieved again).
+        QHash<UA_UInt64, opcua_robot_name_t> names;
+        QSet<QString> used_keys;
+        for (Item robot : Items){
+            UA_UInt64 id = (UA_UInt64)robot;
+            auto it = Names.constFind(id);
+            if (it != Names.constEnd()){
+                names[id].key = it->key;
+                used_keys.insert(it->key);
+            }
+        }
+        QSet<QString> used_browse;
+        for (Item robot : Items){
+            UA_UInt64 id = (UA_UInt64)robot;
+            opcua_robot_name_t &name = names[id];
+            name.display = robot->Name();
+            name.browse = uniqueName(name.display, used_browse);
+            if (!Names.contains(id)){
+                // The dot separates the robot from its variables in the node ids
+                name.key = uniqueName(QString(name.display).replace('.', '_'), used_keys);
+            }
+        }
+        Names.swap(names);
+
+        QHash<UA_UInt64, QSharedPointer<opcua_joint_history>> histories;
+        for (Item robot : Items){
+            UA_UInt64 id = (UA_UInt64)robot;
+
+            // Keep the history of the robots that are still in the station
+            QSharedPointer<opcua_joint_history> history = Histories.value(id);
+            if (history.isNull()){
+                history.reset(new opcua_joint_history());
+            }
+            histories.insert(id, history);
+        }
+        Histories.swap(histories);
+        ListChanged = true;
+    }
+    UpdateStates(rdk);
+}
+
+void opcua_robots::UpdateStates(RoboDK *rdk, bool record_history){
+    UA_DateTime now = UA_DateTime_now();
+    QHash<UA_UInt64, opcua_robot_t> changes;
+    for (Item robot : Items){
+        if (!rdk->Valid(robot)){
+            continue;
+        }
+        UA_UInt64 id = (UA_UInt64)robot;
+        tJoints joints = robot->Joints();
+        if (record_history){
+            // Only this thread changes the list of histories
+            QSharedPointer<opcua_joint_history> history = Histories.value(id);
+            if (!history.isNull()){
+                history->Append(now, joints);
+            }
+        }
+
+        auto last = Last.find(id);
+        bool first = last == Last.end();
+        if (first){
+            last = Last.insert(id, opcua_robot_t());
+            last->name = robot->Name();
+        }
+        opcua_robot_t &state = last.value();
+        opcua_robot_t change = state;
+        change.joints_changed = first;
+        change.pose_changed = first;
+        change.busy_changed = first;
+
+        // Change detection: the pose only changes if the joints change
+        QVector<double> values(joints.ValuesD(), joints.ValuesD() + joints.Length());
+        if (first || values != state.joints){
+            change.joints = values;
+            change.joints_changed = true;
+
+            double pose[6];
+            robot->SolveFK(joints).ToXYZRPW(pose);
+            for (int i = 0; i < 6; i++){
+                if (pose[i] != state.pose[i]){
+                    change.pose_changed = true;
+                }
+                change.pose[i] = pose[i];
+            }
+        }
+
+        bool busy = robot->Busy();
+        if (busy != state.busy){
+            change.busy = busy;
+            change.busy_changed = true;
+        }
+
+        if (change.joints_changed || change.pose_changed || change.busy_changed){
+            state.joints = change.joints;
+            std::copy(change.pose, change.pose + 6, state.pose);
+            state.busy = change.busy;
+            changes.insert(id, change);
+        }
+    }
+
+    if (changes.isEmpty()){
+        return;
+    }
+
+    // Merge with the changes that were not published yet
+    QMutexLocker locker(&Lock);
+    for (auto it = changes.begin(); it != changes.end(); ++it){
+        auto pending = Pending.find(it.key());
+        if (pending != Pending.end()){
+            it->joints_changed = it->joints_changed || pending->joints_changed;
+            it->pose_changed = it->pose_changed || pending->pose_changed;
+            it->busy_changed = it->busy_changed || pending->busy_changed;
+        }
+        Pending.insert(it.key(), it.value());
+    }
+}
+
+QSharedPointer<opcua_joint_history> opcua_robots::History(UA_UInt64 id){
+    QMutexLocker locker(&Lock);
+    return Histories.value(id);
+}
+
+void opcua_robots::AddFolder(UA_Server *server){
+    Published.clear();
+
+    UA_ObjectAttributes attr;
+    UA_ObjectAttributes_init(&attr);
+    attr.description = UA_LOCALIZEDTEXT("en_US", "Robots of the active RoboDK station");
+    attr.displayName = UA_LOCALIZEDTEXT("en_US", RobotsFolder);
+    UA_Server_addObjectNode(server, UA_NODEID_STRING(1, RobotsFolder), UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                            UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES), UA_QUALIFIEDNAME(1, RobotsFolder),
+                            UA_NODEID_NUMERIC(0, UA_NS0ID_FOLDERTYPE), attr, NULL, NULL);
+
+    // The new server has no robot nodes: publish all the robots
+    QMutexLocker locker(&Lock);
+    ListChanged = true;
+}
+
+void opcua_robots::Apply(UA_Server *server){
+    QHash<UA_UInt64, opcua_robot_t> changes;
+    QHash<UA_UInt64, opcua_robot_name_t> names;
+    bool list_changed = false;
+    {
+        QMutexLocker locker(&Lock);
+        if (Pending.isEmpty() && !ListChanged){
+            return;
+        }
+        changes.swap(Pending);
+        if (ListChanged){
+            names = Names;
+            list_changed = true;
+            ListChanged = false;
+        }
+    }
+
+    if (list_changed){
+        // Remove the robots that are no longer in the station (or that got a new node id)
+        for (auto it = Published.begin(); it != Published.end();){
+            auto name = names.constFind(it.key());
+            if (name != names.constEnd() && name->key == it->key){
+                ++it;
+                continue;
+            }
+            const char *variables[3] = {"Joints", "Pose", "Busy"};
+            for (const char *variable : variables){
+                UA_NodeId node = robotNodeId(it->key, variable);
+                UA_Server_deleteNode(server, node, true);
+                UA_NodeId_deleteMembers(&node);
+            }
+            UA_NodeId node = robotNodeId(it->key);
+            UA_Server_deleteNode(server, node, true);
+            UA_NodeId_deleteMembers(&node);
+            it = Published.erase(it);
+        }
+
+        // Rename the robots that were renamed (or whose browse name changed because of another robot)
+        for (auto it = Published.begin(); it != Published.end(); ++it){
+            const opcua_robot_name_t &name = names[it.key()];
+            if (name.browse == it->browse && name.display == it->display){
+                continue;
+            }
+            QByteArray browse = name.browse.toUtf8();
+            QByteArray display = name.display.toUtf8();
+            UA_NodeId node = robotNodeId(name.key);
+            UA_Server_writeBrowseName(server, node, UA_QUALIFIEDNAME(1, browse.data()));
+            UA_Server_writeDisplayName(server, node, UA_LOCALIZEDTEXT("en_US", display.data()));
+            UA_NodeId_deleteMembers(&node);
+            it.value() = name;
+        }
+
+        // Add the new robots
+        for (auto it = names.begin(); it != names.end(); ++it){
+            UA_UInt64 id = it.key();
+            if (Published.contains(id)){
+                continue;
+            }
+            const QString &key = it->key;
+            QByteArray browse = it->browse.toUtf8();
+            QByteArray display = it->display.toUtf8();
+            UA_NodeId node = robotNodeId(key);
+            UA_ObjectAttributes attr;
+            UA_ObjectAttributes_init(&attr);
+            attr.description = UA_LOCALIZEDTEXT("en_US", "RoboDK robot");
+            attr.displayName = UA_LOCALIZEDTEXT("en_US", display.data());
+            UA_Server_addObjectNode(server, node, UA_NODEID_STRING(1, RobotsFolder), UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                    UA_QUALIFIEDNAME(1, browse.data()), UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE), attr, NULL, NULL);
+            UA_NodeId_deleteMembers(&node);
+
+            // Empty values: the pending state is written below
+            UA_Variant empty_array;
+            UA_Variant_init(&empty_array);
+            UA_Variant_setArray(&empty_array, UA_EMPTY_ARRAY_SENTINEL, 0, &UA_TYPES[UA_TYPES_DOUBLE]);
+            UA_Boolean busy = false;
+            UA_Variant busy_value;
+            UA_Variant_init(&busy_value);
+            UA_Variant_setScalar(&busy_value, &busy, &UA_TYPES[UA_TYPES_BOOLEAN]);
+            addRobotVariable(server, key, "Joints", "Robot joints (deg or mm)", empty_array, 1);
+            addRobotVariable(server, key, "Pose", "Robot flange with respect to the robot base [x,y,z,r,p,w] (mm and deg)", empty_array, 1);
+            addRobotVariable(server, key, "Busy", "True if the robot is moving", busy_value, -1);
+            Published.insert(id, it.value());
+        }
+    }
+
+    // Write the values that changed
+    for (auto it = changes.begin(); it != changes.end(); ++it){
+        auto published = Published.constFind(it.key());
+        if (published == Published.constEnd()){
+            continue;
+        }
+        const QString &key = published->key;
+        opcua_robot_t &state = it.value();
+        UA_Variant value;
+        if (state.joints_changed){
+            UA_Variant_init(&value);
+            UA_Variant_setArray(&value, state.joints.data(), state.joints.size(), &UA_TYPES[UA_TYPES_DOUBLE]);
+            writeRobotVariable(server, key, "Joints", value);
+        }
+        if (state.pose_changed){
+            UA_Variant_init(&value);
+            UA_Variant_setArray(&value, state.pose, 6, &UA_TYPES[UA_TYPES_DOUBLE]);
+            writeRobotVariable(server, key, "Pose", value);
+        }
+        if (state.busy_changed){
+            UA_Boolean busy = state.busy;
+            UA_Variant_init(&value);
+            UA_Variant_setScalar(&value, &busy, &UA_TYPES[UA_TYPES_BOOLEAN]);
+            writeRobotVariable(server, key, "Busy", value);
+        }
+    }
+}
+
+void opcua_robots::ApplyJob(UA_Server *server, void *data){
+    static_cast<opcua_robots*>(data)->Apply(server);
+}
@@ -0,0 +1,101 @@
+#ifndef OPCUA_ROBOTS_H
+#define OPCUA_ROBOTS_H
+
+#include <QMutex>
+#include <QHash>
+#include <QSet>
+#include <QList>
+#include <QString>
+#include <QVector>
+#include <QSharedPointer>
+
+#include "robodktypes.h"
+#include "open62541.h"
+#include "opcua_history.h"
+
+
+/// State of a robot published by the OPC-UA server
+struct opcua_robot_t
+{
+    /// Robot name
+    QString name;
+
+    /// Robot joints (deg or mm)
+    QVector<double> joints;
+
+    /// Robot flange with respect to the robot base as [x,y,z,r,p,w] (mm and deg)
+    double pose[6] { 0, 0, 0, 0, 0, 0 };
+
+    /// True if the robot is moving
+    bool busy { false };
+
+    /// Values that changed since they were last published
+    bool joints_changed { true };
+    bool pose_changed { true };
+    bool busy_changed { true };
+};
+
+
+/// Names of a robot object in the server
+struct opcua_robot_name_t
+{
+    /// Node id of the robot object ("Robot_<key>"). The key is derived from the robot name when the robot is first published
+    /// and kept while the robot is in the station, so renaming a robot does not break the monitored items of the clients.
+    QString key;
+
+    /// Browse name: the robot name, with a suffix if several robots have the same name
+    QString browse;
+
+    /// Display name: the robot name
+    QString display;
+};
+
+
+/// This class publishes each robot of the active station as an OPC-UA object with Joints, Pose and Busy variables (in the Robots folder).
+/// The GUI thread reads the robots and keeps only the values that changed. The server thread writes these values to the variable nodes,
+/// so monitored items of subscribed clients only notify changes.
+class opcua_robots
+{
+public:
+    opcua_robots();
+
+    /// Retrieve the list of robots of the active station and their names (GUI thread). All values are published again.
+    void UpdateList(RoboDK *rdk);
+
+    /// Read the robot states and keep the values that changed (GUI thread). The joints are added to the history of each robot if record_history is set.
+    void UpdateStates(RoboDK *rdk, bool record_history = false);
+
+    /// Retrieve the joint history of a robot, or a null pointer if the robot is not published (any thread)
+    QSharedPointer<opcua_joint_history> History(UA_UInt64 id);
+
+    /// Add the Robots folder to a new server and publish all the robots (server thread)
+    void AddFolder(UA_Server *server);
+
+    /// Add or remove robot objects and write the values that changed (server thread)
+    void Apply(UA_Server *server);
+
+    /// Repeated job of the server that calls \ref Apply. The data is a pointer to this object.
+    static void ApplyJob(UA_Server *server, void *data);
+
+    /// Interval of the repeated job that publishes the changes (ms, must be larger than 5 ms)
+    static const UA_UInt32 PublishInterval = 10;
+
+private:
+    /// Robots of the active station and their last published state (GUI thread)
+    QList<Item> Items;
+    QHash<UA_UInt64, opcua_robot_t> Last;
+
+    /// Values to publish, shared between the GUI and the server thread
+    QMutex Lock;
+    QHash<UA_UInt64, opcua_robot_t> Pending;
+    QHash<UA_UInt64, opcua_robot_name_t> Names;
+    bool ListChanged;
+
+    /// Joint history of each robot. Only the GUI thread changes the list (under Lock) and appends samples.
+    QHash<UA_UInt64, QSharedPointer<opcua_joint_history>> Histories;
+
+    /// Robots with nodes in the server and their names (server thread)
+    QHash<UA_UInt64, opcua_robot_name_t> Published;
+};
+
+#endif // OPCUA_ROBOTS_H
@@ -9,6 +9,7 @@
 #include "opcua_tools.h"
 
 #include <thread>
+#include <algorithm>
 #include <signal.h>
 #include <errno.h> // errno, EINTR
 #include <stdio.h>
@@ -42,6 +43,16 @@ UA_Logger logger = UA_Log_Stdout;
 
 QString ActiveStationParameter;
 
+/// Storage of the values read by the clients (server thread). The variants of the read callbacks point to it, so the values are not copied.
+/// This is only safe for the read callbacks: each buffer backs a single node, and the sampling of the subscriptions copies the values that are not owned.
+/// The server encodes the response once all the nodes of a request are read, so a node read twice in the same request returns its last value twice.
+/// Method outputs must be copied: the same method can be called several times in a request (a shared buffer would return the result of the last call).
+static UA_DateTime TimeValue;
+static UA_Double SimulationSpeedValue;
+static opcua_string_ref_t StationNameValue;
+static opcua_string_ref_t StationParameterValue;
+static opcua_string_ref_t StationValueValue;
+
 
 /// Turns on when the server started running. We can set this flag to false to stop the server
 UA_Boolean SERVER_RUNNING;
@@ -63,7 +74,7 @@ void ShowMessage(PluginOPCUA *pPlugin, const QString &msg){
 }
 
 
-opcua_server::opcua_server(PluginOPCUA *plugin) : QObject(NULL){
+opcua_server::opcua_server(PluginOPCUA *plugin) : QObject(NULL), Requests(plugin){
     SERVER_RUNNING = UA_FALSE;
     SERVER_RUNNING_PORT = -1;
     Port = 4840;
@@ -92,6 +103,8 @@ void opcua_server::Start(){
     }
 
     pPlugin->action_StartServer->setChecked(true);
+    Requests.setEnabled(true);
+    Robots.UpdateList(pPlugin->RDK);
 
     std::thread opc_thread(opc_server_thread, pPlugin, port);
     opc_thread.detach();
@@ -107,6 +120,9 @@ void opcua_server::Stop(){
         }        
     }
     SERVER_RUNNING = UA_FALSE;
+
+    // Release the server thread if it waits for the GUI thread
+    Requests.setEnabled(false);
 }
 
 bool opcua_server::IsStopped(){
@@ -128,6 +144,17 @@ QString opcua_server::Status(){
     return tr("Server Stopped");
 }
 
+void opcua_server::UpdateRobots(bool list_changed, bool trajectory_step){
+    if (SERVER_RUNNING == UA_FALSE){
+        return;
+    }
+    if (list_changed){
+        Robots.UpdateList(pPlugin->RDK);
+    } else {
+        Robots.UpdateStates(pPlugin->RDK, trajectory_step);
+    }
+}
+
 
 static UA_ByteString loadCertificate(void) {
     UA_ByteString certificate = UA_STRING_NULL;
@@ -170,7 +197,8 @@ static UA_StatusCode read_Time(void *h, const UA_NodeId nodeId, UA_Boolean sourc
         return UA_STATUSCODE_GOOD;
     }
     UA_DateTime currentTime = UA_DateTime_now();
-    UA_Variant_setScalarCopy(&value->value, &currentTime, &UA_TYPES[UA_TYPES_DATETIME]);
+    TimeValue = currentTime;
+    DateTime_2_VarRef(&TimeValue, &value->value);
     value->hasValue = true;
     if(sourceTimeStamp) {
         value->hasSourceTimestamp = true;
@@ -186,8 +214,14 @@ static UA_StatusCode read_SimRatio(void *h, const UA_NodeId nodeId, UA_Boolean s
         value->status = UA_STATUSCODE_BADINDEXRANGEINVALID;
         return UA_STATUSCODE_GOOD;
     }
-    double ratio = plugin->RDK->SimulationSpeed();
-    UA_Variant_setScalarCopy(&value->value, &ratio, &UA_TYPES[UA_TYPES_DOUBLE]);
+    opcua_snapshot_t snapshot;
+    if (!plugin->Server->Requests.Snapshot(ActiveStationParameter, snapshot)){
+        value->hasStatus = true;
+        value->status = UA_STATUSCODE_BADSHUTDOWN;
+        return UA_STATUSCODE_GOOD;
+    }
+    SimulationSpeedValue = snapshot.simulation_speed;
+    Double_2_VarRef(&SimulationSpeedValue, &value->value);
     value->hasValue = true;
     if(sourceTimeStamp) {
         value->hasSourceTimestamp = true;
@@ -200,9 +234,12 @@ UA_StatusCode write_SimRatio(void *h, const UA_NodeId nodeid, const UA_Variant *
     PluginOPCUA *plugin = (PluginOPCUA*)h;
     UA_Double simulation_ratio;
     simulation_ratio = ((UA_Double*) (data->data))[0];
-    plugin->RDK->setSimulationSpeed(simulation_ratio);
+    UA_StatusCode status = plugin->Server->Requests.Run([&](){
+        plugin->RDK->setSimulationSpeed(simulation_ratio);
+        return UA_STATUSCODE_GOOD;
+    });
     ShowMessage(plugin, QObject::tr("New RoboDK simulation speed set to %1").arg(simulation_ratio));
-    return UA_STATUSCODE_GOOD;
+    return status;
 }
 
 static UA_StatusCode read_OpenStationName(void *h, const UA_NodeId nodeid, UA_Boolean sourceTimeStamp, const UA_NumericRange *range, UA_DataValue *value) {
@@ -212,8 +249,13 @@ static UA_StatusCode read_OpenStationName(void *h, const UA_NodeId nodeid, UA_Bo
         value->status = UA_STATUSCODE_BADINDEXRANGEINVALID;
         return UA_STATUSCODE_GOOD;
     }
-    QString str_stationname = plugin->RDK->getActiveStation()->Name();
-    Str_2_Var(str_stationname, &value->value);
+    opcua_snapshot_t snapshot;
+    if (!plugin->Server->Requests.Snapshot(ActiveStationParameter, snapshot)){
+        value->hasStatus = true;
+        value->status = UA_STATUSCODE_BADSHUTDOWN;
+        return UA_STATUSCODE_GOOD;
+    }
+    Str_2_VarRef(snapshot.station_name, StationNameValue, &value->value);
     value->hasValue = true;
     if(sourceTimeStamp) {
         value->hasSourceTimestamp = true;
@@ -236,14 +278,22 @@ UA_StatusCode write_OpenStationName(void *h, const UA_NodeId nodeid, const UA_Va
         ShowMessage(plugin, QObject::tr("File not found: %1").arg(stationname));
         problems = true;
     } else {
-        Item station = plugin->RDK->AddFile(stationname);
-        if (station == nullptr){
-            problems = true;
-        }
+        plugin->Server->Requests.Run([&](){
+            Item station = plugin->RDK->AddFile(stationname);
+            if (station == nullptr){
+                problems = true;
+            }
+            return UA_STATUSCODE_GOOD;
+        });
     }
     if (problems){
+        QString current_station;
+        plugin->Server->Requests.Run([&](){
+            current_station = plugin->RDK->getActiveStation()->Name();
+            return UA_STATUSCODE_GOOD;
+        });
         ShowMessage(plugin, QObject::tr("File not valid or not found: %1").arg(stationname));
-        ShowMessage(plugin, QObject::tr("Current station: %1").arg(plugin->RDK->getActiveStation()->Name()));
+        ShowMessage(plugin, QObject::tr("Current station: %1").arg(current_station));
     }
     return UA_STATUSCODE_GOOD;
 }
@@ -254,7 +304,7 @@ static UA_StatusCode read_StationParameter(void *h, const UA_NodeId nodeid, UA_B
         value->status = UA_STATUSCODE_BADINDEXRANGEINVALID;
         return UA_STATUSCODE_GOOD;
     }
-    Str_2_Var(ActiveStationParameter, &value->value);
+    Str_2_VarRef(ActiveStationParameter, StationParameterValue, &value->value);
     value->hasValue = true;
     if(sourceTimeStamp) {
         value->hasSourceTimestamp = true;
@@ -276,8 +326,13 @@ static UA_StatusCode read_StationValue(void *h, const UA_NodeId nodeid, UA_Boole
         value->status = UA_STATUSCODE_BADINDEXRANGEINVALID;
         return UA_STATUSCODE_GOOD;
     }
-    QString station_value = plugin->RDK->getParam(ActiveStationParameter);
-    Str_2_Var(station_value, &value->value);
+    opcua_snapshot_t snapshot;
+    if (!plugin->Server->Requests.Snapshot(ActiveStationParameter, snapshot)){
+        value->hasStatus = true;
+        value->status = UA_STATUSCODE_BADSHUTDOWN;
+        return UA_STATUSCODE_GOOD;
+    }
+    Str_2_VarRef(snapshot.station_value, StationValueValue, &value->value);
     value->hasValue = true;
     if(sourceTimeStamp) {
         value->hasSourceTimestamp = true;
@@ -291,8 +346,11 @@ UA_StatusCode write_StationValue(void *h, const UA_NodeId nodeid, const UA_Varia
     QString stationvalue;
     Var_2_Str(data+0, stationvalue);
     ShowMessage(plugin, QObject::tr("Active Station value set to %1").arg(stationvalue));
-    plugin->RDK->setParam(ActiveStationParameter, stationvalue);
-    return UA_STATUSCODE_GOOD;
+    QString stationparameter = ActiveStationParameter;
+    return plugin->Server->Requests.Run([&](){
+        plugin->RDK->setParam(stationparameter, stationvalue);
+        return UA_STATUSCODE_GOOD;
+    });
 }
 
 #ifdef UA_ENABLE_METHODCALLS
@@ -300,128 +358,183 @@ UA_StatusCode write_StationValue(void *h, const UA_NodeId nodeid, const UA_Varia
 
 static UA_StatusCode setJoints(void *h, const UA_NodeId objectId, size_t inputSize, const UA_Variant *input, size_t outputSize, UA_Variant *output) {
     PluginOPCUA *plugin = (PluginOPCUA*)h;
-    if (inputSize < 2){
-        return UA_STATUSCODE_BADARGUMENTSMISSING;
-    }
-    Item item;
-    if (!Var_2_Item(input + 0, &item, plugin->RDK)){
-        return UA_STATUSCODE_BADARGUMENTSMISSING;
-    }
-    //if (!plugin->RDK->Valid(item)){
-    //        ShowMessage(plugin, QObject::tr("setJoints: RoboDK Item provided is not valid"));
-    //        return UA_STATUSCODE_BADARGUMENTSMISSING;
-    //}
+    // The RoboDK API must be used from the GUI thread
+    return plugin->Server->Requests.Run([&]() -> UA_StatusCode {
+        if (inputSize < 2){
+            return UA_STATUSCODE_BADARGUMENTSMISSING;
+        }
+        Item item;
+        if (!Var_2_Item(input + 0, &item, plugin->RDK)){
+            return UA_STATUSCODE_BADARGUMENTSMISSING;
+        }
+        //if (!plugin->RDK->Valid(item)){
+        //        ShowMessage(plugin, QObject::tr("setJoints: RoboDK Item provided is not valid"));
+        //        return UA_STATUSCODE_BADARGUMENTSMISSING;
+        //}
 
-    double joint_values[nDOFs_MAX];
+        double joint_values[nDOFs_MAX];
 
-    // Retrieve current robot joints and number of axes
-    tJoints current_joints = item->Joints();
-    current_joints.GetValues(joint_values);
-    int joints_ndofs = current_joints.Length();
+        // Retrieve current robot joints and number of axes
+        tJoints current_joints = item->Joints();
+        current_joints.GetValues(joint_values);
+        int joints_ndofs = current_joints.Length();
 
 
-    //Var_2_DoubleArray(input+1, joints, nDOFs_MAX);
-    if (!Var_2_DoubleArray(input+1, joint_values, nDOFs_MAX)){
-        return UA_STATUSCODE_BADARGUMENTSMISSING;
-    }
-    tJoints new_joints(joint_values, joints_ndofs);
-    item->setJoints(new_joints);
-    return UA_STATUSCODE_GOOD;
+        //Var_2_DoubleArray(input+1, joints, nDOFs_MAX);
+        if (!Var_2_DoubleArray(input+1, joint_values, nDOFs_MAX)){
+            return UA_STATUSCODE_BADARGUMENTSMISSING;
+        }
+        tJoints new_joints(joint_values, joints_ndofs);
+        item->setJoints(new_joints);
+        return UA_STATUSCODE_GOOD;
+    });
 }
 static UA_StatusCode setJointsStr(void *h, const UA_NodeId objectId, size_t inputSize, const UA_Variant *input, size_t outputSize, UA_Variant *output) {
     PluginOPCUA *plugin = (PluginOPCUA*)h;
-    if (inputSize < 2){
-        qDebug()<<"Input size: " << inputSize << "  Output size: " << outputSize;
-        return UA_STATUSCODE_BADARGUMENTSMISSING;
-    }
-    QString str_item;
-    QString str_joints;
-    if (!Var_2_Str(input+0, str_item)){
-        return UA_STATUSCODE_BADARGUMENTSMISSING;
-    }
-    if (!Var_2_Str(input+1, str_joints)){
-        return UA_STATUSCODE_BADARGUMENTSMISSING;
-    }
-    Item item = plugin->RDK->getItem(str_item);
-    if (!plugin->RDK->Valid(item)){ //if (!ItemValid(robot)){
-        ShowMessage(plugin, QObject::tr("setJointsStr: RoboDK Item provided is not valid"));
-        return UA_STATUSCODE_BADARGUMENTSMISSING;
-    }
-    double joint_values[nDOFs_MAX];
-    tJoints current_joints = item->Joints();
-    current_joints.GetValues(joint_values);
-    int joints_ndofs = current_joints.Length();
-    int numel = nDOFs_MAX;
-    string_2_doubles(str_joints, joint_values, &numel);
-    if (numel <= 0){
-        ShowMessage(plugin, QObject::tr("setJointsStr: Invalid joints string"));
-        return UA_STATUSCODE_BADARGUMENTSMISSING;
-    }
-    tJoints new_joints(joint_values, joints_ndofs);
-    item->setJoints(new_joints);
-    plugin->RDK->Render();
-    return UA_STATUSCODE_GOOD;
+    // The RoboDK API must be used from the GUI thread
+    return plugin->Server->Requests.Run([&]() -> UA_StatusCode {
+        if (inputSize < 2){
+            qDebug()<<"Input size: " << inputSize << "  Output size: " << outputSize;
+            return UA_STATUSCODE_BADARGUMENTSMISSING;
+        }
+        QString str_item;
+        QString str_joints;
+        if (!Var_2_Str(input+0, str_item)){
+            return UA_STATUSCODE_BADARGUMENTSMISSING;
+        }
+        if (!Var_2_Str(input+1, str_joints)){
+            return UA_STATUSCODE_BADARGUMENTSMISSING;
+        }
+        Item item = plugin->RDK->getItem(str_item);
+        if (!plugin->RDK->Valid(item)){ //if (!ItemValid(robot)){
+            ShowMessage(plugin, QObject::tr("setJointsStr: RoboDK Item provided is not valid"));
+            return UA_STATUSCODE_BADARGUMENTSMISSING;
+        }
+        double joint_values[nDOFs_MAX];
+        tJoints current_joints = item->Joints();
+        current_joints.GetValues(joint_values);
+        int joints_ndofs = current_joints.Length();
+        int numel = nDOFs_MAX;
+        string_2_doubles(str_joints, joint_values, &numel);
+        if (numel <= 0){
+            ShowMessage(plugin, QObject::tr("setJointsStr: Invalid joints string"));
+            return UA_STATUSCODE_BADARGUMENTSMISSING;
+        }
+        tJoints new_joints(joint_values, joints_ndofs);
+        item->setJoints(new_joints);
+        plugin->RDK->Render();
+        return UA_STATUSCODE_GOOD;
+    });
 }
 
 static UA_StatusCode getJoints(void *h, const UA_NodeId objectId, size_t inputSize, const UA_Variant *input, size_t outputSize, UA_Variant *output) {
     PluginOPCUA *plugin = (PluginOPCUA*)h;
-    /* input is a scalar string (checked by the server) */
-    if (inputSize < 1 || outputSize < 1){
-        return UA_STATUSCODE_BADARGUMENTSMISSING;
-    }
-    Item item;
-    if (!Var_2_Item(input + 0, &item, plugin->RDK)){
-        return UA_STATUSCODE_BADARGUMENTSMISSING;
-    }
-    if (!plugin->RDK->Valid(item)){
-        ShowMessage(plugin, QObject::tr("getJoints: RoboDK Item provided is not valid"));
-        return UA_STATUSCODE_BADARGUMENTSMISSING;
-    }
-    double joints[nDOFs_MAX];
-    for (int i=0; i<nDOFs_MAX; i++){
-        joints[i] = 0;
-    }
-    DoubleArray_2_Var(item->Joints().Values(), nDOFs_MAX, output + 0);
-    return UA_STATUSCODE_GOOD;
+    // The RoboDK API must be used from the GUI thread
+    return plugin->Server->Requests.Run([&]() -> UA_StatusCode {
+        /* input is a scalar string (checked by the server) */
+        if (inputSize < 1 || outputSize < 1){
+            return UA_STATUSCODE_BADARGUMENTSMISSING;
+        }
+        Item item;
+        if (!Var_2_Item(input + 0, &item, plugin->RDK)){
+            return UA_STATUSCODE_BADARGUMENTSMISSING;
+        }
+        if (!plugin->RDK->Valid(item)){
+            ShowMessage(plugin, QObject::tr("getJoints: RoboDK Item provided is not valid"));
+            return UA_STATUSCODE_BADARGUMENTSMISSING;
+        }
+        // Each call of the request has its own copy of the output
+        tJoints joints = item->Joints();
+        DoubleArray_2_Var(joints.ValuesD(), nDOFs_MAX, output + 0);
+        return UA_STATUSCODE_GOOD;
+    });
 }
 
 static UA_StatusCode getJointsStr(void *h, const UA_NodeId objectId, size_t inputSize, const UA_Variant *input, size_t outputSize, UA_Variant *output) {
     PluginOPCUA *plugin = (PluginOPCUA*)h;
-    /* input is a scalar string (checked by the server) */
-    if (inputSize < 1 || outputSize < 1){
-        //plugin->AddLog(QObject::tr("Invalid Input/Output size for getJointsStr: %1/%2").arg(inputSize).arg(outputSize));
-        return UA_STATUSCODE_BADARGUMENTSMISSING;
-    }
-    QString str_item;
-    if (!Var_2_Str(input+0, str_item)){
-        return UA_STATUSCODE_BADARGUMENTSMISSING;
-    }
-    Item item = plugin->RDK->getItem(str_item);
-    if (!plugin->RDK->Valid(item)){ //if (!ItemValid(item)){
-        ShowMessage(plugin, QObject::tr("getJointsStr: RoboDK Item name provided is not valid"));
-        return UA_STATUSCODE_BADARGUMENTSMISSING;
-    }
-    tJoints joints = item->Joints();
-    QString str_joints = doubles_2_string(joints.ValuesD(), joints.Length(), 6, ", ");
-    Str_2_Var(str_joints, output+0);
-    return UA_STATUSCODE_GOOD;
+    // The RoboDK API must be used from the GUI thread
+    return plugin->Server->Requests.Run([&]() -> UA_StatusCode {
+        /* input is a scalar string (checked by the server) */
+        if (inputSize < 1 || outputSize < 1){
+            //plugin->AddLog(QObject::tr("Invalid Input/Output size for getJointsStr: %1/%2").arg(inputSize).arg(outputSize));
+            return UA_STATUSCODE_BADARGUMENTSMISSING;
+        }
+        QString str_item;
+        if (!Var_2_Str(input+0, str_item)){
+            return UA_STATUSCODE_BADARGUMENTSMISSING;
+        }
+        Item item = plugin->RDK->getItem(str_item);
+        if (!plugin->RDK->Valid(item)){ //if (!ItemValid(item)){
+            ShowMessage(plugin, QObject::tr("getJointsStr: RoboDK Item name provided is not valid"));
+            return UA_STATUSCODE_BADARGUMENTSMISSING;
+        }
+        tJoints joints = item->Joints();
+        QString str_joints = doubles_2_string(joints.ValuesD(), joints.Length(), 6, ", ");
+        Str_2_Var(str_joints, output+0);
+        return UA_STATUSCODE_GOOD;
+    });
 }
 static UA_StatusCode getItem(void *h, const UA_NodeId objectId, size_t inputSize, const UA_Variant *input, size_t outputSize, UA_Variant *output) {
     PluginOPCUA *plugin = (PluginOPCUA*)h;
-    if (inputSize < 1 || outputSize < 1){
+    // The RoboDK API must be used from the GUI thread
+    return plugin->Server->Requests.Run([&]() -> UA_StatusCode {
+        if (inputSize < 1 || outputSize < 1){
+            return UA_STATUSCODE_BADARGUMENTSMISSING;
+        }
+        QString name;
+        if (!Var_2_Str(input + 0, name)){
+            return UA_STATUSCODE_BADARGUMENTSMISSING;
+        }
+        // Retrieve the RoboDK item as a pointer
+        Item item = plugin->RDK->getItem(name);
+        if (!plugin->RDK->Valid(item)){ //if (item == nullptr){
+            ShowMessage(plugin, QObject::tr("getItem: RoboDK Item name provided does not exist"));
+        }
+        UA_UInt64 item_id = (UA_UInt64)item;
+        Item_2_Var(item_id, output+0);
+        return UA_STATUSCODE_GOOD;
+    });
+}
+
+static UA_StatusCode getJointsHistory(void *h, const UA_NodeId objectId, size_t inputSize, const UA_Variant *input, size_t outputSize, UA_Variant *output) {
+    PluginOPCUA *plugin = (PluginOPCUA*)h;
+    // The history is read from the ring buffer of the robot: the RoboDK API is not used
+    // All 4 arguments are required (the server rejects calls with a different number of arguments)
+    if (inputSize < 4 || outputSize < 2){
         return UA_STATUSCODE_BADARGUMENTSMISSING;
     }
-    QString name;
-    if (!Var_2_Str(input + 0, name)){
+    UA_DateTime start;
+    UA_DateTime end;
+    UA_UInt32 max_samples;
+    if (input[0].type != &UA_TYPES[UA_TYPES_UINT64] || !Var_2_DateTime(input + 1, &start) || !Var_2_DateTime(input + 2, &end) || !Var_2_UInt32(input + 3, &max_samples)){
         return UA_STATUSCODE_BADARGUMENTSMISSING;
     }
-    // Retrieve the RoboDK item as a pointer
-    Item item = plugin->RDK->getItem(name);
-    if (!plugin->RDK->Valid(item)){ //if (item == nullptr){
-        ShowMessage(plugin, QObject::tr("getItem: RoboDK Item name provided does not exist"));
+    UA_UInt64 item_id = *(UA_UInt64*)input[0].data;
+    if (max_samples == 0){
+        max_samples = opcua_joint_history::Capacity;
+    }
+
+    QSharedPointer<opcua_joint_history> history = plugin->Server->Robots.History(item_id);
+    if (history.isNull()){
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
     }
-    UA_UInt64 item_id = (UA_UInt64)item;
-    Item_2_Var(item_id, output+0);
+    QVector<opcua_joint_sample_t> samples;
+    int nsamples = history->Read(start, end, qMin<UA_UInt32>(max_samples, opcua_joint_history::Capacity), samples);
+
+    // Timestamps and a matrix of joints (one row per sample)
+    int ndofs = nsamples > 0 ? samples[0].ndofs : 0;
+    QVector<UA_DateTime> times(nsamples);
+    QVector<double> joints(nsamples * ndofs, 0.0);
+    for (int i = 0; i < nsamples; i++){
+        times[i] = samples[i].time;
+        std::copy(samples[i].joints, samples[i].joints + qMin(ndofs, samples[i].ndofs), joints.data() + i * ndofs);
+    }
+    UA_Variant_setArrayCopy(output + 0, times.constData(), nsamples, &UA_TYPES[UA_TYPES_DATETIME]);
+    UA_Variant_setArrayCopy(output + 1, joints.constData(), joints.size(), &UA_TYPES[UA_TYPES_DOUBLE]);
+    output[1].arrayDimensions = (UA_UInt32*) UA_Array_new(2, &UA_TYPES[UA_TYPES_UINT32]);
+    output[1].arrayDimensionsSize = 2;
+    output[1].arrayDimensions[0] = nsamples;
+    output[1].arrayDimensions[1] = ndofs;
     return UA_STATUSCODE_GOOD;
 }
 #endif
@@ -444,7 +557,11 @@ int opc_server_thread(PluginOPCUA *pPlugin, unsigned short port) {
     UA_Server *server = UA_Server_new(config);
 
     // Add the RoboDK version as a static variable node to the server
-    QString RoboDKVersion = pPlugin->RDK->Version();
+    QString RoboDKVersion;
+    pPlugin->Server->Requests.Run([&](){
+        RoboDKVersion = pPlugin->RDK->Version();
+        return UA_STATUSCODE_GOOD;
+    });
     UA_VariableAttributes rdkver;
     UA_VariableAttributes_init(&rdkver);
     rdkver.description = UA_LOCALIZEDTEXT("en_US", RoboDKVersion.toUtf8().constData());
@@ -718,8 +835,69 @@ int opc_server_thread(PluginOPCUA *pPlugin, unsigned short port) {
         pPlugin, // plugin handle
         1, &inItem, 1, &outItem, nullptr);
 
+
+    //////////////////////////////////////////////////////////////////
+    /// \brief getJointsHistory
+    ///
+    UA_Argument inHistory[4];
+    for (int i = 0; i < 4; i++){
+        UA_Argument_init(&inHistory[i]);
+        inHistory[i].arrayDimensionsSize = 0;
+        inHistory[i].arrayDimensions = nullptr;
+        inHistory[i].valueRank = -1;
+    }
+    inHistory[0].dataType = UA_TYPES[UA_TYPES_UINT64].typeId;
+    inHistory[0].description = UA_LOCALIZEDTEXT("en_US", "RoboDK Item ID of the robot");
+    inHistory[0].name = UA_STRING("Item ID");
+    inHistory[1].dataType = UA_TYPES[UA_TYPES_DATETIME].typeId;
+    inHistory[1].description = UA_LOCALIZEDTEXT("en_US", "Start of the time range");
+    inHistory[1].name = UA_STRING("Start time");
+    inHistory[2].dataType = UA_TYPES[UA_TYPES_DATETIME].typeId;
+    inHistory[2].description = UA_LOCALIZEDTEXT("en_US", "End of the time range");
+    inHistory[2].name = UA_STRING("End time");
+    inHistory[3].dataType = UA_TYPES[UA_TYPES_UINT32].typeId;
+    inHistory[3].description = UA_LOCALIZEDTEXT("en_US", "Maximum number of samples (required, 0 for all)");
+    inHistory[3].name = UA_STRING("Max samples");
+
+    UA_Argument outHistory[2];
+    UA_Argument_init(&outHistory[0]);
+    UA_Argument_init(&outHistory[1]);
+    outHistory[0].dataType = UA_TYPES[UA_TYPES_DATETIME].typeId;
+    outHistory[0].description = UA_LOCALIZEDTEXT("en_US", "Time of each sample");
+    outHistory[0].name = UA_STRING("Timestamps");
+    outHistory[0].arrayDimensionsSize = 0;
+    outHistory[0].arrayDimensions = nullptr;
+    outHistory[0].valueRank = 1;
+    outHistory[1].dataType = UA_TYPES[UA_TYPES_DOUBLE].typeId;
+    outHistory[1].description = UA_LOCALIZEDTEXT("en_US", "Joint values of each sample (deg), one row per sample");
+    outHistory[1].name = UA_STRING("Joints");
+    outHistory[1].arrayDimensionsSize = 0;
+    outHistory[1].arrayDimensions = nullptr;
+    outHistory[1].valueRank = 2;
+
+    UA_MethodAttributes methodHistory;
+    UA_MethodAttributes_init(&methodHistory);
+    methodHistory.displayName = UA_LOCALIZEDTEXT("en_US", "getJointsHistory");
+    methodHistory.executable = true;
+    methodHistory.userExecutable = true;
+    UA_Server_addMethodNode(server, UA_NODEID_NUMERIC(1, 1003),
+        UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+        UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT),
+        UA_QUALIFIEDNAME(1, "getJointsHistory"), methodHistory,
+        &getJointsHistory, // callback function
+        pPlugin, // plugin handle
+        4, inHistory, 2, outHistory, nullptr);
+
 #endif
 
+    // Publish the robots of the station as objects with Joints, Pose and Busy variables
+    pPlugin->Server->Robots.AddFolder(server);
+    UA_Job robots_job;
+    robots_job.type = UA_Job::UA_JOBTYPE_METHODCALL;
+    robots_job.job.methodCall.method = opcua_robots::ApplyJob;
+    robots_job.job.methodCall.data = &pPlugin->Server->Robots;
+    UA_Server_addRepeatedJob(server, robots_job, opcua_robots::PublishInterval, NULL);
+
     // Run server until we stop the flag
     SERVER_RUNNING = UA_TRUE;
     ShowMessage(pPlugin, QObject::tr("RoboDK's OPC UA server running on port %1").arg(port));
@@ -3,6 +3,9 @@
 
 #include <QObject>
 
+#include "opcua_requests.h"
+#include "opcua_robots.h"
+
 class PluginOPCUA;
 
 /// This class creates an instance of an OPC-UA server to interface with RoboDK
@@ -27,6 +30,10 @@ public:
     /// Retrieve the status of the OPC-UA server
     QString Status();
 
+    /// Publish the robot states that changed, and the list of robots if the station changed (GUI thread).
+    /// The joints of each trajectory step are also kept in the joint history of the robots.
+    void UpdateRobots(bool list_changed, bool trajectory_step = false);
+
 public slots:
 
     /// Update status action
@@ -44,6 +51,12 @@ public:
     /// Pointer to the RoboDK plugin interface
     PluginOPCUA *pPlugin;
 
+    /// Requests from the server thread that must run on the GUI thread
+    opcua_requests Requests;
+
+    /// Robots published as OPC-UA objects
+    opcua_robots Robots;
+
 };
 
 #endif // OPCUA_SERVER_H
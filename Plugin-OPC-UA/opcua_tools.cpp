@@ -1,9 +1,14 @@
 #include "opcua_tools.h"
 #include "irobodk.h"
 
+#include <QObject>
+#include <QDebug>
+
+#include <cstring>
+
 ///////////////////////////////////////////////////////////////7
 bool Var_2_Item(const UA_Variant *var, IItem **item, RoboDK *rdk){
-    if (var->type->typeId.identifier.numeric != UA_TYPES[UA_TYPES_UINT64].typeId.identifier.numeric){
+    if (var->type != &UA_TYPES[UA_TYPES_UINT64]){
         qDebug()<<"Invalid item type: " << var->type;
         return false;
     }
@@ -16,15 +21,31 @@ bool Var_2_Item(const UA_Variant *var, IItem **item, RoboDK *rdk){
     return true;
 }
 bool Var_2_Int(const UA_Variant *var, UA_Int64 *num){
-    if (var->type->typeId.identifier.numeric != UA_TYPES[UA_TYPES_INT64].typeId.identifier.numeric){
+    if (var->type != &UA_TYPES[UA_TYPES_INT64]){
         qDebug()<<"Invalid int type: " << var->type;
         return false;
     }
     *num = ((UA_Int64*)var->data)[0];
     return true;
 }
+bool Var_2_UInt32(const UA_Variant *var, UA_UInt32 *num){
+    if (var->type != &UA_TYPES[UA_TYPES_UINT32]){
+        qDebug()<<"Invalid unsigned int type: " << var->type;
+        return false;
+    }
+    *num = ((UA_UInt32*)var->data)[0];
+    return true;
+}
+bool Var_2_DateTime(const UA_Variant *var, UA_DateTime *time){
+    if (var->type != &UA_TYPES[UA_TYPES_DATETIME]){
+        qDebug()<<"Invalid date time type: " << var->type;
+        return false;
+    }
+    *time = ((UA_DateTime*)var->data)[0];
+    return true;
+}
 bool Var_2_Double(const UA_Variant *var, UA_Double *value){
-    if (var->type->typeId.identifier.numeric != UA_TYPES[UA_TYPES_DOUBLE].typeId.identifier.numeric){
+    if (var->type != &UA_TYPES[UA_TYPES_DOUBLE]){
         qDebug()<<"Invalid double type: " << var->type;
         return false;
     }
@@ -32,26 +53,21 @@ bool Var_2_Double(const UA_Variant *var, UA_Double *value){
     return true;
 }
 bool Var_2_Str(const UA_Variant *var, QString &str){
-    if (var->type->typeId.identifier.numeric != UA_TYPES[UA_TYPES_STRING].typeId.identifier.numeric){
+    if (var->type != &UA_TYPES[UA_TYPES_STRING]){
         qDebug()<<"Invalid string type: " << var->type;
         return false;
     }
     UA_String *name = (UA_String*) var->data;
-    //QString str(name->data, name->length);
     str = QString::fromUtf8((const char*)name->data, name->length);
-    qDebug() << "Received array: " << str;
     return true;
 }
 bool Var_2_DoubleArray(const UA_Variant *var, double *values, UA_UInt32 maxlen){
-    if (var->type->typeId.identifier.numeric != UA_TYPES[UA_TYPES_DOUBLE].typeId.identifier.numeric){
+    if (var->type != &UA_TYPES[UA_TYPES_DOUBLE]){
         //qDebug()<<"Invalid array type or dimension: " << var->type;
         return false;
     }
-    unsigned int size = qMin(maxlen, var->arrayDimensions[0]);
-    for (unsigned int i=0; i<size; i++){
-        values[i] = ((UA_Double*) var->data)[i];
-    }
-    //qDebug() << "Received number: " << str;
+    size_t size = UA_Variant_isScalar(var) ? 1 : qMin((size_t)maxlen, var->arrayLength);
+    memcpy(values, var->data, size * sizeof(double));
     return true;
 }
 
@@ -74,8 +90,99 @@ bool DoubleArray_2_Var(const double *values, unsigned long long numel, UA_Varian
     return true;
 }
 bool Str_2_Var(const QString &str, UA_Variant *var){
-    UA_String str_UA = UA_STRING((const char*)str.toUtf8().constData());
+    QByteArray utf8 = str.toUtf8();
+    UA_String str_UA;
+    str_UA.length = utf8.size();
+    str_UA.data = (UA_Byte*)utf8.data();
     UA_Variant_setScalarCopy(var, &str_UA, &UA_TYPES[UA_TYPES_STRING]);
     return true;
 }
+
+
+//-------------------------------------------------------------------------
+void Double_2_VarRef(UA_Double *value, UA_Variant *var){
+    UA_Variant_setScalar(var, value, &UA_TYPES[UA_TYPES_DOUBLE]);
+    var->storageType = UA_VARIANT_DATA_NODELETE;
+}
+void DateTime_2_VarRef(UA_DateTime *value, UA_Variant *var){
+    UA_Variant_setScalar(var, value, &UA_TYPES[UA_TYPES_DATETIME]);
+    var->storageType = UA_VARIANT_DATA_NODELETE;
+}
+void Str_2_VarRef(const QString &str, opcua_string_ref_t &storage, UA_Variant *var){
+    if (storage.string.data == nullptr || str != storage.text){
+        storage.text = str;
+        storage.utf8 = str.toUtf8();
+        storage.string.length = storage.utf8.size();
+        storage.string.data = (UA_Byte*)storage.utf8.data();
+    }
+    UA_Variant_setScalar(var, &storage.string, &UA_TYPES[UA_TYPES_STRING]);
+    var->storageType = UA_VARIANT_DATA_NODELETE;
+}
+
+
+//-------------------------------------------------------------------------
+bool Var_2_Value(const UA_Variant *var, opcua_value_t &value){
+    const UA_DataType *type = var->type;
+    bool changed = type != value.type;
+    value.type = type;
+    if (type == nullptr || var->data == nullptr || !UA_Variant_isScalar(var)){
+        // Arrays are not supported: only the type is compared
+        return changed;
+    }
+
+    UA_Int64 integer = 0;
+    if (type == &UA_TYPES[UA_TYPES_DOUBLE] || type == &UA_TYPES[UA_TYPES_FLOAT]){
+        UA_Double number = type == &UA_TYPES[UA_TYPES_DOUBLE] ? *(UA_Double*)var->data : *(UA_Float*)var->data;
+        changed = changed || number != value.number;
+        value.number = number;
+        return changed;
+    } else if (type == &UA_TYPES[UA_TYPES_STRING]){
+        const UA_String *str = (const UA_String*)var->data;
+        if (changed || value.utf8.size() != (int)str->length || memcmp(value.utf8.constData(), str->data, str->length) != 0){
+            value.utf8 = QByteArray((const char*)str->data, (int)str->length);
+            changed = true;
+        }
+        return changed;
+    } else if (type == &UA_TYPES[UA_TYPES_BOOLEAN]){
+        integer = *(UA_Boolean*)var->data ? 1 : 0;
+    } else if (type == &UA_TYPES[UA_TYPES_INT64] || type == &UA_TYPES[UA_TYPES_DATETIME]){
+        integer = *(UA_Int64*)var->data;
+    } else if (type == &UA_TYPES[UA_TYPES_INT32]){
+        integer = *(UA_Int32*)var->data;
+    } else if (type == &UA_TYPES[UA_TYPES_UINT32]){
+        integer = *(UA_UInt32*)var->data;
+    } else if (type == &UA_TYPES[UA_TYPES_INT16]){
+        integer = *(UA_Int16*)var->data;
+    } else if (type == &UA_TYPES[UA_TYPES_UINT16]){
+        integer = *(UA_UInt16*)var->data;
+    } else {
+        // Unknown types: only the type is compared
+        return changed;
+    }
+    changed = changed || integer != value.integer;
+    value.integer = integer;
+    return changed;
+}
+
+QString Value_2_Str(const opcua_value_t &value){
+    const UA_DataType *type = value.type;
+    if (type == &UA_TYPES[UA_TYPES_BOOLEAN]){
+        return value.integer ? "1" : "0";
+    } else if (type == &UA_TYPES[UA_TYPES_DOUBLE] || type == &UA_TYPES[UA_TYPES_FLOAT]){
+        return QString::number(value.number);
+    } else if (type == &UA_TYPES[UA_TYPES_STRING]){
+        return QString::fromUtf8(value.utf8);
+    } else if (type == &UA_TYPES[UA_TYPES_DATETIME]){
+        UA_String strval = UA_DateTime_toString(value.integer);
+        QString str = QString::fromUtf8((const char*)strval.data, strval.length);
+        UA_String_deleteMembers(&strval);
+        return str;
+    } else if (type == &UA_TYPES[UA_TYPES_INT64] || type == &UA_TYPES[UA_TYPES_INT32] || type == &UA_TYPES[UA_TYPES_UINT32]
+               || type == &UA_TYPES[UA_TYPES_INT16] || type == &UA_TYPES[UA_TYPES_UINT16]){
+        return QString::number(value.integer);
+    } else if (type == nullptr){
+        return QString();
+    }
+    return QObject::tr("Unknown value type %1").arg(type->typeId.identifier.numeric);
+}
 //-------------------------------------------------------------------------
@@ -3,6 +3,7 @@
 
 
 #include <QString>
+#include <QByteArray>
 #include "robodktools.h"
 
 #include "open62541.h"
@@ -15,6 +16,12 @@ bool Var_2_Item(const UA_Variant *var, IItem **item, RoboDK *rdk);
 /// Convert an OPC-UA variant to an int
 bool Var_2_Int(const UA_Variant *var, UA_Int64 *num);
 
+/// Convert an OPC-UA variant to an unsigned int
+bool Var_2_UInt32(const UA_Variant *var, UA_UInt32 *num);
+
+/// Convert an OPC-UA variant to a date time
+bool Var_2_DateTime(const UA_Variant *var, UA_DateTime *time);
+
 /// Convert an OPC-UA variant to a double
 bool Var_2_Double(const UA_Variant *var, UA_Double *value);
 
@@ -44,4 +51,51 @@ bool DoubleArray_2_Var(const double *values, unsigned long long numel, UA_Varian
 bool Str_2_Var(const QString &str, UA_Variant *var);
 
 
+//-------------------------------------------------------------------------
+/// Typed fast paths: the variant points to preallocated storage and does not own it (UA_VARIANT_DATA_NODELETE).
+/// The storage must remain valid until the variant is encoded or copied.
+
+/// Preallocated storage of a string variant. The string is only encoded again when it changes.
+struct opcua_string_ref_t
+{
+    QString text;
+    QByteArray utf8;
+    UA_String string { 0, nullptr };
+};
+
+/// Point a variant to a double
+void Double_2_VarRef(UA_Double *value, UA_Variant *var);
+
+/// Point a variant to a date time
+void DateTime_2_VarRef(UA_DateTime *value, UA_Variant *var);
+
+/// Point a variant to the UTF-8 storage of a string
+void Str_2_VarRef(const QString &str, opcua_string_ref_t &storage, UA_Variant *var);
+
+
+//-------------------------------------------------------------------------
+/// Last value of a node, kept with its type: numbers are compared as numbers and strings as UTF-8 bytes.
+/// The value is only converted to a QString when it changes.
+struct opcua_value_t
+{
+    /// Type of the value (nullptr if no value was set)
+    const UA_DataType *type { nullptr };
+
+    /// Booleans, integers and date times
+    UA_Int64 integer { 0 };
+
+    /// Floating point numbers
+    UA_Double number { 0 };
+
+    /// Strings
+    QByteArray utf8;
+};
+
+/// Update a cached value with the value of a variant. Returns true if the value changed.
+bool Var_2_Value(const UA_Variant *var, opcua_value_t &value);
+
+/// Convert a cached value to a string (station parameter)
+QString Value_2_Str(const opcua_value_t &value);
+
+
 #endif // OPCUA_TOOLS_H
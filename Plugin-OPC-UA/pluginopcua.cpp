@@ -113,6 +113,9 @@ QString PluginOPCUA::PluginLoad(QMainWindow *mw, QMenuBar *menubar, QStatusBar *
     // Create the OPC-UA Client
     Client = new opcua_client(this);
 
+    // Create the OPC-UA PubSub publisher
+    Publisher = new opcua_publisher(this);
+
     // Load INI settings
     /*
     QSettings params(QSettings::IniFormat, QSettings::UserScope, "RoboDK-Plugins", PluginName());
@@ -178,6 +181,8 @@ void PluginOPCUA::PluginUnload(){
     qDebug() << "OPC-UA server stopped";
     delete Server;
     delete Client;
+    Publisher->Stop();
+    delete Publisher;
 
     // Delete the log window (if it is open)
     LogHide();
@@ -260,6 +265,72 @@ QString PluginOPCUA::PluginCommand(const QString &command, const QString &value)
             Client->Browse(false);
         }
         return "Done";
+    } else if (command.compare("ClientSubscribe", Qt::CaseInsensitive) == 0){
+        // Set the sampling interval of the monitored variables in ms (0 to browse the server every 100 ms instead). Applies the next time the client starts.
+        bool ok = false;
+        double interval = value.toDouble(&ok);
+        if (!ok || interval < 0){
+            return "Invalid value";
+        }
+        Client->Subscribe = interval > 0;
+        if (Client->Subscribe){
+            Client->SamplingInterval = interval;
+        }
+        return "Done";
+    } else if (command.compare("PubSubStart", Qt::CaseInsensitive) == 0){
+        // Publish the robot joints, the time, the simulation speed and the PubSub station parameters as UADP messages over UDP.
+        // A value can be optionally provided to override the URL (opc.udp://address:port). Pass 0 to stop publishing.
+        // The offset of each value in the message is shown in the log when the layout changes.
+        // Example of a local subscriber (Time at byte 46, then the joints of the first robot as an Int32 length at byte 62 followed by the values):
+        /*
+        import socket, struct
+        sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        sock.bind(('', 4840))
+        sock.setsockopt(socket.IPPROTO_IP, socket.IP_ADD_MEMBERSHIP, socket.inet_aton('224.0.0.22') + socket.inet_aton('0.0.0.0'))
+        while True:
+            msg = sock.recv(65535)
+            time, speed, ndofs = struct.unpack_from('<qdi', msg, 46)
+            print(struct.unpack_from('<%id' % ndofs, msg, 66))
+
+        */
+        if (value == "0"){
+            Publisher->Stop();
+            return "Done";
+        }
+        if (!value.isEmpty()){
+            Publisher->Url = value;
+        }
+        Publisher->Stop();
+        return Publisher->Start() ? "Done" : "Invalid URL";
+    } else if (command.compare("PubSubInterval", Qt::CaseInsensitive) == 0){
+        // Set the publishing interval in ms
+        bool ok = false;
+        int interval = value.toInt(&ok);
+        if (!ok || interval <= 0){
+            return "Invalid value";
+        }
+        Publisher->Interval = interval;
+        if (Publisher->IsRunning()){
+            Publisher->Stop();
+            Publisher->Start();
+        }
+        return "Done";
+    } else if (command.compare("PubSubParameters", Qt::CaseInsensitive) == 0){
+        // Set the station parameters published as numbers (comma separated names)
+        Publisher->Parameters = value.split(",", QString::SkipEmptyParts);
+        for (QString &name : Publisher->Parameters){
+            name = name.trimmed();
+        }
+        if (Publisher->IsRunning()){
+            Publisher->UpdateLayout();
+        }
+        return "Done";
+    } else if (command.compare("PubSubCheck", Qt::CaseInsensitive) == 0){
+        // Send one message to a local socket and decode it: returns "OK" or the first error found (Time at byte 46, SimulationSpeed at 54, joint count of the first robot at 62)
+        QString error = Publisher->CheckLoopback();
+        LogAdd(error.isEmpty() ? tr("OPC-UA PubSub loopback check passed") : tr("OPC-UA PubSub loopback check failed: %1").arg(error));
+        return error.isEmpty() ? "OK" : error;
     }
     return "";
 }
@@ -275,17 +346,29 @@ void PluginOPCUA::PluginEvent(TypeEvent event_type){
         case EventMoved:
             /// qDebug() << "Something has moved, such as a robot, reference frame, object or tool.
             /// It is very likely that an EventRender will be triggered immediately after this event
+            Server->UpdateRobots(false);
+            break;
+        case EventTrajectoryStep:
+            Server->UpdateRobots(false, true);
             break;
         case EventChanged:
             /// qDebug() << "An item has been added or deleted. Current station: " << RDK->getActiveStation()->Name();
             /// If we added a new item (for example, a reference frame) it is very likely that an EventMoved will follow with the updated position of the newly added item(s)
             /// This event is also triggered when we change the active station and a new station gains focus.
             // qDebug() << "==== EventChanged ====" << RDK->getActiveStation()->Name();
+            Server->UpdateRobots(true);
+            if (Publisher->IsRunning()){
+                Publisher->UpdateLayout();
+            }
             break;
         case EventChangedStation:
             // we changed the station so load the new settings
             //qDebug() << "==== EventChangedStation ====" << RDK->getActiveStation()->Name();
             LoadSettings();
+            Server->UpdateRobots(true);
+            if (Publisher->IsRunning()){
+                Publisher->UpdateLayout();
+            }
             break;
         case EventAbout2Save:
             // qDebug() << "==== EventAbout2Save ====" << RDK->getActiveStation()->Name();
@@ -337,6 +420,15 @@ bool PluginOPCUA::LoadSettings(){
     ds >> Client->EndpointUrl;
     ds >> Client->AutoStart;
     ds >> Client->KeepConnected;
+    if (version >= 3){
+        ds >> Client->Subscribe;
+        ds >> Client->SamplingInterval;
+    }
+    if (version >= 4){
+        ds >> Publisher->Url;
+        ds >> Publisher->Interval;
+        ds >> Publisher->Parameters;
+    }
     emit UpdateForm();
     qDebug() << "Done";
     return true;
@@ -347,13 +439,18 @@ void PluginOPCUA::SaveSettings(){
     qDebug() << "Saving OPC-UA plugin settings...";
     QByteArray data;
     QDataStream ds(&data, QIODevice::WriteOnly);
-    qint64 version = 2;
+    qint64 version = 4;
     ds << version;
     ds << Server->Port;
     ds << Server->AutoStart;
     ds << Client->EndpointUrl;
     ds << Client->AutoStart;
     ds << Client->KeepConnected;
+    ds << Client->Subscribe;
+    ds << Client->SamplingInterval;
+    ds << Publisher->Url;
+    ds << Publisher->Interval;
+    ds << Publisher->Parameters;
 
     RDK->setData(PluginName(), data);
 
@@ -12,6 +12,7 @@
 
 #include "opcua_server.h"
 #include "opcua_client.h"
+#include "opcua_pubsub.h"
 
 
 
@@ -75,6 +76,9 @@ public:
     /// Pointer to the OPC-UA client
     opcua_client *Client;
 
+    /// Pointer to the OPC-UA PubSub publisher
+    opcua_publisher *Publisher;
+
     /// Pointer to the log window widget
     QTextEdit *LogWindow;
 
@@ -83,9 +83,12 @@ CONFIG(release, debug|release) {
 # This can be modified manually or automatically by Qt Creator
 HEADERS += \
     applistdelegate.h \
+    appdiscovery.h \
     apploader.h \
+    appmanifest.h \
     dialogapplist.h \
     installerdialog.h \
+    pythonworkerpool.h \
     tableheader.h \
     unzipper.h \
     zip/miniz.h \
@@ -93,9 +96,12 @@ HEADERS += \
 
 SOURCES += \
     applistdelegate.cpp \
+    appdiscovery.cpp \
     apploader.cpp \
+    appmanifest.cpp \
     dialogapplist.cpp \
     installerdialog.cpp \
+    pythonworkerpool.cpp \
     unzipper.cpp \
     zip/zip.c
 
@@ -0,0 +1,198 @@
+#include "appdiscovery.h"
+
+#include <QRunnable>
+#include <QThread>
+#include <QDir>
+#include <QFileInfo>
+#include <QStringList>
+#include <QDebug>
+
+
+// Task run by the thread pool
+class tDiscoveryTask : public QRunnable {
+public:
+    explicit tDiscoveryTask(std::function<void()> function):
+        Function(function)
+    {
+    }
+    void run() override {
+        Function();
+    }
+    std::function<void()> Function;
+};
+
+
+AppDiscovery::AppDiscovery(QObject *parent) : QObject(parent),
+    Generation(0),
+    Searching(false),
+    Remaining(0)
+{
+    qRegisterMetaType<tAppManifest>("tAppManifest");
+
+    // Reading apps is mostly waiting for the file system (which can be a network share)
+    Pool.setMaxThreadCount(qMax(4, QThread::idealThreadCount()));
+}
+
+AppDiscovery::~AppDiscovery(){
+    Cancel();
+    Pool.waitForDone();
+}
+
+AppDiscovery::tAppDirs AppDiscovery::ListAppDirs(const QString &path_apps, const QString &path_user_apps){
+    tAppDirs dirs;
+    QStringList paths;
+    paths << path_apps << path_user_apps;
+    for (int i=0; i<paths.length(); i++){
+        QFileInfoList directories = QDir(paths[i]).entryInfoList(QDir::Dirs);
+        for (const QFileInfo &directoryInfo : directories){
+            // Ignore folders that start with an underscore
+            QString dirApp = directoryInfo.fileName();
+            if (dirApp.startsWith("_") || dirApp.startsWith(".")){
+                continue;
+            }
+            dirs.append(qMakePair(directoryInfo.absoluteFilePath(), i == 0));
+        }
+    }
+    return dirs;
+}
+
+void AppDiscovery::ReadApps(int generation, const tAppDirs &dirs, QSharedPointer<AppManifestCache> cache,
+                            std::function<void(int, const tAppManifest &, bool)> done){
+    for (int i=0; i<dirs.length(); i++){
+        QString path = dirs[i].first;
+        bool global = dirs[i].second;
+        Pool.start(new tDiscoveryTask([this, generation, i, path, global, cache, done](){
+            if (Generation.load() != generation){
+                return; // cancelled
+            }
+            tAppManifest manifest;
+            bool from_cache = cache->Find(path, manifest) && manifest.Global == global;
+            if (!from_cache){
+                qDebug() << "Reading App dir: " << path;
+                manifest = AppManifestParse(path, global);
+            }
+            done(i, manifest, from_cache);
+        }));
+    }
+}
+
+void AppDiscovery::UpdateCache(AppManifestCache &cache, const tAppDirs &dirs, const QVector<tAppManifest> &manifests, const QVector<bool> &from_cache){
+    QStringList paths;
+    for (int i=0; i<dirs.length(); i++){
+        paths.append(dirs[i].first);
+        if (!from_cache[i]){
+            cache.Insert(dirs[i].first, manifests[i]);
+        }
+    }
+    cache.Retain(paths);
+    cache.Save();
+}
+
+QList<tAppManifest> AppDiscovery::Search(){
+    // A background search would modify the same INI files
+    Cancel();
+    Pool.waitForDone();
+    int generation = Generation.load();
+
+    tAppDirs dirs = ListAppDirs(PathApps, PathUserApps);
+    QSharedPointer<AppManifestCache> cache(new AppManifestCache(PathIndexCache));
+    cache->Load();
+
+    // Each task writes its own slot
+    QVector<tAppManifest> manifests(dirs.length());
+    QVector<bool> from_cache(dirs.length(), false);
+    tAppManifest *pmanifests = manifests.data();
+    bool *pfrom_cache = from_cache.data();
+    ReadApps(generation, dirs, cache, [pmanifests, pfrom_cache](int index, const tAppManifest &manifest, bool cached){
+        pmanifests[index] = manifest;
+        pfrom_cache[index] = cached;
+    });
+    Pool.waitForDone();
+
+    UpdateCache(*cache, dirs, manifests, from_cache);
+    return manifests.toList();
+}
+
+void AppDiscovery::SearchAsync(){
+    Cancel();
+    int generation = Generation.load();
+    Searching = true;
+    Remaining = -1;
+    Dirs.clear();
+    Manifests.clear();
+    FromCache.clear();
+    Cache.reset(new AppManifestCache(PathIndexCache));
+
+    // List the folders and load the index in the background too, then read each App in its own task
+    QSharedPointer<AppManifestCache> cache = Cache;
+    QString path_apps = PathApps;
+    QString path_user_apps = PathUserApps;
+    Pool.start(new tDiscoveryTask([this, generation, cache, path_apps, path_user_apps](){
+        if (Generation.load() != generation){
+            return;
+        }
+        tAppDirs dirs = ListAppDirs(path_apps, path_user_apps);
+        cache->Load();
+
+        QStringList paths;
+        int global_count = 0;
+        for (const QPair<QString, bool> &dir : dirs){
+            paths.append(dir.first);
+            global_count += dir.second ? 1 : 0;
+        }
+        QMetaObject::invokeMethod(this, "onListed", Qt::QueuedConnection,
+                                  Q_ARG(int, generation), Q_ARG(QStringList, paths), Q_ARG(int, global_count));
+
+        ReadApps(generation, dirs, cache, [this, generation](int index, const tAppManifest &manifest, bool from_cache){
+            QMetaObject::invokeMethod(this, "onAppRead", Qt::QueuedConnection,
+                                      Q_ARG(int, generation), Q_ARG(int, index), Q_ARG(tAppManifest, manifest), Q_ARG(bool, from_cache));
+        });
+    }));
+}
+
+void AppDiscovery::Cancel(){
+    Generation.fetchAndAddOrdered(1);
+    Searching = false;
+    Cache.reset();
+}
+
+bool AppDiscovery::IsSearching() const {
+    return Searching;
+}
+
+void AppDiscovery::onListed(int generation, const QStringList &paths, int global_count){
+    if (generation != Generation.load() || !Searching){
+        return;
+    }
+    for (int i=0; i<paths.length(); i++){
+        Dirs.append(qMakePair(paths[i], i < global_count));
+    }
+    Manifests.resize(paths.length());
+    FromCache.fill(false, paths.length());
+    Remaining = paths.length();
+    if (Remaining == 0){
+        Searching = false;
+        UpdateCache(*Cache, Dirs, Manifests, FromCache);
+        Cache.reset();
+        emit Finished();
+    }
+}
+
+void AppDiscovery::onAppRead(int generation, int index, const tAppManifest &manifest, bool from_cache){
+    // onListed is always received before the Apps of the same search
+    if (generation != Generation.load() || !Searching || index >= Manifests.size()){
+        return;
+    }
+    Manifests[index] = manifest;
+    FromCache[index] = from_cache;
+    Remaining--;
+    emit AppFound(manifest);
+
+    if (Remaining == 0 && Searching){
+        Searching = false;
+        UpdateCache(*Cache, Dirs, Manifests, FromCache);
+        Cache.reset();
+        Manifests.clear();
+        emit Finished();
+    }
+}
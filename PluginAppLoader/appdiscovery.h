@@ -0,0 +1,92 @@
+#ifndef APPDISCOVERY_H
+#define APPDISCOVERY_H
+
+
+#include <QObject>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <QSharedPointer>
+#include <QVector>
+#include <QPair>
+
+#include <functional>
+
+#include "appmanifest.h"
+
+
+///
+/// \brief The AppDiscovery class finds the Apps in the Apps folders and reads them in parallel (one task per App folder).
+/// The result is a list of manifests that can be used from the GUI thread to create the menus, toolbars and actions.
+/// Apps that did not change are taken from the index cache.
+///
+class AppDiscovery : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit AppDiscovery(QObject *parent = nullptr);
+    ~AppDiscovery();
+
+    /// Search the Apps and wait for the result (manifests in the order of the folders, global Apps first)
+    QList<tAppManifest> Search();
+
+    /// Search the Apps in the background. AppFound is emitted for each App as soon as it is read, then Finished is emitted.
+    void SearchAsync();
+
+    /// Ignore the results of the background search in progress (if any)
+    void Cancel();
+
+    /// Returns true if a background search is in progress
+    bool IsSearching() const;
+
+signals:
+    /// Emitted (on the GUI thread) for each App found by the background search, in no particular order
+    void AppFound(const tAppManifest &manifest);
+
+    /// Emitted when the background search is complete
+    void Finished();
+
+private slots:
+    void onListed(int generation, const QStringList &paths, int global_count);
+    void onAppRead(int generation, int index, const tAppManifest &manifest, bool from_cache);
+
+private:
+    /// App folders to read and whether they are global Apps
+    typedef QList<QPair<QString, bool> > tAppDirs;
+
+    /// List the App folders (folders starting with an underscore or a dot are ignored)
+    static tAppDirs ListAppDirs(const QString &path_apps, const QString &path_user_apps);
+
+    /// Start one task per App folder. The callback is called from the worker threads.
+    void ReadApps(int generation, const tAppDirs &dirs, QSharedPointer<AppManifestCache> cache,
+                  std::function<void(int index, const tAppManifest &manifest, bool from_cache)> done);
+
+    /// Save the manifests read by a search in the index cache
+    static void UpdateCache(AppManifestCache &cache, const tAppDirs &dirs, const QVector<tAppManifest> &manifests, const QVector<bool> &from_cache);
+
+public:
+    /// Path to the global Apps folder
+    QString PathApps;
+
+    /// Path to the user Apps folder
+    QString PathUserApps;
+
+    /// Path to the index cache file
+    QString PathIndexCache;
+
+private:
+    QThreadPool Pool;
+
+    /// Identifier of the current search (results of older searches are ignored)
+    QAtomicInt Generation;
+
+    /// State of the background search
+    bool Searching;
+    int Remaining;
+    tAppDirs Dirs;
+    QSharedPointer<AppManifestCache> Cache;
+    QVector<tAppManifest> Manifests;
+    QVector<bool> FromCache;
+};
+
+#endif // APPDISCOVERY_H
@@ -4,6 +4,8 @@
 #include "irobodk.h"
 #include "iitem.h"
 #include "installerdialog.h"
+#include "pythonworkerpool.h"
+#include "appdiscovery.h"
 
 #include <QMainWindow>
 #include <QToolBar>
@@ -24,6 +26,11 @@
 #include <QTimer>
 #include <QSysInfo>
 #include <QBuffer>
+#include <QFileSystemWatcher>
+#include <QSet>
+#include <QPointer>
+
+#include <algorithm>
 
 // Function to check and sort priority of apps
 struct CheckPriority {
@@ -33,23 +40,22 @@ struct CheckPriority {
     }
 };
 
-// Function to parse a string list of ITEM_TYPE
-static QList<int> ParseStringList(const QStringList& l){
-    QList<int> result;
-    for (const QString& s : l){
-        bool ok = false;
-        int value = s.trimmed().toInt(&ok);
-        if (ok) {
-            if (value == IItem::ITEM_TYPE_ANY) {
-                result.clear();
-                result.append(value);
-                break;
-            } else if (value > 0 && value < 50) {
-                result.append(value);
-            }
-        }
-    }
-    return result;
+// Function to insert an item in a list sorted by priority (after the items with the same priority)
+template<typename AppType>
+static void InsertByPriority(QList<AppType*> &list, AppType *item){
+    list.insert(std::upper_bound(list.begin(), list.end(), item, CheckPriority()), item);
+}
+
+// Function to read the list of enabled apps (INI files) from the plugin settings
+static QStringList ReadEnabledApps(QSettings &pluginSettings){
+    QStringList enabledApps;
+    pluginSettings.beginGroup("Enabled");
+    int count = pluginSettings.value("count", 0).toInt();
+    enabledApps.reserve(count);
+    for (int eindex = 0; eindex < count; ++eindex)
+        enabledApps << pluginSettings.value(QString::number(eindex)).toString();
+    pluginSettings.endGroup();
+    return enabledApps;
 }
 
 //------------------------------- RoboDK Plug-in commands ------------------------------
@@ -97,6 +103,9 @@ QString AppLoader::PluginLoad(QMainWindow *mw, QMenuBar *menubar, QStatusBar *st
 
     PathUserApps = userPath.absolutePath();
 
+    // Index of the apps found (only apps that changed are read again)
+    PathIndexCache = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/AppLoaderIndex.bin";
+
     // Here you can add all the "Actions": these actions are callbacks from buttons selected from the menu or the toolbar
     action_Apps = new QAction(tr("Apps List"));
     action_Apps->setShortcut(QKeySequence("Shift+A"));
@@ -104,9 +113,29 @@ QString AppLoader::PluginLoad(QMainWindow *mw, QMenuBar *menubar, QStatusBar *st
     // Make sure to connect the action to your callback (slot)
     connect(action_Apps, SIGNAL(triggered()), this, SLOT(callback_AppList()), Qt::QueuedConnection);
 
-    // look for apps and load them in the main menu
-    AppsSearch(true);
-    AppsLoadMenus();
+    // Python workers run the scripts of the actions (optional)
+    QSettings pluginSettings(QSettings::IniFormat, QSettings::UserScope,
+                             applicationName.isEmpty() ? "RoboDK" : applicationName, PluginName().remove(' '));
+    PythonWorkers = pluginSettings.value("PythonWorkers", 0).toInt();
+    WorkerPool = new PythonWorkerPool(this);
+    connect(WorkerPool, &PythonWorkerPool::ScriptFinished, this, &AppLoader::onWorkerScriptFinished);
+    connect(this, &AppLoader::stop_process, WorkerPool, &PythonWorkerPool::Abort);
+
+    // watch the apps: changes are applied once they stop for a moment
+    Watcher = new QFileSystemWatcher(this);
+    WatchTimer = new QTimer(this);
+    WatchTimer->setSingleShot(true);
+    WatchTimer->setInterval(1000);
+    connect(Watcher, &QFileSystemWatcher::directoryChanged, this, &AppLoader::onAppsChanged);
+    connect(Watcher, &QFileSystemWatcher::fileChanged, this, &AppLoader::onAppsChanged);
+    connect(WatchTimer, &QTimer::timeout, this, &AppLoader::AppsUpdate);
+
+    // look for apps in the background: they are added to the main menu and the toolbar as they are found
+    ToolbarsLoaded = false;
+    Discovery = new AppDiscovery(this);
+    connect(Discovery, &AppDiscovery::AppFound, this, &AppLoader::onAppFound);
+    connect(Discovery, &AppDiscovery::Finished, this, &AppLoader::onAppsSearchFinished);
+    AppsSearchAsync(true);
 
     // adding the action before the Plug-Ins action in the Tools menu
     QMenu *menuTools = mw->findChild<QMenu *>("menu-Tools");
@@ -137,6 +166,14 @@ void AppLoader::PluginUnload(){
     // emit stop_process(); // this provokes crash for checkable objects when they are checked
     // use the following iterator instead:
 
+    // Ignore the apps still being searched and stop watching the apps
+    Discovery->Cancel();
+    WatchTimer->stop();
+    disconnect(Watcher, nullptr, this, nullptr);
+
+    // Stop the Python workers first (they restart when they are killed)
+    WorkerPool->Stop();
+
     // Important: disconnect signals related to processes (can cause crash for checkable actions)
     QList<QProcess*> all_process = this->findChildren<QProcess *>();
     for (int i=0; i<all_process.length(); i++){
@@ -246,6 +283,10 @@ bool AppLoader::PluginItemClickMulti(QList<Item> &item_list, QMenu *menu, TypeCl
 QString AppLoader::PluginCommand(const QString &command, const QString &value){
     qDebug() << "Received command: " << command << "    With value: " << value;
     if (command.startsWith("Reload", Qt::CaseInsensitive)) {
+        if (value.compare("Full", Qt::CaseInsensitive) == 0) {
+            // read all apps again, ignoring the index cache
+            QFile::remove(PathIndexCache);
+        }
         AppsReload();
         return "Apps reloaded";
     } else if (command.startsWith("OpenFile", Qt::CaseInsensitive)) {
@@ -277,6 +318,20 @@ QString AppLoader::PluginCommand(const QString &command, const QString &value){
             return bytes.toHex();
         }
         qDebug() << "IconGet: unable to retrieve " << value;
+    } else if (command.startsWith("PythonWorkers", Qt::CaseInsensitive)) {
+        // Number of Python processes kept ready to run the scripts of the actions (0 to disable)
+        if (!value.isEmpty()) {
+            PythonWorkers = qMax(0, value.toInt());
+            QString applicationName = QCoreApplication::applicationName();
+            if (applicationName.isEmpty())
+                applicationName = "RoboDK";
+
+            QSettings pluginSettings(QSettings::IniFormat, QSettings::UserScope,
+                                     applicationName, PluginName().remove(' '));
+            pluginSettings.setValue("PythonWorkers", PythonWorkers);
+            WorkersStart();
+        }
+        return QString::number(PythonWorkers);
     }
     return "";
 }
@@ -316,13 +371,7 @@ void AppLoader::EnableApp(const QString& path, bool enable)
     QSettings pluginSettings(QSettings::IniFormat, QSettings::UserScope,
                              applicationName, pluginName);
 
-    QStringList enabledApps;
-    pluginSettings.beginGroup("Enabled");
-    int count = pluginSettings.value("count", 0).toInt();
-    enabledApps.reserve(count);
-    for (int eindex = 0; eindex < count; ++eindex)
-        enabledApps << pluginSettings.value(QString::number(eindex)).toString();
-    pluginSettings.endGroup();
+    QStringList enabledApps = ReadEnabledApps(pluginSettings);
 
     if (enabledApps.contains(fullPath, caseSensitivity) == enable)
         return;
@@ -352,6 +401,9 @@ void AppLoader::AppsReload(){
 
     // force reload of the toolbar
     AppsLoadToolbars();
+
+    // the PYTHONPATH may have changed
+    WorkersStart();
 }
 
 void AppLoader::AppsDelete(){
@@ -374,7 +426,14 @@ void AppLoader::AppsDelete(){
         delete ListToolbars.takeLast();
     }
 
+    AppMenus.clear();
+    AppManifests.clear();
+
     // Remove App paths from RoboDK's PYTHONPATH
+    AppsPythonPathRemove();
+}
+
+void AppLoader::AppsPythonPathRemove(){
     if (!PypathAppsDirs.empty()){
 #ifdef Q_OS_WIN
         QChar path_sep(';');
@@ -396,6 +455,29 @@ void AppLoader::AppsDelete(){
     }
 }
 
+void AppLoader::AppsPythonPathAdd(){
+    if (!PypathAppsDirs.empty()){
+#ifdef Q_OS_WIN
+        QString path_sep(";");
+#else
+        QString path_sep(":");
+#endif
+
+        QStringList pypathList = RDK->getParam("PYTHONPATH").replace("\\","/").split(path_sep);
+        pypathList.append(PypathAppsDirs);
+        pypathList.removeDuplicates();
+
+        QString pypath = "";
+        for (const QString& path : pypathList){
+            if (pypath != ""){
+                pypath += path_sep;
+            }
+            pypath += path;
+        }
+        qDebug() << "Python path: " << RDK->Command("PYTHONPATH", pypath);
+    }
+}
+
 void AppLoader::AppsSearch(bool install_requirements){
     // We keep the list of all toolbars and menus to sort them properly and display the toolbar when required
     // (global variable)
@@ -403,431 +485,428 @@ void AppLoader::AppsSearch(bool install_requirements){
     //QList<tAppToolbar*> ListToolbars;
 
     AppsDelete();
+    AppsSearchBegin(install_requirements);
+
+    // Read all apps in parallel and wait for the result
+    QList<tAppManifest> manifests = Discovery->Search();
+    for (const tAppManifest &manifest : manifests){
+        AppsAdd(manifest);
+    }
+
+    AppsSearchEnd();
+}
+
+void AppLoader::AppsSearchAsync(bool install_requirements){
+    AppsDelete();
+    AppsSearchBegin(install_requirements);
+
+    // Apps are added as they are found (onAppFound), the search completes with onAppsSearchFinished
+    Discovery->SearchAsync();
+}
 
+void AppLoader::AppsSearchBegin(bool install_requirements){
     QString value = RDK->Command("DeveloperMode");
-    bool isDeveloperMode = (!value.isEmpty() && value != "0");
+    SearchDeveloperMode = (!value.isEmpty() && value != "0");
+    SearchInstallRequirements = install_requirements;
+    SearchRequirements.clear();
 
-    // Get path to apps folder
-    QDir globalPath(PathApps);
-    QDir userPath(PathUserApps);
+    // Read the list of enabled apps once
+    QString applicationName = QCoreApplication::applicationName();
+    if (applicationName.isEmpty())
+        applicationName = "RoboDK";
 
-    QFileInfoList directories = globalPath.entryInfoList(QDir::Dirs);
-    int globalCount = directories.size();
-    directories.append(userPath.entryInfoList(QDir::Dirs));
+    QSettings pluginSettings(QSettings::IniFormat, QSettings::UserScope,
+                             applicationName, PluginName().remove(' '));
+    SearchEnabledApps = ReadEnabledApps(pluginSettings);
 
-    int appsenabled_count = 0;
-    for (int dindex = 0; dindex < directories.size(); ++dindex) {
-        const QFileInfo& directoryInfo = directories.at(dindex);
+    Discovery->PathApps = PathApps;
+    Discovery->PathUserApps = PathUserApps;
+    Discovery->PathIndexCache = PathIndexCache;
+}
 
-        bool global = (dindex < globalCount);
+tAppMenu *AppLoader::AppsAdd(const tAppManifest &manifest){
+    const QString &dirApp = manifest.DirApp;
+    const QString &fileSettings = manifest.FileSettings;
+    const QString &dirAppComplete = manifest.DirAppComplete;
+    qDebug() << "Loading App dir: " << dirApp;
 
-        QString dirApp = directoryInfo.fileName();
+#ifdef Q_OS_WIN
+    bool appEnabled = SearchEnabledApps.contains(fileSettings, Qt::CaseInsensitive);
+#else
+    bool appEnabled = SearchEnabledApps.contains(fileSettings);
+#endif
 
-        // Ignore folders that start with an underscore
-        if (dirApp.startsWith("_") || dirApp.startsWith(".")){
-            continue;
-        }
-        qDebug() << "Loading App dir: " << dirApp;
-
-        QString dirAppComplete = directoryInfo.absoluteFilePath();
-
-        // Retrieve and/or create the INI file related to this app
-        QString fileSettings = dirAppComplete + "/AppConfig.ini";
-
-        // Check if the ini file exists, otherwise, try with the older Settings.ini file
-        bool fileExist = QFile::exists(fileSettings);
-        if (!fileExist){
-            fileSettings = dirAppComplete + "/Settings.ini";
-            fileExist = QFile::exists(fileSettings);
-            if (!fileExist){
-                // Check if we want to forward the app location to another folder (useful if we use GitHub)
-                QString fileLinkTo = dirAppComplete + "/AppLink.ini";
-                if (QFile::exists(fileLinkTo)){
-                    QSettings linksettings(fileLinkTo, QSettings::IniFormat);
-                    QString pathLink = linksettings.value("Path", "").toString();
-                    pathLink.replace("\\","/"); // Qt Docs: QSettings always treats backslash as a special character and provides no API for reading or writing such entries.
-                    if (!pathLink.isEmpty()){
-                        QDir pathLinkDir(pathLink);
-                        if (pathLinkDir.exists()){
-                            dirAppComplete = pathLink;
-                            fileSettings = dirAppComplete + "/AppConfig.ini";
-                            qDebug() << "Linking app dir to: " << dirAppComplete;
-                            fileExist = QFile::exists(fileSettings);
-                            if (!fileExist){
-                                // Try with the older Settings.ini file
-                                fileSettings = dirAppComplete + "/Settings.ini";
-                                fileExist = QFile::exists(fileSettings);
-                            }
-                        }
-                    }
-                }
+
+    // Create a new list for menus and toolbars
+    tAppToolbar *appToolbar = new tAppToolbar(manifest.MenuName, manifest.MenuPriority, manifest.ToolbarArea,
+                                              manifest.ToolbarSizeRatio, appEnabled);
+    tAppMenu *appMenu = new tAppMenu(manifest.MenuName, manifest.MenuParent, manifest.MenuPriority, manifest.MenuVisible,
+                                     appEnabled, manifest.Global, manifest.Version, dirApp, fileSettings);
+    appMenu->Toolbar = appToolbar;
+    InsertByPriority(ListMenus, appMenu);
+    InsertByPriority(ListToolbars, appToolbar);
+    AppMenus.insert(manifest.Path, appMenu);
+    AppManifests.insert(manifest.Path, manifest);
+
+    // Run commands specified by each app (there could be conflicts/contradictions)
+    if (appEnabled){
+        foreach (QString command, manifest.RunCommands){
+            if (!command.isEmpty()){
+                RDK->Command(command);
             }
         }
+    }
 
-        if (!fileExist){
-             fileSettings = dirAppComplete + "/AppConfig.ini"; // Use default INI file name
+    if (appEnabled && manifest.HasInit){
+        // Add the App's directory to the search path for Python modules (PYTHONPATH). Typically C:/RoboDK/Apps unless there is an AppLink.ini
+        QString appDir = QFileInfo(dirAppComplete).absolutePath();
+        if (!PypathAppsDirs.contains(appDir)){
+            PypathAppsDirs.append(appDir);
         }
+    }
 
-        RDK->ShowMessage(tr("Loading App ") + dirApp + tr(". Using settings file: ") + fileSettings, false);
-
-        // Load settings and save them (default settings will be set)
-        QSettings settings(fileSettings, QSettings::IniFormat);
-        QString menuName = settings.value("MenuName", dirApp).toString();
-        QString menuParent = settings.value("MenuParent", "").toString();
-        QString version = settings.value("Version", "1.0.0").toString();
-        double menuPriority = settings.value("MenuPriority", 50.0).toDouble();
-        bool menuVisible = settings.value("MenuVisible", true).toBool();
-        int toolbarArea = settings.value("ToolbarArea", 2).toInt();
-        double toolbarSize = settings.value("ToolbarSizeRatio", 1.5).toDouble();
-        QStringList RunCommands = settings.value("RunCommands", QStringList()).toStringList();
-
-        settings.setValue("MenuName", menuName);
-        settings.setValue("MenuParent", menuParent);
-        settings.setValue("Version", version);
-        settings.setValue("MenuPriority", menuPriority);
-        settings.setValue("MenuVisible", menuVisible);
+    if (appEnabled && SearchInstallRequirements && !manifest.Requirements.isEmpty()){
+        // Dependencies are installed once all apps are loaded
+        SearchRequirements.append(qMakePair(dirApp, manifest.Requirements));
+    }
 
-        // Remove obsoleted key
-        if (settings.contains("Enabled"))
-            settings.remove("Enabled");
+    // List of actions for the menu
+    QList<tAppAction*> menuActions;
+    // List of actions for the toolbar
+    QList<tAppAction*> toolbarActions;
 
-        settings.setValue("ToolbarArea", toolbarArea);
-        settings.setValue("ToolbarSizeRatio", toolbarSize);
-        settings.setValue("RunCommands", RunCommands);
+    QList<QActionGroup*> actionGroups;
+    QList<int> actionGroupIds;
 
+    // Iterate through each action (script or executable) of the App
+    for (const tAppActionManifest &info : manifest.Actions){
 
-        QString applicationName = QCoreApplication::applicationName();
-        if (applicationName.isEmpty())
-            applicationName = "RoboDK";
+        // Forget about this action if it is set to non visible
+        if (!info.Visible || (!SearchDeveloperMode && info.DeveloperOnly)){
+            continue;
+        }
 
-        QString pluginName = PluginName().remove(' ');
+        // matching image given the key name, and the image of the checked state
+        QIcon icon;
+        if (!info.IconFile.isEmpty()){
+            icon = QIcon(info.IconFile);
+        }
+        if (!info.IconFileChecked.isEmpty()){
+            icon.addFile(info.IconFileChecked, QSize(), QIcon::Mode::Normal, QIcon::State::On);
+        }
 
-        QSettings pluginSettings(QSettings::IniFormat, QSettings::UserScope,
-                                 applicationName, pluginName);
+        // create the new action
+        QAction *action = new QAction(icon, info.DisplayName);
 
-        QStringList enabledApps;
-        pluginSettings.beginGroup("Enabled");
-        int count = pluginSettings.value("count", 0).toInt();
-        enabledApps.reserve(count);
-        for (int eindex = 0; eindex < count; ++eindex)
-            enabledApps << pluginSettings.value(QString::number(eindex)).toString();
-        pluginSettings.endGroup();
+        // apply shortcut, if available
+        if (!info.Shortcut.isEmpty()){
+            action->setShortcut(QKeySequence(info.Shortcut));
+        }
 
-#ifdef Q_OS_WIN
-        bool appEnabled = enabledApps.contains(fileSettings, Qt::CaseInsensitive);
-#else
-        bool appEnabled = enabledApps.contains(fileSettings);
+        // Add tooltips
+        action->setWhatsThis(info.Description);
+        action->setToolTip(info.Description);
+        action->setStatusTip(info.Description);
+
+        // set checkable
+        if (info.Checkable){
+            action->setCheckable(true);
+
+            // create a group for matching group if the group number is >= 0
+            if (info.CheckableGroup >= 0){
+                int existing_group_id = actionGroupIds.indexOf(info.CheckableGroup);
+                QActionGroup *actn_group = nullptr;
+                if (existing_group_id < 0){
+                    actn_group = new QActionGroup(action); // the group will get deleted with the first action
+                    actionGroups.append(actn_group);
+                    actionGroupIds.append(info.CheckableGroup);
+
+                    // this is not allowed with MSVC2013!
+                    // make the action group allowed to not have anything selected
+#if _MSC_VER > 1800
+                    connect(actn_group, &QActionGroup::triggered, [lastAction = static_cast<QAction *>(nullptr)](QAction* action) mutable {
+                        //if (action == lastAction){// && !action->isChecked())
+                        if (action == lastAction)
+                        {
+                            qDebug() << "Unchecking checked action";
+                            //action->blockSignals(true); // prevents the process from stopping
+                            action->setChecked(false);
+                            //action->blockSignals(false);
+                            lastAction = nullptr;
+                        } else {
+                            //qDebug() << "Last action checked";
+                            lastAction = action;
+                        }
+                      });
 #endif
 
-
-        // Create a new list for menus and toolbars
-        tAppToolbar *appToolbar = new tAppToolbar(menuName, menuPriority, toolbarArea,
-                                                  toolbarSize, appEnabled);
-        tAppMenu *appMenu = new tAppMenu(menuName, menuParent, menuPriority, menuVisible,
-                                         appEnabled, global, version, dirApp, fileSettings);
-        appMenu->Toolbar = appToolbar;
-        ListMenus.append(appMenu);
-        ListToolbars.append(appToolbar);
-
-        // Run commands specified by each app (there could be conflicts/contradictions)
-        if (appEnabled){
-            appsenabled_count = appsenabled_count + 1;
-            foreach (QString command, RunCommands){
-                if (!command.isEmpty()){
-                    RDK->Command(command);
+                } else {
+                    actn_group = actionGroups.at(existing_group_id);
                 }
+                actn_group->addAction(action);
             }
         }
 
-        // List of actions for the menu
-        QList<tAppAction*> menuActions;
-        // List of actions for the toolbar
-        QList<tAppAction*> toolbarActions;
+        // Add the actions in the global list:
+        InsertByPriority(ListActions, new tAppAction(action, info.Priority, appMenu, info.TypesShowOnContextMenu, info.TypesDoubleClick));
 
-        QList<QActionGroup*> actionGroups;
-        QList<int> actionGroupIds;
+        // Add the actions to the menu and toolbar
+        if (info.AddToMenu)
+            menuActions.append(new tAppAction(action, info.Priority, appMenu));
 
+        if (info.AddToToolbar)
+            toolbarActions.append(new tAppAction(action, info.Priority, appMenu));
 
-        // Get the list of files in the folder
-        QDir dirAppi(dirAppComplete);
-        QStringList filesApp(dirAppi.entryList(QDir::Files));
-
-        // Iterate through each App (folder)
-        foreach (QString file, filesApp){
-
-            if (appEnabled && file.compare("__init__.py", Qt::CaseSensitive) == 0){
-                // Add the App's directory to the search path for Python modules (PYTHONPATH). Typically C:/RoboDK/Apps unless there is an AppLink.ini
-                QString appDir = QFileInfo(dirAppComplete).absolutePath();
-                if (!PypathAppsDirs.contains(appDir)){
-                    PypathAppsDirs.append(appDir);
-                }
-            }
+        // Create a slot connection to trigger the script, use the object name to remember the file script that we need to run
+        action->setObjectName(info.FileScript);
 
-            // Files that starts with _ are skipped as they are 'internal' files
-            if (file.startsWith("_")){
-                continue;
-            }
-
-            if (appEnabled && install_requirements && (file.compare("requirements.txt", Qt::CaseSensitive) == 0)){
-                // Preload all dependencies to the Python Interpreter
-                qDebug() << "Installing Python dependencies for " + dirApp;
-
-                QProcess process;
-                connect(&process, &QProcess::readyRead, this, &AppLoader::onPipReadyRead);
-                process.setProcessChannelMode(QProcess::MergedChannels);
-
-                // Check if requirements are missing. This is quicker than pip install, thus it does not hang the UI as much.
-                QStringList args;
-                args << "-c" << "import pkg_resources; pkg_resources.require(open('" + dirAppComplete + "/" + file + "',mode='r'))";
-                process.start(RDK->getParam("PYTHON_EXEC"), args);
-                if (!process.waitForFinished(-1) ||
-                    process.error() == QProcess::FailedToStart ||
-                    process.exitStatus() != QProcess::NormalExit){
-                    qDebug() << "Unable to check Python dependencies for " + dirApp;
-                    continue;
-                }
-                if (process.exitCode() == 0){ // 1 means something to install
-                    qDebug() << "All dependencies are installed for " + dirApp;
-                    continue;
-                }
-                process.close();
-
-                // Install missing requirements (hangs the UI)
-                RDK->ShowMessage("Installing additionnal Python dependencies for App \"" + dirApp + "\". See requirements.txt in the app folder.\n\nRoboDK might become unresponsive during this process, please wait.", true);
-
-                // Using a detached process on Windows breaks the debugger (requires run from terminal).
-                // This solution works in all cases, but is time consuming.. do this only when loading the plugin.
-                args.clear();
-                args << "-m" << "pip" << "install" << "--ignore-installed" << "-r" << dirAppComplete + "/" + file;
-                process.start(RDK->getParam("PYTHON_EXEC"), args);
-                if (!process.waitForFinished(-1) ||
-                    process.error() == QProcess::FailedToStart ||
-                    process.exitStatus() != QProcess::NormalExit ||
-                    process.exitCode() < 0){
-                    RDK->ShowMessage("Failed to install additional Python dependencies for App \"" + dirApp + "\".", true);
-                }
-            }
+        // Checkable actions and executables always run in their own process
+        action->setProperty("RunInWorker", info.RunInWorker && !info.Checkable && info.FileScript.endsWith(".py", Qt::CaseInsensitive));
+        if (info.Checkable){
+            // trigger on check and uncheck
+            connect(action, &QAction::toggled, this, &AppLoader::onRunScript);
+        } else {
+            connect(action, &QAction::triggered, this, &AppLoader::onRunScript);
+        }
 
-            if (!file.endsWith(".py", Qt::CaseInsensitive) && !file.endsWith(".exe", Qt::CaseInsensitive)){
-                continue;
-            }
+        // keep the pointers to delete them when the plugin is unloaded
+        AllActions.append(action);
+    }
 
-            // Get the key name for the settings file
-            QString keyName(file);
-            if (file.endsWith(".py", Qt::CaseInsensitive)){
-                keyName.chop(3); // ends with PY
-            } else {
-                keyName.chop(4); // ends with EXE
-            }
+    // Sort actions for the menu and the toolbar
+    qSort(menuActions.begin(),    menuActions.end(),    CheckPriority());
+    qSort(toolbarActions.begin(), toolbarActions.end(), CheckPriority());
 
-            QString name_guess(QString(keyName).replace("_"," "));
-
-            // Read settings from AppSettings if they exist, otherwise, set the default values
-            QString displayName = settings.value(keyName + "/DisplayName", name_guess).toString();
-            QString comment = settings.value(keyName + "/Description", name_guess).toString();
-            bool visible = settings.value(keyName + "/Visible", true).toBool();
-            bool developerOnly = settings.value(keyName + "/DeveloperOnly", false).toBool();
-            QString shortcutstr = settings.value(keyName + "/Shortcut", "").toString();
-            bool checkable = settings.value(keyName + "/Checkable", false).toBool();
-            int checkable_group = settings.value(keyName + "/CheckableGroup", -1).toInt();
-            bool addToMenu = settings.value(keyName + "/AddToMenu", true).toBool();
-            bool addToToolBar = settings.value(keyName + "/AddToToolbar", true).toBool();
-            double priority = settings.value(keyName + "/Priority", 50.0f).toDouble();
-            QStringList types_rightclick_str = settings.value(keyName + "/TypeOnContextMenu", QStringList("")).toStringList(); // Multiple item support. Format can be "TypeOnContextMenu=int" or "TypeOnContextMenu=int, int, .."
-            QStringList types_doubleclick_str = settings.value(keyName + "/TypeOnDoubleClick", QStringList("")).toStringList(); // Multiple item support. Format can be "TypeOnDoubleClick=int" or "TypeOnDoubleClick=int, int, .."
-
-            // Remove invalid inputs from string lists
-            QList<int> types_rightclick = ParseStringList(types_rightclick_str);
-            QList<int> types_doubleclick = ParseStringList(types_doubleclick_str);
-
-            // Prevent empty names
-            if (displayName.isEmpty()){
-                displayName = keyName;
-            }
+    // Add menu actions to the menu
+    for (int i=0; i<menuActions.length(); i++){
+        appMenu->Actions.append(menuActions[i]->Action);
+    }
 
-            // Save settings to AppSettings file to let the user change them if desired
-            settings.setValue(keyName + "/DisplayName", displayName);
-            settings.setValue(keyName + "/Description", comment);
-            settings.setValue(keyName + "/Visible", visible);
-            settings.setValue(keyName + "/DeveloperOnly", developerOnly);
-            settings.setValue(keyName + "/Shortcut", shortcutstr);
-            settings.setValue(keyName + "/Checkable", checkable);
-            settings.setValue(keyName + "/CheckableGroup", checkable_group);
-            settings.setValue(keyName + "/AddToMenu", addToMenu);
-            settings.setValue(keyName + "/AddToToolbar", addToToolBar);
-            settings.setValue(keyName + "/Priority", priority);
-            settings.setValue(keyName + "/TypeOnContextMenu",  types_rightclick_str);
-            settings.setValue(keyName + "/TypeOnDoubleClick",  types_doubleclick_str);
-
-            // Forget about this action if it is set to non visible
-            if (!visible || (!isDeveloperMode && developerOnly)){
-                continue;
-            }
+    // Add toolbar actions to the toolbar
+    for (int i=0; i<toolbarActions.length(); i++){
+        appToolbar->Actions.append(toolbarActions[i]->Action);
+    }
+    return appMenu;
+}
 
-            // try to find a matching image given the key name:
-            QIcon *icon;
-            QString fileCompleteNoExt(dirAppComplete + "/" + keyName);
-            QString iconfile;
-            if (QFile::exists(fileCompleteNoExt + ".svg")){
-                iconfile = fileCompleteNoExt + ".svg";
-                icon = new QIcon(iconfile);
-            } else if (QFile::exists(fileCompleteNoExt + ".png")){
-                iconfile = fileCompleteNoExt + ".png";
-                icon = new QIcon(iconfile);
-            } else if (QFile::exists(fileCompleteNoExt + ".jpg")){
-                iconfile = fileCompleteNoExt + ".jpg";
-                icon = new QIcon(iconfile);
-            } else if (QFile::exists(fileCompleteNoExt + ".ico")){
-                iconfile = fileCompleteNoExt + ".ico";
-                icon = new QIcon(iconfile);
-            } else {
-                icon = new QIcon();
-            }
+void AppLoader::AppsSearchEnd(){
+    // Install missing Python dependencies of enabled apps
+    for (const QPair<QString, QString> &requirements : SearchRequirements){
+        AppsInstallRequirements(requirements.first, requirements.second);
+    }
+    SearchRequirements.clear();
 
-            // add icon active
-            if (checkable && iconfile.length() > 4){
-                QString iconfile_checked = QString(iconfile).insert(iconfile.length()-4,"Checked");
-                if (QFile::exists(iconfile_checked)){
-                    icon->addFile(iconfile_checked, QSize(), QIcon::Mode::Normal, QIcon::State::On);
-                }
-            }
+    // Append Apps directories to RoboDK's PYTHONPATH
+    AppsPythonPathAdd();
 
-            // create the new action
-            QAction *action = new QAction(*icon, displayName);
+    // Watch the apps for changes
+    AppsWatch();
 
-            // apply shortcut, if available
-            if (!shortcutstr.isEmpty()){
-                action->setShortcut(QKeySequence(shortcutstr));
-            }
+    // Done
+    int appsenabled_count = 0;
+    for (const tAppMenu *appmenu : ListMenus){
+        if (appmenu->Active){
+            appsenabled_count++;
+        }
+    }
+    QString msg(tr("Done loading Apps"));
+    if (appsenabled_count > 0){
+        msg.append(": " + QString("%1 RoboDK Apps active.").arg(appsenabled_count));
+    }
+    RDK->ShowMessage(msg, false);
+}
 
-            delete icon;
+void AppLoader::onAppFound(const tAppManifest &manifest){
+    tAppMenu *appMenu = AppsAdd(manifest);
 
-            // Add tooltips
-            action->setWhatsThis(comment);
-            action->setToolTip(comment);
-            action->setStatusTip(comment);
+    // Show the app right away, at its place according to the priority
+    AppsLoadMenu(appMenu);
+    if (ToolbarsLoaded){
+        AppsLoadToolbar(appMenu->Toolbar);
+    }
+}
 
-            // set checkable
-            if (checkable){
-                action->setCheckable(true);
+void AppLoader::onAppsSearchFinished(){
+    AppsSearchEnd();
 
-                // create a group for matching group if the group number is >= 0
-                if (checkable_group >= 0){
-                    int existing_group_id = actionGroupIds.indexOf(checkable_group);
-                    QActionGroup *actn_group = nullptr;
-                    if (existing_group_id < 0){
-                        actn_group = new QActionGroup(action); // the group will get deleted with the first action
-                        actionGroups.append(actn_group);
-                        actionGroupIds.append(checkable_group);
+    // start the workers once the PYTHONPATH includes the apps
+    WorkersStart();
+}
 
-                        // this is not allowed with MSVC2013!
-                        // make the action group allowed to not have anything selected
-#if _MSC_VER > 1800
-                        connect(actn_group, &QActionGroup::triggered, [lastAction = static_cast<QAction *>(nullptr)](QAction* action) mutable {
-                            //if (action == lastAction){// && !action->isChecked())
-                            if (action == lastAction)
-                            {
-                                qDebug() << "Unchecking checked action";
-                                //action->blockSignals(true); // prevents the process from stopping
-                                action->setChecked(false);
-                                //action->blockSignals(false);
-                                lastAction = nullptr;
-                            } else {
-                                //qDebug() << "Last action checked";
-                                lastAction = action;
-                            }
-                          });
-#endif
+void AppLoader::AppsRemove(tAppMenu *appMenu){
+    tAppToolbar *appToolbar = appMenu->Toolbar;
 
-                    } else {
-                        actn_group = actionGroups.at(existing_group_id);
-                    }
-                    actn_group->addAction(action);
-                }
-            }
+    // remove the menu and the toolbar
+    if (appMenu->MenuSeparator != nullptr){
+        appMenu->MenuSeparator->deleteLater();
+    }
+    if (appMenu->Menu != nullptr){
+        AllMenus.removeAll(appMenu->Menu);
+        appMenu->Menu->deleteLater();
+    }
+    if (appToolbar != nullptr && appToolbar->ToolBar != nullptr){
+        AllToolbars.removeAll(appToolbar->ToolBar);
+        appToolbar->ToolBar->deleteLater();
+    }
 
-            // Add the actions in the global list:
-            ListActions.append(new tAppAction(action, priority, appMenu, types_rightclick, types_doubleclick));
+    // remove the actions of the app
+    for (int i=ListActions.length()-1; i>=0; i--){
+        tAppAction *appAction = ListActions[i];
+        if (appAction->AppMenu != appMenu){
+            continue;
+        }
+        AllActions.removeAll(appAction->Action);
+        appAction->Action->deleteLater();
+        delete ListActions.takeAt(i);
+    }
 
-            // Add the actions to the menu and toolbar
-            if (addToMenu)
-                menuActions.append(new tAppAction(action, priority, appMenu));
+    QString path = AppMenus.key(appMenu);
+    AppMenus.remove(path);
+    AppManifests.remove(path);
+    ListMenus.removeAll(appMenu);
+    ListToolbars.removeAll(appToolbar);
+    delete appToolbar;
+    delete appMenu;
+}
 
-            if (addToToolBar)
-                toolbarActions.append(new tAppAction(action, priority, appMenu));
+void AppLoader::AppsUpdate(){
+    if (Discovery->IsSearching()){
+        // the apps are still being loaded: try again later
+        WatchTimer->start();
+        return;
+    }
 
-            // Create a slot connection to trigger the script, use the object name to remember the file script that we need to run
-            QString fileScript(dirAppComplete + "/" + file);
-            action->setObjectName(fileScript);
-            if (checkable){
-                // trigger on check and uncheck
-                connect(action, &QAction::toggled, this, &AppLoader::onRunScript);
-            } else {
-                connect(action, &QAction::triggered, this, &AppLoader::onRunScript);
+    // Read the apps again (only the apps that changed are parsed, see the index cache)
+    AppsSearchBegin(false);
+    QList<tAppManifest> manifests = Discovery->Search();
+
+    QStringList pypathPrevious = PypathAppsDirs;
+    QSet<QString> found;
+    int changes = 0;
+    for (const tAppManifest &manifest : manifests){
+        found.insert(manifest.Path);
+        tAppMenu *appMenu = AppMenus.value(manifest.Path, nullptr);
+        if (appMenu != nullptr){
+            if (AppManifestSame(AppManifests.value(manifest.Path), manifest)){
+                continue;
             }
-
-            // keep the pointers to delete them when the plugin is unloaded
-            AllActions.append(action);
+            qDebug() << "App changed: " << manifest.Path;
+            AppsRemove(appMenu);
+        } else {
+            qDebug() << "App added: " << manifest.Path;
         }
+        appMenu = AppsAdd(manifest);
+        AppsLoadMenu(appMenu);
+        if (ToolbarsLoaded){
+            AppsLoadToolbar(appMenu->Toolbar);
+        }
+        changes++;
+    }
 
-        // Sort actions for the menu and the toolbar
-        qSort(menuActions.begin(),    menuActions.end(),    CheckPriority());
-        qSort(toolbarActions.begin(), toolbarActions.end(), CheckPriority());
-
-        // Add menu actions to the menu
-        for (int i=0; i<menuActions.length(); i++){
-            appMenu->Actions.append(menuActions[i]->Action);
+    // Remove the apps that no longer exist
+    for (const QString &path : AppMenus.keys()){
+        if (!found.contains(path)){
+            qDebug() << "App removed: " << path;
+            AppsRemove(AppMenus.value(path));
+            changes++;
         }
+    }
 
-        // Add toolbar actions to the toolbar
-        for (int i=0; i<toolbarActions.length(); i++){
-            appToolbar->Actions.append(toolbarActions[i]->Action);
+    // Update the PYTHONPATH if the list of app directories changed
+    QStringList pypathDirs;
+    QHashIterator<QString, tAppMenu*> i(AppMenus);
+    while (i.hasNext()){
+        i.next();
+        const tAppManifest &manifest = AppManifests[i.key()];
+        QString appDir = QFileInfo(manifest.DirAppComplete).absolutePath();
+        if (i.value()->Active && manifest.HasInit && !pypathDirs.contains(appDir)){
+            pypathDirs.append(appDir);
         }
     }
+    PypathAppsDirs = pypathPrevious;
+    if (QSet<QString>::fromList(pypathDirs) != QSet<QString>::fromList(pypathPrevious)){
+        AppsPythonPathRemove();
+        PypathAppsDirs = pypathDirs;
+        AppsPythonPathAdd();
+        WorkersStart();
+    }
 
-    // Sort all actions
-    if (ListActions.length() > 1){
-        qSort(ListActions.begin(), ListActions.end(), CheckPriority());
+    AppsWatch();
+    if (changes > 0){
+        RDK->ShowMessage(tr("Apps updated: %1 changes").arg(changes), false);
     }
+}
 
-    // Sort menus
-    if (ListMenus.length() > 1){
-        qSort(ListMenus.begin(), ListMenus.end(), CheckPriority());
+void AppLoader::AppsWatch(){
+    QStringList paths;
+    paths << PathApps << PathUserApps;
+    for (const tAppManifest &manifest : AppManifests){
+        paths.append(manifest.StampPaths);
     }
+    paths.removeDuplicates();
 
-    // Sort toolbars
-    if (ListToolbars.length() > 1){
-        qSort(ListToolbars.begin(), ListToolbars.end(), CheckPriority());
+    // Only existing files and folders can be watched
+    QStringList existing;
+    for (const QString &path : paths){
+        if (QFileInfo::exists(path)){
+            existing.append(path);
+        }
     }
 
-    // Append Apps directories to RoboDK's PYTHONPATH
-    if (!PypathAppsDirs.empty()){
-#ifdef Q_OS_WIN
-        QString path_sep(";");
-#else
-        QString path_sep(":");
-#endif
+    // Watch everything again: files replaced by a new file (for example, when saving an INI file) are no longer watched
+    QStringList watched = Watcher->files() + Watcher->directories();
+    if (!watched.isEmpty()){
+        Watcher->removePaths(watched);
+    }
+    if (!existing.isEmpty()){
+        Watcher->addPaths(existing);
+    }
+}
 
-        QStringList pypathList = RDK->getParam("PYTHONPATH").replace("\\","/").split(path_sep);
-        pypathList.append(PypathAppsDirs);
-        pypathList.removeDuplicates();
+void AppLoader::onAppsChanged(const QString &path){
+    // Wait until the changes stop (copying an app or checking out a branch changes many files)
+    qDebug() << "App files changed: " << path;
+    WatchTimer->start();
+}
 
-        QString pypath = "";
-        for (const QString& path : pypathList){
-            if (pypath != ""){
-                pypath += path_sep;
-            }
-            pypath += path;
-        }
-        qDebug() << "Python path: " << RDK->Command("PYTHONPATH", pypath);
-    }
+void AppLoader::AppsInstallRequirements(const QString &dirApp, const QString &requirements){
+    // Preload all dependencies to the Python Interpreter
+    qDebug() << "Installing Python dependencies for " + dirApp;
 
-    // Done
-    QString msg(tr("Done loading Apps"));
-    if (appsenabled_count > 0){
-        msg.append(": " + QString("%1 RoboDK Apps active.").arg(appsenabled_count));
+    QProcess process;
+    connect(&process, &QProcess::readyRead, this, &AppLoader::onPipReadyRead);
+    process.setProcessChannelMode(QProcess::MergedChannels);
+
+    // Check if requirements are missing. This is quicker than pip install, thus it does not hang the UI as much.
+    QStringList args;
+    args << "-c" << "import pkg_resources; pkg_resources.require(open('" + requirements + "',mode='r'))";
+    process.start(RDK->getParam("PYTHON_EXEC"), args);
+    if (!process.waitForFinished(-1) ||
+        process.error() == QProcess::FailedToStart ||
+        process.exitStatus() != QProcess::NormalExit){
+        qDebug() << "Unable to check Python dependencies for " + dirApp;
+        return;
+    }
+    if (process.exitCode() == 0){ // 1 means something to install
+        qDebug() << "All dependencies are installed for " + dirApp;
+        return;
+    }
+    process.close();
+
+    // Install missing requirements (hangs the UI)
+    RDK->ShowMessage("Installing additionnal Python dependencies for App \"" + dirApp + "\". See requirements.txt in the app folder.\n\nRoboDK might become unresponsive during this process, please wait.", true);
+
+    // Using a detached process on Windows breaks the debugger (requires run from terminal).
+    // This solution works in all cases, but is time consuming.. do this only when loading the plugin.
+    args.clear();
+    args << "-m" << "pip" << "install" << "--ignore-installed" << "-r" << requirements;
+    process.start(RDK->getParam("PYTHON_EXEC"), args);
+    if (!process.waitForFinished(-1) ||
+        process.error() == QProcess::FailedToStart ||
+        process.exitStatus() != QProcess::NormalExit ||
+        process.exitCode() < 0){
+        RDK->ShowMessage("Failed to install additional Python dependencies for App \"" + dirApp + "\".", true);
     }
-    RDK->ShowMessage(msg, false);
 }
 
 void AppLoader::AppsLoadMenus(){
@@ -837,33 +916,7 @@ void AppLoader::AppsLoadMenus(){
 
     // Create all menus
     for (int i=0; i<ListMenus.length(); i++){
-        tAppMenu *appmenu = ListMenus[i];
-        if (!appmenu->Active){
-            continue;
-        }
-        // add menu to another submenu
-        QMenu *menui = nullptr;
-        if (!appmenu->ParentMenu.isEmpty()){
-            QMenu *menu_attach = MenuBar->findChild<QMenu *>(appmenu->ParentMenu);
-            if (menu_attach != nullptr){
-                /*if (menuTools->actions().length() > id_action){
-                    qDebug() << "Inserting menu action at location " << id_action;
-                    menuTools->insertAction(menuTools->actions()[id_action], action_robotpilot);
-                } else {
-                */
-                qDebug() << "Inserting menu action at the end of the parent menu: " << appmenu->Name;
-                menu_attach->addSeparator();
-                menui = menu_attach->addMenu(appmenu->Name);
-                //}
-            }
-        }
-        if (menui == nullptr){
-            qDebug() << "Adding menu in the main menu: " << appmenu->Name;
-            menui = MenuBar->addMenu(appmenu->Name);
-        }
-        menui->addActions(appmenu->Actions);
-        menui->menuAction()->setVisible(appmenu->Visible && !appmenu->Actions.isEmpty());
-        AllMenus.append(menui);
+        AppsLoadMenu(ListMenus[i]);
     }
 
     // If we didn't find anything: add a help section
@@ -884,7 +937,55 @@ void AppLoader::AppsLoadMenus(){
     }*/
 }
 
+void AppLoader::AppsLoadMenu(tAppMenu *appmenu){
+    if (!appmenu->Active || appmenu->Menu != nullptr){
+        return;
+    }
+
+    // add menu to another submenu
+    QMenu *menu_attach = nullptr;
+    if (!appmenu->ParentMenu.isEmpty()){
+        menu_attach = MenuBar->findChild<QMenu *>(appmenu->ParentMenu);
+    }
+    QWidget *parent = (menu_attach != nullptr) ? static_cast<QWidget*>(menu_attach) : static_cast<QWidget*>(MenuBar);
+
+    // Insert the menu before the next app (by priority) already shown in the same parent, otherwise at the end
+    QAction *before = nullptr;
+    for (int i = ListMenus.indexOf(appmenu) + 1; i < ListMenus.length(); i++){
+        tAppMenu *next = ListMenus[i];
+        if (next->Menu != nullptr && next->Menu->parentWidget() == parent){
+            before = (next->MenuSeparator != nullptr) ? next->MenuSeparator : next->Menu->menuAction();
+            break;
+        }
+    }
+
+    QMenu *menui = nullptr;
+    if (menu_attach != nullptr){
+        qDebug() << "Inserting menu action in the parent menu: " << appmenu->Name;
+        appmenu->MenuSeparator = menu_attach->insertSeparator(before);
+        menui = new QMenu(appmenu->Name, menu_attach);
+        menu_attach->insertMenu(before, menui);
+    } else {
+        qDebug() << "Adding menu in the main menu: " << appmenu->Name;
+        menui = new QMenu(appmenu->Name, MenuBar);
+        MenuBar->insertMenu(before, menui);
+    }
+    menui->addActions(appmenu->Actions);
+    menui->menuAction()->setVisible(appmenu->Visible && !appmenu->Actions.isEmpty());
+    appmenu->Menu = menui;
+    AllMenus.append(menui);
+}
+
 void AppLoader::AppsUnloadMenus(){
+    // remove the separators added to parent menus
+    for (tAppMenu *appmenu : ListMenus){
+        if (appmenu->MenuSeparator != nullptr){
+            appmenu->MenuSeparator->deleteLater();
+            appmenu->MenuSeparator = nullptr;
+        }
+        appmenu->Menu = nullptr;
+    }
+
     // delete all menus
     for (int i=AllMenus.length()-1; i>=0; i--){
         AllMenus.takeLast()->deleteLater();
@@ -892,6 +993,10 @@ void AppLoader::AppsUnloadMenus(){
 }
 
 void AppLoader::AppsUnloadToolbars(){
+    for (tAppToolbar *appToolbar : ListToolbars){
+        appToolbar->ToolBar = nullptr;
+    }
+
     // delete all the toolbars
     for (int i=AllToolbars.length()-1; i>=0; i--){
         AllToolbars.takeLast()->deleteLater();
@@ -900,26 +1005,45 @@ void AppLoader::AppsUnloadToolbars(){
 
 void AppLoader::AppsLoadToolbars(){
     AppsUnloadToolbars();
+    ToolbarsLoaded = true;
 
     // load toolbars
     for (int i=0; i<ListToolbars.length(); i++){
-        tAppToolbar *appToolbar = ListToolbars[i];
-        if (!appToolbar->Active || appToolbar->Actions.length() <= 0){
-            continue;
-        }
-        QToolBar *toolbar_i = new QToolBar(appToolbar->Name);
-        toolbar_i->addActions(appToolbar->Actions);
-        if (IconSize > 0){
-            toolbar_i->setIconSize(QSize(IconSize*appToolbar->SizeRatio, IconSize*appToolbar->SizeRatio));
-        }
-        toolbar_i->setObjectName(PluginName() + "-" + appToolbar->Name);
-        Qt::ToolBarArea area = Qt::ToolBarArea::RightToolBarArea;
-        if (appToolbar->ToolbarArea >= 0){
-            area = (Qt::ToolBarArea) appToolbar->ToolbarArea;
+        AppsLoadToolbar(ListToolbars[i]);
+    }
+}
+
+void AppLoader::AppsLoadToolbar(tAppToolbar *appToolbar){
+    if (!appToolbar->Active || appToolbar->Actions.length() <= 0 || appToolbar->ToolBar != nullptr){
+        return;
+    }
+    QToolBar *toolbar_i = new QToolBar(appToolbar->Name);
+    toolbar_i->addActions(appToolbar->Actions);
+    if (IconSize > 0){
+        toolbar_i->setIconSize(QSize(IconSize*appToolbar->SizeRatio, IconSize*appToolbar->SizeRatio));
+    }
+    toolbar_i->setObjectName(PluginName() + "-" + appToolbar->Name);
+    Qt::ToolBarArea area = Qt::ToolBarArea::RightToolBarArea;
+    if (appToolbar->ToolbarArea >= 0){
+        area = (Qt::ToolBarArea) appToolbar->ToolbarArea;
+    }
+
+    // Insert the toolbar before the next app (by priority) already shown in the same area, otherwise at the end
+    QToolBar *before = nullptr;
+    for (int i = ListToolbars.indexOf(appToolbar) + 1; i < ListToolbars.length(); i++){
+        tAppToolbar *next = ListToolbars[i];
+        if (next->ToolBar != nullptr && MainWindow->toolBarArea(next->ToolBar) == area){
+            before = next->ToolBar;
+            break;
         }
+    }
+    if (before != nullptr){
+        MainWindow->insertToolBar(before, toolbar_i);
+    } else {
         MainWindow->addToolBar(area, toolbar_i);
-        AllToolbars.append(toolbar_i);
     }
+    appToolbar->ToolBar = toolbar_i;
+    AllToolbars.append(toolbar_i);
 }
 
 /*
@@ -990,6 +1114,14 @@ void AppLoader::onRunScript(){
         RDK->setParam(param_name, action->isChecked() ? "1" : "0");
     }
 
+    // run the script in a Python worker if one is idle (no need to start Python and import the robodk modules)
+    if (action->property("RunInWorker").toBool()){
+        showErrors = true;
+        if (WorkerPool->Run(filepath, QStringList())){
+            return;
+        }
+    }
+
     // start the process
     QProcess *proc = new QProcess();
     proc->setObjectName("Process: " + filepath);
@@ -1003,8 +1135,13 @@ void AppLoader::onRunScript(){
 
     if (action->isCheckable()){
         if (action->isChecked()){
-            // make sure we uncheck the action if the process ends or stops
-            connect(proc, static_cast<void(QProcess::*)(int)>(&QProcess::finished), proc, [action]() {
+            // make sure we uncheck the action if the process ends or stops (the action is deleted if its app is updated)
+            QPointer<QAction> action_ptr(action);
+            connect(proc, static_cast<void(QProcess::*)(int)>(&QProcess::finished), proc, [action_ptr]() {
+                QAction *action = action_ptr.data();
+                if (action == nullptr){
+                    return;
+                }
 
                 QActionGroup *grp = action->actionGroup();
                 if (grp != nullptr && grp->checkedAction() == action){
@@ -1045,6 +1182,38 @@ void AppLoader::onRunScript(){
     }
 
     // Add RoboDK's environnement to the process
+    proc->setEnvironment(ScriptEnvironment().toStringList());
+
+    // run the script
+    QStringList args;
+    if (action->isCheckable()){ // pass an argument if the option is checkable
+        args.append(action->isChecked() ? "Checked" : "Unchecked");
+    }
+    if (filepath.endsWith(".py", Qt::CaseInsensitive)){
+        args.prepend(filepath);
+        qDebug() << "Running script: " << filepath;
+        proc->start(RDK->getParam("PYTHON_EXEC"), args);
+    } else {
+        qDebug() << "Running custom executable: " << filepath;
+        proc->start(filepath);
+    }
+    qDebug() << "Arguments: " << args;
+
+}
+
+void AppLoader::WorkersStart(){
+    if (PythonWorkers <= 0){
+        WorkerPool->Stop();
+        return;
+    }
+
+    // modules commonly used by apps are imported in advance (modules that are not installed are skipped)
+    QStringList imports;
+    imports << "robodk.robolink" << "robodk.robomath" << "robodk.robodialogs" << "numpy";
+    WorkerPool->Start(PythonWorkers, RDK->getParam("PYTHON_EXEC"), ScriptEnvironment(), imports);
+}
+
+QProcessEnvironment AppLoader::ScriptEnvironment(){
 #ifdef Q_OS_WIN
     QString path_sep(";");
 #else
@@ -1066,24 +1235,29 @@ void AppLoader::onRunScript(){
     // Override API port
     QString apiport = RDK->Command("PORT","");
     env.insert("ROBODK_API_PORT", apiport);
+    return env;
+}
 
-    proc->setEnvironment(env.toStringList());
-
-    // run the script
-    QStringList args;
-    if (action->isCheckable()){ // pass an argument if the option is checkable
-        args.append(action->isChecked() ? "Checked" : "Unchecked");
-    }
-    if (filepath.endsWith(".py", Qt::CaseInsensitive)){
-        args.prepend(filepath);
-        qDebug() << "Running script: " << filepath;
-        proc->start(RDK->getParam("PYTHON_EXEC"), args);
+void AppLoader::ShowScriptError(const QString &name, int exit_code, const QString &str_stderr, const QString &str_stdout){
+    QString msg;
+    msg = msg + QString("<font color='red'><strong>Python script failed.<br><br>%1<br>Returned code: %2").arg(name).arg(exit_code) + "</strong>";
+    msg = msg + "<font face='consolas'>";
+    msg = msg + "<br>" + QString(str_stderr).replace("\n", "<br>") + "</font></font>";
+    msg = msg + "<br>" + QString(str_stdout).replace("\n", "<br>");
+    if (showErrors){
+        RDK->ShowMessage(msg);
     } else {
-        qDebug() << "Running custom executable: " << filepath;
-        proc->start(filepath);
+        // output through debug: this may happen when we close RoboDK (show_errors is set to false as we kill all subprocesses)
+        qDebug() << msg;
     }
-    qDebug() << "Arguments: " << args;
+}
 
+// Triggered when a script run by a Python worker completes
+void AppLoader::onWorkerScriptFinished(const QString &filepath, int exit_code, const QString &output){
+    if (exit_code != 0){
+        // the output of the worker merges stdout and stderr
+        ShowScriptError("Python worker: " + filepath, exit_code, output, QString());
+    }
 }
 
 // Triggered when a script finished executing
@@ -1104,17 +1278,7 @@ void AppLoader::onScriptFinished(){
             script_path = proc->arguments()[0];
         }*/
         //QString msg("Error running script:<br>" + script_path + "<br>");
-        QString msg;
-        msg = msg + QString("<font color='red'><strong>Python script failed.<br><br>%1<br>Returned code: %2").arg(proc->objectName()).arg(proc->exitCode()) + "</strong>";
-        msg = msg + "<font face='consolas'>";
-        msg = msg + "<br>" + QString(proc->readAllStandardError()).replace("\n", "<br>") + "</font></font>";
-        msg = msg + "<br>" + QString(proc->readAllStandardOutput()).replace("\n", "<br>");
-        if (showErrors){
-            RDK->ShowMessage(msg);
-        } else {
-            // output through debug: this may happen when we close RoboDK (show_errors is set to false as we kill all subprocesses)
-            qDebug() << msg;
-        }
+        ShowScriptError(proc->objectName(), proc->exitCode(), QString(proc->readAllStandardError()), QString(proc->readAllStandardOutput()));
     }
 
     // Important! Delete the process
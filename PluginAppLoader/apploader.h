@@ -5,18 +5,25 @@
 #include <QObject>
 #include <QtPlugin>
 #include <QDockWidget>
+#include <QProcessEnvironment>
+#include <QHash>
 #include "iapprobodk.h"
 #include "robodktypes.h"
+#include "appmanifest.h"
 
 class QToolBar;
 class QMenu;
 class QAction;
 class QProcess;
+class QFileSystemWatcher;
+class QTimer;
 
 class IRoboDK;
 class IItem;
 
 class DialogAppList;
+class PythonWorkerPool;
+class AppDiscovery;
 
 class tAppMenu;
 
@@ -48,7 +55,8 @@ public:
         Priority(priority),
         ToolbarArea(area),
         SizeRatio(szratio),
-        Active(active)
+        Active(active),
+        ToolBar(nullptr)
     {
 
     }
@@ -58,6 +66,9 @@ public:
     int ToolbarArea;
     double SizeRatio;
     bool Active;
+
+    /// Toolbar shown in the main window (nullptr if not shown)
+    QToolBar *ToolBar;
 };
 
 /// Hold the information related to an App (menu) for sorting purposes
@@ -75,7 +86,9 @@ public:
         IniPath(inipath),
         Version(version),
         Priority(priority),
-        Toolbar(nullptr)
+        Toolbar(nullptr),
+        Menu(nullptr),
+        MenuSeparator(nullptr)
     {
     }
     bool Active;
@@ -89,6 +102,10 @@ public:
     double Priority;
     QList<QAction*> Actions;
     tAppToolbar *Toolbar;
+
+    /// Menu shown in the main menu or the parent menu (nullptr if not shown), and its separator in the parent menu
+    QMenu *Menu;
+    QAction *MenuSeparator;
 };
 
 
@@ -135,18 +152,63 @@ public:
     /// Look for apps in the Apps folder
     void AppsSearch(bool install_requirements=false);
 
+    /// Look for apps in the Apps folder in the background. Apps are added to the menus and toolbars as they are found.
+    void AppsSearchAsync(bool install_requirements=false);
+
+    /// Prepare a search (developer mode and list of enabled apps)
+    void AppsSearchBegin(bool install_requirements);
+
+    /// Create the menu, toolbar and actions of an app found by the search
+    tAppMenu *AppsAdd(const tAppManifest &manifest);
+
+    /// Complete a search (Python dependencies and PYTHONPATH)
+    void AppsSearchEnd();
+
+    /// Remove the menu, toolbar and actions of one app
+    void AppsRemove(tAppMenu *appMenu);
+
+    /// Read the apps again and rebuild only the apps that were added, removed or modified
+    void AppsUpdate();
+
+    /// Watch the Apps folders and the files of each app for changes
+    void AppsWatch();
+
+    /// Append the apps directories to RoboDK's PYTHONPATH
+    void AppsPythonPathAdd();
+
+    /// Remove the apps directories from RoboDK's PYTHONPATH
+    void AppsPythonPathRemove();
+
+    /// Install the Python requirements of an app (requirements.txt) if they are missing
+    void AppsInstallRequirements(const QString &dirApp, const QString &requirements);
+
     /// Retrieve all apps and load them in the main menu
     void AppsLoadMenus();
 
+    /// Load the menu of one app (at its place according to the priority)
+    void AppsLoadMenu(tAppMenu *appmenu);
+
     /// Reload the toolbar
     void AppsLoadToolbars();
 
+    /// Load the toolbar of one app (at its place according to the priority)
+    void AppsLoadToolbar(tAppToolbar *appToolbar);
+
     /// Remove all apps
     void AppsUnloadMenus();
 
     /// remove all toolbars
     void AppsUnloadToolbars();
 
+    /// Start (or restart) the pool of Python workers with the current PYTHONPATH (PythonWorkers setting)
+    void WorkersStart();
+
+    /// Environment used to run scripts (RoboDK's PYTHONPATH and API port)
+    QProcessEnvironment ScriptEnvironment();
+
+    /// Display the error of a script that failed
+    void ShowScriptError(const QString &name, int exit_code, const QString &str_stderr, const QString &str_stdout);
+
     /// Run Python code from Qt
     //bool RunPythonShell(const QString &python_exec, const QString &python_code);
 
@@ -181,6 +243,18 @@ public slots:
     /// Called when the script completes
     void onScriptFinished();
 
+    /// Called when the background search finds an app
+    void onAppFound(const tAppManifest &manifest);
+
+    /// Called when the background search is complete
+    void onAppsSearchFinished();
+
+    /// Called when a watched app file or folder changes (the apps are updated once the changes stop)
+    void onAppsChanged(const QString &path);
+
+    /// Called when a script run by a Python worker completes
+    void onWorkerScriptFinished(const QString &filepath, int exit_code, const QString &output);
+
     /// Called on app output (eg: print to stdout/default)
     void onScriptReadyRead();
 
@@ -197,6 +271,9 @@ private:
     /// Path to Local User Apps folder (usually C:/Users/<username>/AppData/Roaming/RoboDK/Apps/)
     QString PathUserApps;
 
+    /// Path to the index cache of the Apps found (binary file with the manifest of each App)
+    QString PathIndexCache;
+
     /// List of directories containing enabled Apps (including AppLinks) to add to PYTHONPATH. i.e. C:/RoboDK/Apps/MyApp -> C:/RoboDK/Apps, C:/RoboDK/Apps/MyApp/AppLink.ini -> C:/DirOfMyApp
     QStringList PypathAppsDirs;
 
@@ -227,6 +304,32 @@ private:
     /// List of processes to not kill
     QList<QProcess*> Process_SkipKill_List;
 
+    /// Pool of Python processes ready to run scripts (disabled if PythonWorkers is 0)
+    PythonWorkerPool *WorkerPool;
+
+    /// Number of Python workers (PythonWorkers setting)
+    int PythonWorkers;
+
+    /// Reads the apps in parallel
+    AppDiscovery *Discovery;
+
+    /// Toolbars are shown (RoboDK loaded the plugin toolbars)
+    bool ToolbarsLoaded;
+
+    /// Loaded apps and the manifest they were created from (the key is the app folder)
+    QHash<QString, tAppMenu*> AppMenus;
+    QHash<QString, tAppManifest> AppManifests;
+
+    /// Watches the apps for changes, and waits for the changes to stop before updating the apps
+    QFileSystemWatcher *Watcher;
+    QTimer *WatchTimer;
+
+    /// State of the current search
+    bool SearchDeveloperMode;
+    bool SearchInstallRequirements;
+    QStringList SearchEnabledApps;
+    QList<QPair<QString, QString> > SearchRequirements;
+
 signals:
     void stop_process();
 
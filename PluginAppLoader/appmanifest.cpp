@@ -0,0 +1,401 @@
+#include "appmanifest.h"
+
+#include "iitem.h"
+
+#include <QDataStream>
+#include <QSettings>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDateTime>
+#include <QSaveFile>
+#include <QVariant>
+#include <QDebug>
+
+
+// Identify the cache file and the version of its format
+static const quint32 CacheMagic = 0x41504C49; // APLI
+static const quint32 CacheVersion = 2;
+
+
+// Function to parse a string list of ITEM_TYPE
+static QList<int> ParseStringList(const QStringList& l){
+    QList<int> result;
+    for (const QString& s : l){
+        bool ok = false;
+        int value = s.trimmed().toInt(&ok);
+        if (ok) {
+            if (value == IItem::ITEM_TYPE_ANY) {
+                result.clear();
+                result.append(value);
+                break;
+            } else if (value > 0 && value < 50) {
+                result.append(value);
+            }
+        }
+    }
+    return result;
+}
+
+// Write a setting only if it is missing or different, so that the INI file (and its modification time) stays the same when nothing changed
+static void SettingsUpdate(QSettings &settings, const QString &key, const QVariant &value){
+    if (settings.contains(key)){
+        QVariant current = settings.value(key);
+        bool same = (value.type() == QVariant::StringList) ?
+                    (current.toStringList() == value.toStringList()) :
+                    (current.toString() == value.toString());
+        if (same){
+            return;
+        }
+    }
+    settings.setValue(key, value);
+}
+
+
+bool operator==(const tAppActionManifest &a, const tAppActionManifest &b){
+    return a.KeyName == b.KeyName && a.FileScript == b.FileScript && a.DisplayName == b.DisplayName && a.Description == b.Description
+            && a.Visible == b.Visible && a.DeveloperOnly == b.DeveloperOnly && a.Shortcut == b.Shortcut
+            && a.Checkable == b.Checkable && a.CheckableGroup == b.CheckableGroup
+            && a.AddToMenu == b.AddToMenu && a.AddToToolbar == b.AddToToolbar && a.Priority == b.Priority && a.RunInWorker == b.RunInWorker
+            && a.TypesShowOnContextMenu == b.TypesShowOnContextMenu && a.TypesDoubleClick == b.TypesDoubleClick
+            && a.IconFile == b.IconFile && a.IconFileChecked == b.IconFileChecked;
+}
+
+bool AppManifestSame(const tAppManifest &a, const tAppManifest &b){
+    return a.Path == b.Path && a.DirApp == b.DirApp && a.DirAppComplete == b.DirAppComplete && a.FileSettings == b.FileSettings && a.Global == b.Global
+            && a.MenuName == b.MenuName && a.MenuParent == b.MenuParent && a.Version == b.Version
+            && a.MenuPriority == b.MenuPriority && a.MenuVisible == b.MenuVisible && a.ToolbarArea == b.ToolbarArea && a.ToolbarSizeRatio == b.ToolbarSizeRatio
+            && a.RunCommands == b.RunCommands && a.HasInit == b.HasInit && a.Requirements == b.Requirements
+            && a.Actions == b.Actions;
+}
+
+
+QDataStream &operator<<(QDataStream &stream, const tAppActionManifest &action){
+    stream << action.KeyName << action.FileScript << action.DisplayName << action.Description
+           << action.Visible << action.DeveloperOnly << action.Shortcut
+           << action.Checkable << qint32(action.CheckableGroup)
+           << action.AddToMenu << action.AddToToolbar << action.Priority << action.RunInWorker
+           << action.TypesShowOnContextMenu << action.TypesDoubleClick
+           << action.IconFile << action.IconFileChecked;
+    return stream;
+}
+
+QDataStream &operator>>(QDataStream &stream, tAppActionManifest &action){
+    qint32 checkable_group;
+    stream >> action.KeyName >> action.FileScript >> action.DisplayName >> action.Description
+           >> action.Visible >> action.DeveloperOnly >> action.Shortcut
+           >> action.Checkable >> checkable_group
+           >> action.AddToMenu >> action.AddToToolbar >> action.Priority >> action.RunInWorker
+           >> action.TypesShowOnContextMenu >> action.TypesDoubleClick
+           >> action.IconFile >> action.IconFileChecked;
+    action.CheckableGroup = checkable_group;
+    return stream;
+}
+
+QDataStream &operator<<(QDataStream &stream, const tAppManifest &manifest){
+    stream << manifest.Path << manifest.DirApp << manifest.DirAppComplete << manifest.FileSettings << manifest.Global
+           << manifest.MenuName << manifest.MenuParent << manifest.Version
+           << manifest.MenuPriority << manifest.MenuVisible << qint32(manifest.ToolbarArea) << manifest.ToolbarSizeRatio
+           << manifest.RunCommands << manifest.HasInit << manifest.Requirements
+           << manifest.Actions << manifest.StampPaths << manifest.Stamps;
+    return stream;
+}
+
+QDataStream &operator>>(QDataStream &stream, tAppManifest &manifest){
+    qint32 toolbar_area;
+    stream >> manifest.Path >> manifest.DirApp >> manifest.DirAppComplete >> manifest.FileSettings >> manifest.Global
+           >> manifest.MenuName >> manifest.MenuParent >> manifest.Version
+           >> manifest.MenuPriority >> manifest.MenuVisible >> toolbar_area >> manifest.ToolbarSizeRatio
+           >> manifest.RunCommands >> manifest.HasInit >> manifest.Requirements
+           >> manifest.Actions >> manifest.StampPaths >> manifest.Stamps;
+    manifest.ToolbarArea = toolbar_area;
+    return stream;
+}
+
+
+QList<qint64> AppManifestStamps(const QStringList &paths){
+    QList<qint64> stamps;
+    for (const QString &path : paths){
+        QFileInfo info(path);
+        stamps.append(info.exists() ? info.lastModified().toMSecsSinceEpoch() : -1);
+    }
+    return stamps;
+}
+
+tAppManifest AppManifestParse(const QString &path, bool global){
+    tAppManifest manifest;
+    manifest.Global = global;
+
+    QString dirApp = QFileInfo(path).fileName();
+    QString dirAppComplete = path;
+    manifest.Path = path;
+    manifest.DirApp = dirApp;
+    manifest.StampPaths.append(path);
+
+    // Retrieve and/or create the INI file related to this app
+    QString fileSettings = dirAppComplete + "/AppConfig.ini";
+
+    // Check if the ini file exists, otherwise, try with the older Settings.ini file
+    bool fileExist = QFile::exists(fileSettings);
+    if (!fileExist){
+        fileSettings = dirAppComplete + "/Settings.ini";
+        fileExist = QFile::exists(fileSettings);
+        if (!fileExist){
+            // Check if we want to forward the app location to another folder (useful if we use GitHub)
+            QString fileLinkTo = dirAppComplete + "/AppLink.ini";
+            if (QFile::exists(fileLinkTo)){
+                manifest.StampPaths.append(fileLinkTo);
+                QSettings linksettings(fileLinkTo, QSettings::IniFormat);
+                QString pathLink = linksettings.value("Path", "").toString();
+                pathLink.replace("\\","/"); // Qt Docs: QSettings always treats backslash as a special character and provides no API for reading or writing such entries.
+                if (!pathLink.isEmpty()){
+                    QDir pathLinkDir(pathLink);
+                    if (pathLinkDir.exists()){
+                        dirAppComplete = pathLink;
+                        manifest.StampPaths.append(dirAppComplete);
+                        fileSettings = dirAppComplete + "/AppConfig.ini";
+                        qDebug() << "Linking app dir to: " << dirAppComplete;
+                        fileExist = QFile::exists(fileSettings);
+                        if (!fileExist){
+                            // Try with the older Settings.ini file
+                            fileSettings = dirAppComplete + "/Settings.ini";
+                            fileExist = QFile::exists(fileSettings);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    if (!fileExist){
+         fileSettings = dirAppComplete + "/AppConfig.ini"; // Use default INI file name
+    }
+    manifest.DirAppComplete = dirAppComplete;
+    manifest.FileSettings = fileSettings;
+
+    {
+        // Load settings and save them (default settings will be set)
+        QSettings settings(fileSettings, QSettings::IniFormat);
+        manifest.MenuName = settings.value("MenuName", dirApp).toString();
+        manifest.MenuParent = settings.value("MenuParent", "").toString();
+        manifest.Version = settings.value("Version", "1.0.0").toString();
+        manifest.MenuPriority = settings.value("MenuPriority", 50.0).toDouble();
+        manifest.MenuVisible = settings.value("MenuVisible", true).toBool();
+        manifest.ToolbarArea = settings.value("ToolbarArea", 2).toInt();
+        manifest.ToolbarSizeRatio = settings.value("ToolbarSizeRatio", 1.5).toDouble();
+        manifest.RunCommands = settings.value("RunCommands", QStringList()).toStringList();
+
+        SettingsUpdate(settings, "MenuName", manifest.MenuName);
+        SettingsUpdate(settings, "MenuParent", manifest.MenuParent);
+        SettingsUpdate(settings, "Version", manifest.Version);
+        SettingsUpdate(settings, "MenuPriority", manifest.MenuPriority);
+        SettingsUpdate(settings, "MenuVisible", manifest.MenuVisible);
+
+        // Remove obsoleted key
+        if (settings.contains("Enabled"))
+            settings.remove("Enabled");
+
+        SettingsUpdate(settings, "ToolbarArea", manifest.ToolbarArea);
+        SettingsUpdate(settings, "ToolbarSizeRatio", manifest.ToolbarSizeRatio);
+        SettingsUpdate(settings, "RunCommands", manifest.RunCommands);
+
+        // Get the list of files in the folder
+        QDir dirAppi(dirAppComplete);
+        QStringList filesApp(dirAppi.entryList(QDir::Files));
+
+        // Iterate through each App (folder)
+        foreach (QString file, filesApp){
+
+            if (file.compare("__init__.py", Qt::CaseSensitive) == 0){
+                manifest.HasInit = true;
+            }
+
+            // Files that starts with _ are skipped as they are 'internal' files
+            if (file.startsWith("_")){
+                continue;
+            }
+
+            if (file.compare("requirements.txt", Qt::CaseSensitive) == 0){
+                manifest.Requirements = dirAppComplete + "/" + file;
+            }
+
+            if (!file.endsWith(".py", Qt::CaseInsensitive) && !file.endsWith(".exe", Qt::CaseInsensitive)){
+                continue;
+            }
+
+            // Get the key name for the settings file
+            QString keyName(file);
+            if (file.endsWith(".py", Qt::CaseInsensitive)){
+                keyName.chop(3); // ends with PY
+            } else {
+                keyName.chop(4); // ends with EXE
+            }
+
+            QString name_guess(QString(keyName).replace("_"," "));
+
+            // Read settings from AppSettings if they exist, otherwise, set the default values
+            tAppActionManifest action;
+            action.KeyName = keyName;
+            action.FileScript = dirAppComplete + "/" + file;
+            action.DisplayName = settings.value(keyName + "/DisplayName", name_guess).toString();
+            action.Description = settings.value(keyName + "/Description", name_guess).toString();
+            action.Visible = settings.value(keyName + "/Visible", true).toBool();
+            action.DeveloperOnly = settings.value(keyName + "/DeveloperOnly", false).toBool();
+            action.Shortcut = settings.value(keyName + "/Shortcut", "").toString();
+            action.Checkable = settings.value(keyName + "/Checkable", false).toBool();
+            action.CheckableGroup = settings.value(keyName + "/CheckableGroup", -1).toInt();
+            action.AddToMenu = settings.value(keyName + "/AddToMenu", true).toBool();
+            action.AddToToolbar = settings.value(keyName + "/AddToToolbar", true).toBool();
+            action.Priority = settings.value(keyName + "/Priority", 50.0f).toDouble();
+            action.RunInWorker = settings.value(keyName + "/RunInWorker", true).toBool();
+            QStringList types_rightclick_str = settings.value(keyName + "/TypeOnContextMenu", QStringList("")).toStringList(); // Multiple item support. Format can be "TypeOnContextMenu=int" or "TypeOnContextMenu=int, int, .."
+            QStringList types_doubleclick_str = settings.value(keyName + "/TypeOnDoubleClick", QStringList("")).toStringList(); // Multiple item support. Format can be "TypeOnDoubleClick=int" or "TypeOnDoubleClick=int, int, .."
+
+            // Remove invalid inputs from string lists
+            action.TypesShowOnContextMenu = ParseStringList(types_rightclick_str);
+            action.TypesDoubleClick = ParseStringList(types_doubleclick_str);
+
+            // Prevent empty names
+            if (action.DisplayName.isEmpty()){
+                action.DisplayName = keyName;
+            }
+
+            // Save settings to AppSettings file to let the user change them if desired
+            SettingsUpdate(settings, keyName + "/DisplayName", action.DisplayName);
+            SettingsUpdate(settings, keyName + "/Description", action.Description);
+            SettingsUpdate(settings, keyName + "/Visible", action.Visible);
+            SettingsUpdate(settings, keyName + "/DeveloperOnly", action.DeveloperOnly);
+            SettingsUpdate(settings, keyName + "/Shortcut", action.Shortcut);
+            SettingsUpdate(settings, keyName + "/Checkable", action.Checkable);
+            SettingsUpdate(settings, keyName + "/CheckableGroup", action.CheckableGroup);
+            SettingsUpdate(settings, keyName + "/AddToMenu", action.AddToMenu);
+            SettingsUpdate(settings, keyName + "/AddToToolbar", action.AddToToolbar);
+            SettingsUpdate(settings, keyName + "/Priority", action.Priority);
+            SettingsUpdate(settings, keyName + "/RunInWorker", action.RunInWorker);
+            SettingsUpdate(settings, keyName + "/TypeOnContextMenu",  types_rightclick_str);
+            SettingsUpdate(settings, keyName + "/TypeOnDoubleClick",  types_doubleclick_str);
+
+            // try to find a matching image given the key name:
+            QString fileCompleteNoExt(dirAppComplete + "/" + keyName);
+            if (QFile::exists(fileCompleteNoExt + ".svg")){
+                action.IconFile = fileCompleteNoExt + ".svg";
+            } else if (QFile::exists(fileCompleteNoExt + ".png")){
+                action.IconFile = fileCompleteNoExt + ".png";
+            } else if (QFile::exists(fileCompleteNoExt + ".jpg")){
+                action.IconFile = fileCompleteNoExt + ".jpg";
+            } else if (QFile::exists(fileCompleteNoExt + ".ico")){
+                action.IconFile = fileCompleteNoExt + ".ico";
+            }
+
+            // add icon active
+            if (action.Checkable && action.IconFile.length() > 4){
+                QString iconfile_checked = QString(action.IconFile).insert(action.IconFile.length()-4,"Checked");
+                if (QFile::exists(iconfile_checked)){
+                    action.IconFileChecked = iconfile_checked;
+                }
+            }
+
+            manifest.Actions.append(action);
+        }
+
+        // Write the INI file now (if anything changed) so that the modification time includes our changes
+        settings.sync();
+    }
+
+    manifest.StampPaths.append(fileSettings);
+    manifest.Stamps = AppManifestStamps(manifest.StampPaths);
+    return manifest;
+}
+
+
+AppManifestCache::AppManifestCache(const QString &filepath):
+    FilePath(filepath),
+    Modified(false)
+{
+}
+
+bool AppManifestCache::Load(){
+    Manifests.clear();
+    Modified = false;
+
+    QFile file(FilePath);
+    if (!file.open(QIODevice::ReadOnly)){
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_6);
+    quint32 magic = 0;
+    quint32 version = 0;
+    stream >> magic >> version;
+    if (magic != CacheMagic || version != CacheVersion){
+        qDebug() << "Ignoring App index cache with a different format: " << FilePath;
+        return false;
+    }
+
+    stream >> Manifests;
+    if (stream.status() != QDataStream::Ok){
+        qDebug() << "Invalid App index cache: " << FilePath;
+        Manifests.clear();
+        return false;
+    }
+    return true;
+}
+
+bool AppManifestCache::Save(){
+    if (!Modified){
+        return true;
+    }
+
+    QDir().mkpath(QFileInfo(FilePath).absolutePath());
+    QSaveFile file(FilePath);
+    if (!file.open(QIODevice::WriteOnly)){
+        qDebug() << "Unable to save App index cache: " << FilePath;
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_6);
+    stream << CacheMagic << CacheVersion << Manifests;
+    if (!file.commit()){
+        qDebug() << "Unable to save App index cache: " << FilePath;
+        return false;
+    }
+    Modified = false;
+    return true;
+}
+
+void AppManifestCache::Clear(){
+    Modified = Modified || !Manifests.isEmpty();
+    Manifests.clear();
+}
+
+bool AppManifestCache::Find(const QString &path, tAppManifest &manifest) const {
+    auto it = Manifests.constFind(path);
+    if (it == Manifests.constEnd()){
+        return false;
+    }
+
+    // Any change in the App folder (files added or removed), the link or the INI file requires reading the App again
+    if (AppManifestStamps(it->StampPaths) != it->Stamps){
+        return false;
+    }
+    manifest = it.value();
+    return true;
+}
+
+void AppManifestCache::Insert(const QString &path, const tAppManifest &manifest){
+    Manifests.insert(path, manifest);
+    Modified = true;
+}
+
+void AppManifestCache::Retain(const QStringList &paths){
+    for (auto it = Manifests.begin(); it != Manifests.end();){
+        if (!paths.contains(it.key())){
+            it = Manifests.erase(it);
+            Modified = true;
+        } else {
+            ++it;
+        }
+    }
+}
@@ -0,0 +1,149 @@
+#ifndef APPMANIFEST_H
+#define APPMANIFEST_H
+
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QHash>
+#include <QMetaType>
+
+class QDataStream;
+
+
+/// Settings of an action (script or executable) of an App, as found in the AppConfig.ini file
+class tAppActionManifest {
+public:
+    tAppActionManifest():
+        Visible(true),
+        DeveloperOnly(false),
+        Checkable(false),
+        CheckableGroup(-1),
+        AddToMenu(true),
+        AddToToolbar(true),
+        Priority(50.0),
+        RunInWorker(true)
+    {
+    }
+    QString KeyName;
+    QString FileScript;
+    QString DisplayName;
+    QString Description;
+    bool Visible;
+    bool DeveloperOnly;
+    QString Shortcut;
+    bool Checkable;
+    int CheckableGroup;
+    bool AddToMenu;
+    bool AddToToolbar;
+    double Priority;
+    bool RunInWorker;
+    QList<int> TypesShowOnContextMenu;
+    QList<int> TypesDoubleClick;
+    QString IconFile;
+    QString IconFileChecked;
+};
+
+/// Everything AppLoader needs to know about an App folder to create its menu, toolbar and actions
+class tAppManifest {
+public:
+    tAppManifest():
+        Global(false),
+        MenuPriority(50.0),
+        MenuVisible(true),
+        ToolbarArea(2),
+        ToolbarSizeRatio(1.5),
+        HasInit(false)
+    {
+    }
+    /// Folder inside the Apps folder (key of the App)
+    QString Path;
+
+    /// Name of the folder inside the Apps folder
+    QString DirApp;
+
+    /// Folder with the scripts (different from the App folder if there is an AppLink.ini)
+    QString DirAppComplete;
+
+    /// INI file with the settings of the App
+    QString FileSettings;
+
+    bool Global;
+    QString MenuName;
+    QString MenuParent;
+    QString Version;
+    double MenuPriority;
+    bool MenuVisible;
+    int ToolbarArea;
+    double ToolbarSizeRatio;
+    QStringList RunCommands;
+
+    /// The App folder has an __init__.py file (it can be imported from other scripts)
+    bool HasInit;
+
+    /// Path to the requirements.txt file (empty if none)
+    QString Requirements;
+
+    /// Actions in the order of the files in the folder
+    QList<tAppActionManifest> Actions;
+
+    /// Files and folders the manifest was built from, and their modification time (ms since epoch, -1 if they do not exist)
+    QStringList StampPaths;
+    QList<qint64> Stamps;
+};
+
+Q_DECLARE_METATYPE(tAppManifest)
+
+/// Returns true if both actions have the same settings
+bool operator==(const tAppActionManifest &a, const tAppActionManifest &b);
+
+/// Returns true if both manifests give the same menu, toolbar and actions (the modification times are ignored)
+bool AppManifestSame(const tAppManifest &a, const tAppManifest &b);
+
+QDataStream &operator<<(QDataStream &stream, const tAppActionManifest &action);
+QDataStream &operator>>(QDataStream &stream, tAppActionManifest &action);
+QDataStream &operator<<(QDataStream &stream, const tAppManifest &manifest);
+QDataStream &operator>>(QDataStream &stream, tAppManifest &manifest);
+
+
+/// Read the App found in the folder path (the INI file is created or completed with the default values if needed)
+tAppManifest AppManifestParse(const QString &path, bool global);
+
+/// Modification time of each file or folder (ms since epoch, -1 if it does not exist)
+QList<qint64> AppManifestStamps(const QStringList &paths);
+
+
+///
+/// \brief The AppManifestCache class keeps the manifests of the Apps in a binary file so that only the Apps that changed are read again.
+/// A manifest is valid as long as the modification time of the App folder, the INI file and the linked folder (AppLink.ini) did not change.
+///
+class AppManifestCache
+{
+public:
+    explicit AppManifestCache(const QString &filepath);
+
+    /// Load the cache file. Returns false if the file does not exist or is not valid (the cache is empty).
+    bool Load();
+
+    /// Save the cache file if it changed
+    bool Save();
+
+    /// Remove all manifests
+    void Clear();
+
+    /// Retrieve the manifest of an App folder. Returns false if there is no valid manifest.
+    bool Find(const QString &path, tAppManifest &manifest) const;
+
+    /// Add or replace the manifest of an App folder
+    void Insert(const QString &path, const tAppManifest &manifest);
+
+    /// Remove the manifests of the App folders that are not in the list
+    void Retain(const QStringList &paths);
+
+private:
+    QString FilePath;
+    QHash<QString, tAppManifest> Manifests;
+    bool Modified;
+};
+
+#endif // APPMANIFEST_H
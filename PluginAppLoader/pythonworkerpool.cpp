@@ -0,0 +1,260 @@
+#include "pythonworkerpool.h"
+
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QTimer>
+#include <QDebug>
+
+
+// Markers written by the worker on its standard output
+static const char *MarkerReady = "@@APPWORKER READY";
+static const char *MarkerDone = "@@APPWORKER DONE ";
+
+// Python code run by each worker: import the modules given as arguments, connect to RoboDK and run the scripts received through stdin.
+// The modules imported by a script are removed once it finishes, so the next script imports its own modules (and their latest version).
+static const char *WorkerCode =
+        "import sys, os, json, runpy, importlib, traceback\n"
+        "for module in sys.argv[1:]:\n"
+        "    try:\n"
+        "        importlib.import_module(module)\n"
+        "    except ImportError:\n"
+        "        pass\n"
+        "try:\n"
+        "    from robodk import robolink\n"
+        "    RDK = robolink.Robolink()\n"
+        "except Exception:\n"
+        "    traceback.print_exc()\n"
+        "preloaded = set(sys.modules)\n"
+        "sys.stdout.write('@@APPWORKER READY\\n')\n"
+        "sys.stdout.flush()\n"
+        "while True:\n"
+        "    line = sys.stdin.readline()\n"
+        "    if not line:\n"
+        "        break\n"
+        "    job = json.loads(line)\n"
+        "    code = 0\n"
+        "    cwd = os.getcwd()\n"
+        "    path = list(sys.path)\n"
+        "    sys.argv = [job['script']] + job['args']\n"
+        "    sys.path.insert(0, os.path.dirname(job['script']))\n"
+        "    try:\n"
+        "        runpy.run_path(job['script'], run_name='__main__')\n"
+        "    except SystemExit as e:\n"
+        "        if e.code is None or isinstance(e.code, int):\n"
+        "            code = e.code or 0\n"
+        "        else:\n"
+        "            print(e.code, file=sys.stderr)\n"
+        "            code = 1\n"
+        "    except BaseException:\n"
+        "        traceback.print_exc()\n"
+        "        code = 1\n"
+        "    sys.path[:] = path\n"
+        "    for module in set(sys.modules) - preloaded:\n"
+        "        sys.modules.pop(module, None)\n"
+        "    os.chdir(cwd)\n"
+        "    sys.stderr.flush()\n"
+        "    sys.stdout.write('@@APPWORKER DONE %d %d\\n' % (job['id'], code))\n"
+        "    sys.stdout.flush()\n";
+
+
+PythonWorkerPool::PythonWorkerPool(QObject *parent) : QObject(parent),
+    NextJobId(0),
+    Stopping(false)
+{
+}
+
+PythonWorkerPool::~PythonWorkerPool(){
+    Stop();
+}
+
+void PythonWorkerPool::Start(int count, const QString &python_exec, const QProcessEnvironment &env, const QStringList &imports){
+    if (count == Workers.length() && python_exec == PythonExec && env == Environment && imports == Imports){
+        // already running with the same settings
+        return;
+    }
+    Stop();
+    PythonExec = python_exec;
+    Environment = env;
+    Imports = imports;
+    Stopping = false;
+    for (int i=0; i<count; i++){
+        Workers.append(tPythonWorker());
+        StartWorker(i);
+    }
+    if (count > 0){
+        qDebug() << "Starting" << count << "Python workers";
+    }
+}
+
+void PythonWorkerPool::Stop(){
+    Stopping = true;
+    for (tPythonWorker &worker : Workers){
+        if (worker.Process != nullptr){
+            disconnect(worker.Process, nullptr, this, nullptr);
+            worker.Process->kill();
+            worker.Process->waitForFinished(1000);
+            worker.Process->deleteLater();
+            worker.Process = nullptr;
+        }
+    }
+    Workers.clear();
+}
+
+int PythonWorkerPool::Count() const {
+    return Workers.length();
+}
+
+bool PythonWorkerPool::Run(const QString &filepath, const QStringList &args){
+    for (tPythonWorker &worker : Workers){
+        if (worker.Process == nullptr || !worker.Ready || worker.JobId >= 0){
+            continue;
+        }
+
+        QJsonObject job;
+        job.insert("id", NextJobId);
+        job.insert("script", filepath);
+        job.insert("args", QJsonArray::fromStringList(args));
+        QByteArray line = QJsonDocument(job).toJson(QJsonDocument::Compact) + "\n";
+        if (worker.Process->write(line) != line.length()){
+            continue;
+        }
+
+        worker.JobId = NextJobId++;
+        worker.Script = filepath;
+        worker.Output.clear();
+        qDebug() << "Running script in Python worker: " << filepath;
+        return true;
+    }
+    return false;
+}
+
+void PythonWorkerPool::Abort(){
+    for (tPythonWorker &worker : Workers){
+        if (worker.Process != nullptr && worker.JobId >= 0){
+            qDebug() << "Stopping Python worker running: " << worker.Script;
+            worker.Process->kill();
+        }
+    }
+}
+
+void PythonWorkerPool::StartWorker(int index){
+    tPythonWorker &worker = Workers[index];
+    worker.Ready = false;
+    worker.JobId = -1;
+    worker.Pending.clear();
+    worker.Output.clear();
+
+    QProcess *process = new QProcess(this);
+    process->setObjectName(QString("Python worker %1").arg(index));
+    process->setProcessChannelMode(QProcess::MergedChannels);
+    process->setProcessEnvironment(Environment);
+    connect(process, &QProcess::readyReadStandardOutput, this, &PythonWorkerPool::onReadyRead);
+    connect(process, static_cast<void(QProcess::*)(int, QProcess::ExitStatus)>(&QProcess::finished), this, &PythonWorkerPool::onFinished);
+    worker.Process = process;
+    worker.Started.start();
+
+    QStringList args;
+    args << "-u" << "-c" << WorkerCode << Imports;
+    process->start(PythonExec, args);
+}
+
+int PythonWorkerPool::WorkerIndex(QObject *process) const {
+    for (int i=0; i<Workers.length(); i++){
+        if (Workers[i].Process == process){
+            return i;
+        }
+    }
+    return -1;
+}
+
+void PythonWorkerPool::FinishJob(tPythonWorker &worker, int exit_code){
+    QString script = worker.Script;
+    QString output = QString::fromUtf8(worker.Output);
+    worker.JobId = -1;
+    worker.Script.clear();
+    worker.Output.clear();
+    qDebug().noquote() << "Script finished with exit code: " << exit_code << "-> Python worker: " << script;
+    emit ScriptFinished(script, exit_code, output);
+}
+
+void PythonWorkerPool::onReadyRead(){
+    int index = WorkerIndex(QObject::sender());
+    if (index < 0){
+        return;
+    }
+    tPythonWorker &worker = Workers[index];
+    worker.Pending.append(worker.Process->readAllStandardOutput());
+
+    // Process complete lines only
+    int end;
+    while ((end = worker.Pending.indexOf('\n')) >= 0){
+        QByteArray line = worker.Pending.left(end + 1);
+        worker.Pending.remove(0, end + 1);
+
+        // The markers follow the output of the script, which may not end with a new line
+        int ready = line.indexOf(MarkerReady);
+        int done = line.indexOf(MarkerDone);
+        int marker = ready >= 0 ? ready : done;
+        if (marker > 0){
+            worker.Output.append(line.left(marker));
+            qDebug().noquote() << line.left(marker).trimmed();
+        }
+
+        if (ready >= 0){
+            worker.Ready = true;
+            worker.Failures = 0;
+            qDebug() << "Python worker ready in" << worker.Started.elapsed() << "ms";
+        } else if (done >= 0){
+            QList<QByteArray> fields = line.mid(done + int(strlen(MarkerDone))).trimmed().split(' ');
+            int job_id = fields[0].toInt();
+            int exit_code = fields.length() > 1 ? fields[1].toInt() : 0;
+            if (worker.JobId >= 0 && job_id == worker.JobId){
+                FinishJob(worker, exit_code);
+            } else {
+                qDebug() << "Python worker finished an unknown job:" << job_id;
+            }
+        } else {
+            worker.Output.append(line);
+            qDebug().noquote() << line.trimmed();
+        }
+    }
+}
+
+void PythonWorkerPool::onFinished(int exit_code, QProcess::ExitStatus exit_status){
+    int index = WorkerIndex(QObject::sender());
+    if (index < 0){
+        return;
+    }
+    tPythonWorker &worker = Workers[index];
+    worker.Output.append(worker.Pending);
+    worker.Pending.clear();
+    qDebug() << "Python worker stopped with exit code" << exit_code << (exit_status == QProcess::CrashExit ? "(crash)" : "");
+
+    // Report the script that was running as failed
+    if (worker.JobId >= 0){
+        FinishJob(worker, exit_code != 0 ? exit_code : -1);
+    }
+
+    bool never_ready = !worker.Ready;
+    worker.Process->deleteLater();
+    worker.Process = nullptr;
+    worker.Ready = false;
+    if (Stopping){
+        return;
+    }
+
+    // Start the worker again, unless it keeps failing before it is ready
+    if (never_ready){
+        worker.Failures++;
+    }
+    if (worker.Failures >= MaxFailures){
+        qDebug() << "Python worker failed to start" << worker.Failures << "times. Scripts will run in their own process";
+        return;
+    }
+    QTimer::singleShot(never_ready ? 1000 : 0, this, [this, index](){
+        if (!Stopping && index < Workers.length() && Workers[index].Process == nullptr){
+            StartWorker(index);
+        }
+    });
+}
@@ -0,0 +1,93 @@
+#ifndef PYTHONWORKERPOOL_H
+#define PYTHONWORKERPOOL_H
+
+
+#include <QObject>
+#include <QProcess>
+#include <QProcessEnvironment>
+#include <QElapsedTimer>
+#include <QList>
+#include <QStringList>
+
+
+/// Hold the state of a Python worker process
+class tPythonWorker {
+public:
+    tPythonWorker():
+        Process(nullptr),
+        Ready(false),
+        JobId(-1),
+        Failures(0)
+    {
+    }
+    QProcess *Process;
+    bool Ready;
+    int JobId;
+    QString Script;
+    QByteArray Output;
+    QByteArray Pending;
+    int Failures;
+    QElapsedTimer Started;
+};
+
+
+///
+/// \brief The PythonWorkerPool class keeps Python processes running with the robodk modules imported and a connected Robolink.
+/// Scripts are sent to an idle worker through its standard input (one JSON line per script) and run with runpy as if they were the main script.
+/// A worker that dies (crash or kill) is started again, so a script can only take down its own worker.
+///
+class PythonWorkerPool : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PythonWorkerPool(QObject *parent = nullptr);
+    ~PythonWorkerPool();
+
+    /// Start count workers that import the given modules (previous workers are stopped). Nothing is done if the workers already run with the same settings.
+    void Start(int count, const QString &python_exec, const QProcessEnvironment &env, const QStringList &imports=QStringList());
+
+    /// Stop all workers
+    void Stop();
+
+    /// Number of workers
+    int Count() const;
+
+    /// Run a script in an idle worker. Returns false if no worker is ready (the caller should start its own process).
+    bool Run(const QString &filepath, const QStringList &args);
+
+public slots:
+    /// Kill the workers running a script (they are started again)
+    void Abort();
+
+signals:
+    /// Emitted when a script completes. The output contains the standard output and the standard error of the script.
+    void ScriptFinished(const QString &filepath, int exit_code, const QString &output);
+
+private slots:
+    void onReadyRead();
+    void onFinished(int exit_code, QProcess::ExitStatus exit_status);
+
+private:
+    /// Start (or start again) a worker
+    void StartWorker(int index);
+
+    /// Index of the worker of a process (-1 if not found)
+    int WorkerIndex(QObject *process) const;
+
+    /// Complete the script of a worker
+    void FinishJob(tPythonWorker &worker, int exit_code);
+
+private:
+    /// Number of consecutive failures after which a worker is no longer started again
+    static const int MaxFailures = 3;
+
+    QList<tPythonWorker> Workers;
+    QString PythonExec;
+    QProcessEnvironment Environment;
+    QStringList Imports;
+    int NextJobId;
+    bool Stopping;
+};
+
+#endif // PYTHONWORKERPOOL_H
@@ -10,6 +10,8 @@
 #include <QDesktopServices>
 #include <QInputDialog>
 #include <QMessageBox>
+#include <QHash>
+#include <QSet>
 
 #include "pluginattachobject.h"
 
@@ -64,6 +66,8 @@ void PluginAttachObject::PluginUnload() {
     qDebug() << "Unloading plugin " << PluginName();
 
     attached_objects.clear();
+    update_groups.clear();
+    update_groups_dirty = true;
     last_clicked_items.clear();
 
     if (nullptr != action_robot_select_attach) {
@@ -190,6 +194,7 @@ QString PluginAttachObject::PluginCommand(const QString &command, const QString
     qDebug() << "Received command: " << command << "    with value: " << value;
 
     // Expected format: "Attach", "Joint|Robot|Object". Attaches Object to Robot at Joint
+    //                  "Attach", "0|Parent object|Object". Attaches Object to another object (such as a fixture)
     //                  "Detach", "Object". Detach Object from any Robot
     //                  "Detach", "Robot". Detach all Objects from Robot
     //
@@ -420,25 +425,33 @@ void PluginAttachObject::callback_object_select_attach_multi() {
         return;
     }
 
-    // Get a list of robots to show the user
+    // Get a list of robots and objects to show the user (objects can be attached to fixtures)
     QList<Item> list_robots = RDK->getItemList(IItem::ITEM_TYPE_ROBOT);
+    for (const auto &object : RDK->getItemList(IItem::ITEM_TYPE_OBJECT)) {
+        if (!last_clicked_items.contains(object)) {
+            list_robots.append(object);
+        }
+    }
     if (list_robots.empty()) {
         StatusBar->showMessage("Could not find any parent to attach to.");
         return;
     }
 
     // Prompt user for robot to attach to
-    Item robot = RDK->ItemUserPick("Select a robot to attach selected object(s) to.", list_robots);
+    Item robot = RDK->ItemUserPick("Select a robot or an object to attach selected object(s) to.", list_robots);
     if (robot == nullptr) {
         return;
     }
 
     // Prompt user for the target joint
-    bool success = false;
-    int dof = robot->Joints().Length();
-    int joint_id = QInputDialog::getInt(this->MainWindow, "Enter the joint ID", "Enter the joint ID you would like to attach the selected object(s) to (id 3 means joint 3)", dof, 1, dof, 1, &success);
-    if (!success) {
-        return;
+    int joint_id = 0;
+    if (robot->Type() != IItem::ITEM_TYPE_OBJECT) {
+        bool success = false;
+        int dof = robot->Joints().Length();
+        joint_id = QInputDialog::getInt(this->MainWindow, "Enter the joint ID", "Enter the joint ID you would like to attach the selected object(s) to (id 3 means joint 3)", dof, 1, dof, 1, &success);
+        if (!success) {
+            return;
+        }
     }
 
     // Attach the object(s) to the robot
@@ -488,7 +501,9 @@ QList<Item> PluginAttachObject::attachedObjects(Item parent) {
 }
 
 void PluginAttachObject::attachObjects(Item robot, const QList<Item> &objects, int joint) {
-    if (nullptr == robot || objects.empty() || joint < 1) {
+    // The joint is ignored when attaching to another object
+    bool object_parent = (nullptr != robot) && (robot->Type() == IItem::ITEM_TYPE_OBJECT);
+    if (nullptr == robot || objects.empty() || (joint < 1 && !object_parent)) {
         return;
     }
 
@@ -498,6 +513,12 @@ void PluginAttachObject::attachObjects(Item robot, const QList<Item> &objects, i
             continue;
         }
 
+        // Attachments must not form a cycle: the object can't be the parent or one of its ancestors
+        if (object_parent && isAncestor(object, robot)) {
+            qDebug() << "Unable to attach " << object->Name() << " to " << robot->Name() << ": cyclic attachment";
+            continue;
+        }
+
         attached_object_t attached_object;
         attached_object.joint_id = joint;
         attached_object.parent = robot;
@@ -505,6 +526,7 @@ void PluginAttachObject::attachObjects(Item robot, const QList<Item> &objects, i
         attached_object.station = RDK->getActiveStation();
         attached_object.pose = getCustomPose(robot, joint).inv() * object->PoseAbs();
         attached_objects.append(attached_object);
+        update_groups_dirty = true;
         qDebug() << "Attached " + attached_object.toString();
     }
 }
@@ -525,6 +547,7 @@ void PluginAttachObject::detachObjects(Item robot, const QList<Item> &objects) {
         if (objects.contains(attached_object.object)) {
             qDebug() << "Detaching " + attached_object.toString();
             it = attached_objects.erase(it);
+            update_groups_dirty = true;
             continue;
         }
         ++it;
@@ -546,6 +569,7 @@ void PluginAttachObject::detachObjectsAll(Item robot) {
 
         qDebug() << "Detaching " + attached_object.toString();
         it = attached_objects.erase(it);
+        update_groups_dirty = true;
     }
 }
 
@@ -564,6 +588,7 @@ void PluginAttachObject::detachRobotsAll(Item object) {
 
         qDebug() << "Detaching " + attached_object.toString();
         it = attached_objects.erase(it);
+        update_groups_dirty = true;
     }
 }
 
@@ -597,10 +622,15 @@ Item PluginAttachObject::validItem(Item item) {
 }
 
 Mat PluginAttachObject::getCustomPose(Item item, int joint_id) {
-    QList<Mat> poses = item->JointPoses(item->Joints());
-    joint_id = qBound(0, joint_id, poses.length() - 1);
-    Mat pose = poses[joint_id];
-    return item->PoseAbs() * pose;
+    if (item->Type() == IItem::ITEM_TYPE_OBJECT) {
+        return item->PoseAbs();
+    }
+    return linkPose(item->PoseAbs(), item->JointPoses(item->Joints()), joint_id);
+}
+
+Mat PluginAttachObject::linkPose(const Mat &parent_pose, const QList<Mat> &joint_poses, int joint_id) {
+    joint_id = qBound(0, joint_id, joint_poses.length() - 1);
+    return parent_pose * joint_poses[joint_id];
 }
 
 void PluginAttachObject::updatePoses(bool check_station) {
@@ -608,11 +638,36 @@ void PluginAttachObject::updatePoses(bool check_station) {
         return;
     }
 
-    // Update all objects
+    if (update_groups_dirty) {
+        sortAttachments();
+    }
+
+    // Single pass in topological order: objects attached to other objects reuse the pose calculated in this pass
     Item station = RDK->getActiveStation();
-    for (const auto &attached_object : attached_objects) {
-        if (!check_station || (attached_object.station == station)) {
-            attached_object.object->setPoseAbs(getCustomPose(attached_object.parent, attached_object.joint_id) * attached_object.pose);
+    QHash<Item, Mat> updated_poses;
+    for (const auto &group : update_groups) {
+        if (check_station && (group.station != station)) {
+            continue;
+        }
+
+        // Calculate the link poses once per parent, then update all its objects
+        bool object_parent = group.parent->Type() == IItem::ITEM_TYPE_OBJECT;
+        QList<Mat> joint_poses;
+        Mat parent_pose;
+        if (!object_parent) {
+            joint_poses = group.parent->JointPoses(group.parent->Joints());
+            parent_pose = group.parent->PoseAbs();
+        } else if (updated_poses.contains(group.parent)) {
+            parent_pose = updated_poses.value(group.parent);
+        } else {
+            parent_pose = group.parent->PoseAbs();
+        }
+
+        for (int index : group.objects) {
+            const attached_object_t &attached_object = attached_objects[index];
+            Mat pose = (object_parent ? parent_pose : linkPose(parent_pose, joint_poses, attached_object.joint_id)) * attached_object.pose;
+            attached_object.object->setPoseAbs(pose);
+            updated_poses.insert(attached_object.object, pose);
         }
     }
 
@@ -623,6 +678,73 @@ void PluginAttachObject::updatePoses(bool check_station) {
     }
 }
 
+bool PluginAttachObject::isAncestor(Item item, Item object) {
+    // Each object is attached once: follow the parents up to a robot or a free object
+    QSet<Item> visited;
+    while (object != nullptr && !visited.contains(object)) {
+        if (object == item) {
+            return true;
+        }
+        visited.insert(object);
+
+        Item parent = nullptr;
+        for (const auto &attached_object : attached_objects) {
+            if (attached_object.object == object) {
+                parent = attached_object.parent;
+                break;
+            }
+        }
+        object = parent;
+    }
+    return false;
+}
+
+void PluginAttachObject::sortAttachments() {
+    update_groups.clear();
+    update_groups_dirty = false;
+
+    // Group the objects by parent (robot, turntable, object, etc.)
+    QHash<Item, int> group_index;
+    QSet<Item> attached;
+    for (int i = 0; i < attached_objects.size(); i++) {
+        const attached_object_t &attached_object = attached_objects[i];
+        attached.insert(attached_object.object);
+        auto it = group_index.find(attached_object.parent);
+        if (it == group_index.end()) {
+            attached_group_t group;
+            group.parent = attached_object.parent;
+            group.station = attached_object.station;
+            it = group_index.insert(attached_object.parent, update_groups.size());
+            update_groups.append(group);
+        }
+        update_groups[it.value()].objects.append(i);
+    }
+
+    // Topological order (Kahn): start from the parents that are not attached, then the groups of the objects just placed
+    QVector<attached_group_t> sorted;
+    sorted.reserve(update_groups.size());
+    for (const auto &group : update_groups) {
+        if (!attached.contains(group.parent)) {
+            sorted.append(group);
+        }
+    }
+    for (int i = 0; i < sorted.size(); i++) {
+        const QVector<int> objects = sorted[i].objects;
+        for (int index : objects) {
+            auto it = group_index.constFind(attached_objects[index].object);
+            if (it != group_index.constEnd()) {
+                sorted.append(update_groups[it.value()]);
+            }
+        }
+    }
+
+    // Remaining groups are part of a cycle and are not updated
+    if (sorted.size() != update_groups.size()) {
+        qDebug() << "Cyclic attachments detected: " << (update_groups.size() - sorted.size()) << " parent(s) ignored";
+    }
+    update_groups = sorted;
+}
+
 void PluginAttachObject::cleanupRemovedItems() {
     if (attached_objects.empty()){
         return;
@@ -637,6 +759,7 @@ void PluginAttachObject::cleanupRemovedItems() {
         if (!stations.contains(attached_object.station)) {
             qDebug() << "Station closed. Removing affected items.";
             it = attached_objects.erase(it);
+            update_groups_dirty = true;
             continue;
         }
 
@@ -646,11 +769,13 @@ void PluginAttachObject::cleanupRemovedItems() {
             if (!RDK->Valid(attached_object.parent)) {
                 qDebug() << "Robot deleted. Removing affected items.";
                 it = attached_objects.erase(it);
+                update_groups_dirty = true;
                 continue;
             }
             if (!RDK->Valid(attached_object.object)) {
                 qDebug() << "Object deleted. Removing affected items.";
                 it = attached_objects.erase(it);
+                update_groups_dirty = true;
                 continue;
             }
         }
@@ -151,12 +151,21 @@ public:
     /// Get the pose of the moving frame we want
     Mat getCustomPose(Item item, int joint_id);
 
+    /// Get the pose of the moving frame we want, given the absolute pose and the link poses of the parent
+    static Mat linkPose(const Mat &parent_pose, const QList<Mat> &joint_poses, int joint_id);
+
     /// Update object poses
     void updatePoses(bool check_station = true);
 
     /// Clean up removed items and stations
     void cleanupRemovedItems();
 
+    /// Checks if an item is an object or one of the parents it is attached to (directly or through other objects)
+    bool isAncestor(Item item, Item object);
+
+    /// Sort the attachments in topological order (parents before children)
+    void sortAttachments();
+
 
     // define your actions: usually, one action per button
 private:
@@ -191,6 +200,20 @@ private:
     /// Vector of all available attached objects
     QVector<attached_object_t> attached_objects;
 
+    /// Objects attached to the same parent
+    struct attached_group_t
+    {
+        Item parent { nullptr }; // Parent shared by the objects (robot or object)
+        Item station { nullptr }; // Station holding the parent/objects
+        QVector<int> objects; // Index of the objects in attached_objects
+    };
+
+    /// Groups of attached objects in topological order: an object is updated before the objects attached to it
+    QVector<attached_group_t> update_groups;
+
+    /// True if the groups must be sorted again (objects attached or detached)
+    bool update_groups_dirty { true };
+
     /// Last clicked items, items to process
     QList<Item> last_clicked_items;
 
@@ -10,6 +10,7 @@
 #include <QDesktopServices>
 #include <QInputDialog>
 #include <QList>
+#include <QtMath>
 
 #include "pluginattachview.h"
 
@@ -25,6 +26,58 @@ static Mat vp_2_camabs(Mat vp){
     return camabs_2_vp(vp).inv();
 }
 
+// Follow camera: the anchor motion is ignored after a longer pause (s)
+static const double MAX_FOLLOW_STEP = 0.5;
+
+// Follow camera: weight of the new velocity measurement in the filtered velocity
+static const float VELOCITY_FILTER = 0.5f;
+
+// Rotation of a pose as a quaternion
+static QQuaternion poseRotation(const Mat &pose){
+    float values[9];
+    for (int r = 0; r < 3; r++){
+        for (int c = 0; c < 3; c++){
+            values[r * 3 + c] = pose.Get(r, c);
+        }
+    }
+    return QQuaternion::fromRotationMatrix(QMatrix3x3(values));
+}
+
+// Pose from a rotation and a translation
+static Mat quaternionPose(const QQuaternion &rotation, const QVector3D &position){
+    QMatrix4x4 pose;
+    pose.translate(position);
+    pose.rotate(rotation);
+    return Mat(pose);
+}
+
+// Angle between two rotations (deg)
+static double rotationDistance(const QQuaternion &q1, const QQuaternion &q2){
+    double dot = qMin(1.0, static_cast<double>(qAbs(QQuaternion::dotProduct(q1, q2))));
+    return qRadiansToDegrees(2.0 * qAcos(dot));
+}
+
+// Rotation vector (axis times angle in deg, absolute coordinates) that rotates q1 to q2 along the shortest path
+static QVector3D rotationVector(const QQuaternion &q1, const QQuaternion &q2){
+    QQuaternion delta = q2 * q1.conjugated();
+    if (delta.scalar() < 0.0f){
+        delta = -delta;
+    }
+    QVector3D axis;
+    float angle = 0.0f;
+    delta.getAxisAndAngle(&axis, &angle);
+    return axis * angle;
+}
+
+// Rotate a quaternion by a rotation vector (axis times angle in deg, absolute coordinates)
+static QQuaternion rotateBy(const QQuaternion &q, const QVector3D &rotation_vector){
+    float angle = rotation_vector.length();
+    if (angle < 1e-6f){
+        return q;
+    }
+    return QQuaternion::fromAxisAndAngle(rotation_vector / angle, angle) * q;
+}
+
 // Get the list of parents of an Item up to the Station, with type filtering (i.e. [ITEM_TYPE_FRAME, ITEM_TYPE_ROBOT, ..]).
 static QList<Item> getAncestors(Item item, QList<int> filters = {}){
     Item parent = item;
@@ -189,9 +242,13 @@ QString PluginAttachView::PluginLoad(QMainWindow *mw, QMenuBar *menubar, QStatus
     action_slave_anchor_to_view = new QAction(tr("Slave the Item to the View"));
     action_slave_anchor_to_view->setCheckable(true);
 
+    action_follow_anchor = new QAction(tr("Follow this Item (smooth View)"));
+    action_follow_anchor->setCheckable(true);
+
     // Make sure to connect the action to your callback (slot)
     connect(action_slave_view_to_anchor, SIGNAL(triggered(bool)), this, SLOT(callback_activate_slave_view_to_anchor(bool)));
     connect(action_slave_anchor_to_view, SIGNAL(triggered(bool)), this, SLOT(callback_activate_slave_anchor_to_view(bool)));
+    connect(action_follow_anchor, SIGNAL(triggered(bool)), this, SLOT(callback_activate_follow_anchor(bool)));
 
     // return string is reserverd for future compatibility
     return "";
@@ -215,6 +272,11 @@ void PluginAttachView::PluginUnload(){
         action_slave_anchor_to_view->deleteLater();
         action_slave_anchor_to_view = nullptr;
     }
+    if (nullptr != action_follow_anchor)
+    {
+        action_follow_anchor->deleteLater();
+        action_follow_anchor = nullptr;
+    }
 }
 
 
@@ -236,11 +298,12 @@ bool PluginAttachView::PluginItemClick(Item item, QMenu *menu, TypeClick click_t
 
         bool active = (view_anchor.anchor == item);
         bool is_master = (view_anchor.is_master);
+        bool follow = (view_anchor.follow);
 
         // Create the menu option, or update if it already exist
         menu->addSeparator();
         action_slave_view_to_anchor->blockSignals(true);
-        action_slave_view_to_anchor->setChecked(active && !is_master);
+        action_slave_view_to_anchor->setChecked(active && !is_master && !follow);
         action_slave_view_to_anchor->blockSignals(false);
         menu->addAction(action_slave_view_to_anchor);
 
@@ -249,6 +312,11 @@ bool PluginAttachView::PluginItemClick(Item item, QMenu *menu, TypeClick click_t
         action_slave_anchor_to_view->blockSignals(false);
         menu->addAction(action_slave_anchor_to_view);
 
+        action_follow_anchor->blockSignals(true);
+        action_follow_anchor->setChecked(active && follow);
+        action_follow_anchor->blockSignals(false);
+        menu->addAction(action_follow_anchor);
+
         return true;
     }
 
@@ -261,6 +329,8 @@ QString PluginAttachView::PluginCommand(const QString &command, const QString &v
 
     // Expected format: "View2Item", "Item". Attach the View to the Item
     //                  "Item2View", "Item". Attach the Item to the View
+    //                  "Follow", "Item". The View follows the Item smoothly
+    //                  "FollowSettings", "TimeConstant|Prediction|ThresholdMM|ThresholdDeg". Set (optional) and get the follow settings
     //                  "Detach", "". Detach any relationships
     //
     // For now, prompting the user for selection is not supported through the PluginCommand.
@@ -273,7 +343,7 @@ QString PluginAttachView::PluginCommand(const QString &command, const QString &v
             return "Invalid item";
         }
 
-        if (view_anchor.anchor == item && !view_anchor.is_master){
+        if (view_anchor.anchor == item && !view_anchor.is_master && !view_anchor.follow){
             return "Already attached";
         }
 
@@ -297,6 +367,33 @@ QString PluginAttachView::PluginCommand(const QString &command, const QString &v
         callback_activate_slave_anchor_to_view(true);
         return "OK";
 
+    } else if (command.compare("Follow", Qt::CaseInsensitive) == 0) {
+        Item item = RDK->getItem(value);
+        if (!RDK->Valid(item) || !processItem(item)) {
+            return "Invalid item";
+        }
+
+        if (view_anchor.anchor == item && view_anchor.follow){
+            return "Already attached";
+        }
+
+        // Replace any active attachment
+        last_clicked_item = item;
+        callback_activate_follow_anchor(true);
+        return "OK";
+
+    } else if (command.compare("FollowSettings", Qt::CaseInsensitive) == 0) {
+        QStringList values = value.split("|");
+        if (values.length() == 4) {
+            follow_time_constant = qMax(0.0, values.at(0).toDouble());
+            follow_prediction = qMax(0.0, values.at(1).toDouble());
+            follow_threshold_mm = qMax(0.0, values.at(2).toDouble());
+            follow_threshold_deg = qMax(0.0, values.at(3).toDouble());
+        } else if (!value.isEmpty()) {
+            return "Invalid values";
+        }
+        return QString("%1|%2|%3|%4").arg(follow_time_constant).arg(follow_prediction).arg(follow_threshold_mm).arg(follow_threshold_deg);
+
     } else if (command.compare("Detach", Qt::CaseInsensitive) == 0) {
         view_anchor.clear();
         return "OK";
@@ -312,14 +409,26 @@ void PluginAttachView::PluginEvent(TypeEvent event_type){
     case EventChanged:
     {
         cleanupRemovedItems();
-        updatePose();
+        if (view_anchor.follow){
+            follow_state.anchor_moved = true;
+        } else {
+            updatePose();
+        }
         break;
     }
     case EventMoved:
-        updateViewPose(); // Update the View when something has moved
+        if (view_anchor.follow){
+            follow_state.anchor_moved = true; // The follow camera samples the anchor once per frame
+        } else {
+            updateViewPose(); // Update the View when something has moved
+        }
         break;
     case EventRender:
-        updateAnchorPose(); // Update the anchor all the time as the camera can move any time
+        if (view_anchor.follow){
+            updateFollowPose();
+        } else {
+            updateAnchorPose(); // Update the anchor all the time as the camera can move any time
+        }
         break;
     default:
         break;
@@ -362,6 +471,23 @@ void PluginAttachView::callback_activate_slave_anchor_to_view(bool activate){
 }
 
 
+void PluginAttachView::callback_activate_follow_anchor(bool activate){
+    if (last_clicked_item == nullptr){
+        return;
+    }
+
+    view_anchor.clear();
+    follow_state = follow_state_t();
+    if (!activate){
+        return;
+    }
+
+    view_anchor.anchor = last_clicked_item;
+    view_anchor.follow = true;
+    view_anchor.station = RDK->getActiveStation();
+}
+
+
 //----------------------------------------------------------------------------------
 bool PluginAttachView::processItem(Item item){
     if (item == nullptr){
@@ -421,6 +547,96 @@ void PluginAttachView::updatePose(){
 }
 
 
+void PluginAttachView::updateFollowPose(){
+    if (view_anchor.anchor == nullptr || !view_anchor.follow){
+        return;
+    }
+
+    if (view_anchor.station != RDK->getActiveStation()){
+        return;
+    }
+
+    follow_state_t &fs = follow_state;
+    if (fs.settled && !fs.anchor_moved){
+        return;
+    }
+
+    double dt = 0.0;
+    if (fs.timer.isValid()){
+        dt = fs.timer.restart() * 0.001;
+    } else {
+        fs.timer.start();
+    }
+
+    // Sample the anchor once per frame
+    Mat pose_abs = getPoseWrt(view_anchor.anchor, view_anchor.station);
+    QVector3D position(pose_abs.Get(0, 3), pose_abs.Get(1, 3), pose_abs.Get(2, 3));
+    QQuaternion rotation = poseRotation(pose_abs);
+    bool anchor_moved = fs.anchor_moved;
+    fs.anchor_moved = false;
+
+    if (!fs.valid || dt <= 0.0 || dt > MAX_FOLLOW_STEP){
+        // First sample or long pause: jump to the anchor
+        fs.valid = true;
+        fs.linear_velocity = QVector3D();
+        fs.angular_velocity = QVector3D();
+        fs.view_position = position;
+        fs.view_rotation = rotation;
+    } else {
+        // Filtered velocity of the anchor
+        QVector3D linear_velocity = (position - fs.anchor_position) / dt;
+        QVector3D angular_velocity = rotationVector(fs.anchor_rotation, rotation) / dt;
+        fs.linear_velocity += VELOCITY_FILTER * (linear_velocity - fs.linear_velocity);
+        fs.angular_velocity += VELOCITY_FILTER * (angular_velocity - fs.angular_velocity);
+
+        // Predict the anchor pose to compensate the lag of the smoothing
+        QVector3D target_position = position + fs.linear_velocity * follow_prediction;
+        QQuaternion target_rotation = rotateBy(rotation, fs.angular_velocity * follow_prediction);
+
+        // Exponential smoothing towards the prediction (quaternion interpolation for the rotation)
+        float alpha = (follow_time_constant > 0.0) ? 1.0 - qExp(-dt / follow_time_constant) : 1.0;
+        fs.view_position += alpha * (target_position - fs.view_position);
+        fs.view_rotation = QQuaternion::slerp(fs.view_rotation, target_rotation, alpha);
+    }
+    fs.anchor_position = position;
+    fs.anchor_rotation = rotation;
+
+    // Snap to the anchor once it stopped and the view caught up
+    fs.settled = !anchor_moved && (fs.view_position - position).length() < follow_threshold_mm && rotationDistance(fs.view_rotation, rotation) < follow_threshold_deg;
+    if (fs.settled){
+        fs.linear_velocity = QVector3D();
+        fs.angular_velocity = QVector3D();
+        fs.view_position = position;
+        fs.view_rotation = rotation;
+    }
+
+    // One setViewPose per frame at most, skipped for small changes
+    bool changed = !fs.sent;
+    if (!changed){
+        double distance = (fs.view_position - fs.sent_position).length();
+        double angle = rotationDistance(fs.view_rotation, fs.sent_rotation);
+        changed = (distance >= follow_threshold_mm) || (angle >= follow_threshold_deg) || (fs.settled && (distance > 0.0 || angle > 0.0));
+    }
+    if (changed){
+        RDK->setViewPose(camabs_2_vp(quaternionPose(fs.view_rotation, fs.view_position)));
+        fs.sent = true;
+        fs.sent_position = fs.view_position;
+        fs.sent_rotation = fs.view_rotation;
+    }
+
+    // Keep redisplaying (without updating the station) until the view reaches the anchor
+    if (!fs.settled && !fs.render_pending){
+        fs.render_pending = true;
+        QTimer::singleShot(0, this, [this](){
+            follow_state.render_pending = false;
+            if (view_anchor.follow){
+                RDK->Render(RoboDK::RenderScreen);
+            }
+        });
+    }
+}
+
+
 void PluginAttachView::cleanupRemovedItems() {
     if (view_anchor.anchor == nullptr){
         return;
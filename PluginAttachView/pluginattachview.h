@@ -11,6 +11,8 @@
 
 #include <QTimer>
 #include <QElapsedTimer>
+#include <QVector3D>
+#include <QQuaternion>
 
 
 
@@ -62,6 +64,7 @@ public slots:
     /// define button callbacks (or slots) here. They are triggered automatically when the button is selected.
     void callback_activate_slave_view_to_anchor(bool active);
     void callback_activate_slave_anchor_to_view(bool active);
+    void callback_activate_follow_anchor(bool active);
 
 public:
 
@@ -77,6 +80,9 @@ public:
     /// Update the pose of the master anchor (view or anchor)
     void updatePose();
 
+    /// Update the smooth follow camera. Called once per frame: the anchor is sampled once and the view is set once at most.
+    void updateFollowPose();
+
     /// Remove deleted or invalid Items
     void cleanupRemovedItems();
 
@@ -85,15 +91,18 @@ private:
 
     QAction *action_slave_view_to_anchor { nullptr };
     QAction *action_slave_anchor_to_view { nullptr };
+    QAction *action_follow_anchor { nullptr };
 
     struct view_anchor_t
     {
         bool is_master { false }; // True if the view updates the anchor, else the anchor updates the view
+        bool follow { false }; // True if the view follows the anchor smoothly (the anchor updates the view)
         Item anchor { nullptr };
         Item station { nullptr };
 
         void clear(){
             is_master = false;
+            follow = false;
             anchor = nullptr;
             station = nullptr;
         }
@@ -101,6 +110,40 @@ private:
 
     view_anchor_t view_anchor;
 
+    /// State of the smooth follow camera
+    struct follow_state_t
+    {
+        bool valid { false }; // False until the anchor is sampled for the first time
+        bool anchor_moved { true }; // Something moved since the last frame
+        bool settled { false }; // The view reached the anchor and the anchor is still
+        bool render_pending { false }; // A redisplay was requested to continue the motion
+        QElapsedTimer timer; // Time since the last frame
+
+        QVector3D anchor_position; // Last anchor sample (absolute)
+        QQuaternion anchor_rotation;
+        QVector3D linear_velocity; // Filtered anchor velocity (mm/s)
+        QVector3D angular_velocity; // Filtered anchor angular velocity: axis times rate (deg/s)
+
+        QVector3D view_position; // Smoothed camera pose (absolute)
+        QQuaternion view_rotation;
+
+        bool sent { false }; // Last pose sent with setViewPose
+        QVector3D sent_position;
+        QQuaternion sent_rotation;
+    };
+
+    follow_state_t follow_state;
+
+    /// Time constant of the follow filter (s). Set to 0 to follow the anchor without smoothing.
+    double follow_time_constant { 0.15 };
+
+    /// Time the anchor motion is predicted ahead (s), to compensate the lag of the smoothing
+    double follow_prediction { 0.05 };
+
+    /// The view is not updated if the pose changed less than these thresholds (mm and deg)
+    double follow_threshold_mm { 0.05 };
+    double follow_threshold_deg { 0.01 };
+
     Item last_clicked_item { nullptr };
 
 
@@ -0,0 +1,309 @@
+#include "BallbarAnalysis.h"
+
+#include <QDateTime>
+#include <QTextStream>
+#include <QtMath>
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+
+
+/// Half width of the angular window around an axis reversal (deg)
+static const double SPIKE_WINDOW = 3.0;
+
+/// Outer limit of the neighbourhood used as reference for a reversal spike (deg)
+static const double SPIKE_NEIGHBOURHOOD = 15.0;
+
+
+// Angle from a to b, wrapped to [-pi, pi)
+static double angleDiff(double a, double b){
+    double d = std::fmod(b - a + M_PI, 2.0 * M_PI);
+    if (d < 0.0){
+        d += 2.0 * M_PI;
+    }
+    return d - M_PI;
+}
+
+// In place radix-2 FFT (the size must be a power of 2)
+static void fft(QVector<std::complex<double>> &data){
+    int n = data.size();
+    for (int i = 1, j = 0; i < n; i++){
+        int bit = n >> 1;
+        for (; j & bit; bit >>= 1){
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j){
+            std::swap(data[i], data[j]);
+        }
+    }
+    for (int len = 2; len <= n; len <<= 1){
+        double angle = -2.0 * M_PI / len;
+        std::complex<double> wlen(std::cos(angle), std::sin(angle));
+        for (int i = 0; i < n; i += len){
+            std::complex<double> w(1.0, 0.0);
+            for (int k = 0; k < len / 2; k++){
+                std::complex<double> u = data[i + k];
+                std::complex<double> v = data[i + k + len / 2] * w;
+                data[i + k] = u + v;
+                data[i + k + len / 2] = u - v;
+                w *= wlen;
+            }
+        }
+    }
+}
+
+// Solve a 3x3 linear system (Gaussian elimination with partial pivoting). Returns false if the system is singular.
+static bool solve3(double a[3][3], double b[3], double x[3]){
+    for (int c = 0; c < 3; c++){
+        int pivot = c;
+        for (int r = c + 1; r < 3; r++){
+            if (std::fabs(a[r][c]) > std::fabs(a[pivot][c])){
+                pivot = r;
+            }
+        }
+        if (std::fabs(a[pivot][c]) < 1e-12){
+            return false;
+        }
+        if (pivot != c){
+            std::swap(a[pivot], a[c]);
+            std::swap(b[pivot], b[c]);
+        }
+        for (int r = c + 1; r < 3; r++){
+            double f = a[r][c] / a[c][c];
+            for (int k = c; k < 3; k++){
+                a[r][k] -= f * a[c][k];
+            }
+            b[r] -= f * b[c];
+        }
+    }
+    for (int r = 2; r >= 0; r--){
+        double sum = b[r];
+        for (int k = r + 1; k < 3; k++){
+            sum -= a[r][k] * x[k];
+        }
+        x[r] = sum / a[r][r];
+    }
+    return true;
+}
+
+
+ballbar_analysis_t BallbarAnalysis::Analyze(const QVector<ballbar_sample_t> &samples, double nominal_radius){
+    ballbar_analysis_t result;
+    int n = samples.size();
+    result.samples = n;
+    if (n < 8){
+        result.error = "Not enough samples";
+        return result;
+    }
+    result.duration = samples.last().time - samples.first().time;
+
+    // The test plane is the plane of the ballbar center frame with the smallest normal component along the path
+    double normal_sum[3] = { 0.0, 0.0, 0.0 };
+    for (const auto &s : samples){
+        double r = std::sqrt(s.position[0] * s.position[0] + s.position[1] * s.position[1] + s.position[2] * s.position[2]);
+        if (r > 0.0){
+            for (int k = 0; k < 3; k++){
+                normal_sum[k] += std::fabs(s.position[k]) / r;
+            }
+        }
+    }
+    int normal = 2;
+    if (normal_sum[0] < normal_sum[normal]){
+        normal = 0;
+    }
+    if (normal_sum[1] < normal_sum[normal]){
+        normal = 1;
+    }
+    int axis1 = (normal + 1) % 3;
+    int axis2 = (normal + 2) % 3;
+    const char *planes[3] = { "YZ", "ZX", "XY" };
+    result.plane = planes[normal];
+
+    // Angle in the test plane (unwrapped) and measured radius
+    QVector<double> angle(n);
+    QVector<double> radius(n);
+    double radius_sum = 0.0;
+    for (int i = 0; i < n; i++){
+        const double *p = samples[i].position;
+        radius[i] = std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+        radius_sum += radius[i];
+        double a = std::atan2(p[axis2], p[axis1]);
+        angle[i] = (i == 0) ? a : angle[i - 1] + angleDiff(angle[i - 1], a);
+    }
+    auto range = std::minmax_element(angle.constBegin(), angle.constEnd());
+    result.sweep = (*range.second - *range.first) * 180.0 / M_PI;
+    result.nominal_radius = (nominal_radius > 0.0) ? nominal_radius : radius_sum / n;
+
+    // Least squares circle. For a small center offset (a, b), the ballbar length is r = R + a*cos(t) + b*sin(t)
+    double ata[3][3] = { { 0.0 } };
+    double atb[3] = { 0.0, 0.0, 0.0 };
+    for (int i = 0; i < n; i++){
+        double row[3] = { 1.0, std::cos(angle[i]), std::sin(angle[i]) };
+        for (int r = 0; r < 3; r++){
+            for (int c = 0; c < 3; c++){
+                ata[r][c] += row[r] * row[c];
+            }
+            atb[r] += row[r] * radius[i];
+        }
+    }
+    double fit[3];
+    if (!solve3(ata, atb, fit)){
+        result.error = "The angle covered by the test is too small";
+        return result;
+    }
+    result.fitted_radius = fit[0];
+    result.center_offset[0] = fit[1];
+    result.center_offset[1] = fit[2];
+
+    // Radial deviation from the least squares circle, per direction
+    QVector<double> deviation(n);
+    double min_all = 1e30, max_all = -1e30;
+    double min_dir[2] = { 1e30, 1e30 };
+    double max_dir[2] = { -1e30, -1e30 };
+    QVector<double> bin_sum(AngularBins, 0.0);
+    QVector<int> bin_count(AngularBins, 0);
+    QVector<double> dir_sum[2] = { QVector<double>(AngularBins, 0.0), QVector<double>(AngularBins, 0.0) };
+    QVector<int> dir_count[2] = { QVector<int>(AngularBins, 0), QVector<int>(AngularBins, 0) };
+    for (int i = 0; i < n; i++){
+        double d = radius[i] - (fit[0] + fit[1] * std::cos(angle[i]) + fit[2] * std::sin(angle[i]));
+        deviation[i] = d;
+        min_all = std::min(min_all, d);
+        max_all = std::max(max_all, d);
+
+        double wrapped = std::fmod(angle[i], 2.0 * M_PI);
+        if (wrapped < 0.0){
+            wrapped += 2.0 * M_PI;
+        }
+        int bin = std::min(static_cast<int>(wrapped / (2.0 * M_PI) * AngularBins), AngularBins - 1);
+        bin_sum[bin] += d;
+        bin_count[bin]++;
+
+        // Direction of motion: 0 is counter-clockwise, 1 is clockwise. Samples without motion are not assigned.
+        double step = (i + 1 < n) ? angle[i + 1] - angle[i] : angle[i] - angle[i - 1];
+        if (step == 0.0){
+            continue;
+        }
+        int dir = (step > 0.0) ? 0 : 1;
+        min_dir[dir] = std::min(min_dir[dir], d);
+        max_dir[dir] = std::max(max_dir[dir], d);
+        dir_sum[dir][bin] += d;
+        dir_count[dir][bin]++;
+    }
+    result.circular_deviation = max_all - min_all;
+    result.circular_deviation_ccw = (max_dir[0] >= min_dir[0]) ? max_dir[0] - min_dir[0] : 0.0;
+    result.circular_deviation_cw = (max_dir[1] >= min_dir[1]) ? max_dir[1] - min_dir[1] : 0.0;
+
+    // Hysteresis: largest difference between both directions at the same angle
+    for (int b = 0; b < AngularBins; b++){
+        if (dir_count[0][b] > 0 && dir_count[1][b] > 0){
+            double diff = std::fabs(dir_sum[0][b] / dir_count[0][b] - dir_sum[1][b] / dir_count[1][b]);
+            result.circular_hysteresis = std::max(result.circular_hysteresis, diff);
+        }
+    }
+
+    // Reversal spikes: peak deviation around each quadrant with respect to the mean deviation of the neighbourhood
+    double window = SPIKE_WINDOW * M_PI / 180.0;
+    double neighbourhood = SPIKE_NEIGHBOURHOOD * M_PI / 180.0;
+    for (int q = 0; q < 4; q++){
+        double quadrant = q * M_PI / 2.0;
+        double reference = 0.0;
+        int reference_count = 0;
+        for (int i = 0; i < n; i++){
+            double distance = std::fabs(angleDiff(quadrant, angle[i]));
+            if (distance >= window && distance <= neighbourhood){
+                reference += deviation[i];
+                reference_count++;
+            }
+        }
+        if (reference_count > 0){
+            reference /= reference_count;
+        }
+        double spike = 0.0;
+        for (int i = 0; i < n; i++){
+            if (std::fabs(angleDiff(quadrant, angle[i])) < window && std::fabs(deviation[i] - reference) > std::fabs(spike)){
+                spike = deviation[i] - reference;
+            }
+        }
+        result.reversal_spikes[q] = spike;
+    }
+
+    // Harmonics of the deviation over one revolution. Empty bins are interpolated between the closest bins with samples.
+    QVector<int> filled;
+    for (int b = 0; b < AngularBins; b++){
+        if (bin_count[b] > 0){
+            filled.append(b);
+        }
+    }
+    QVector<std::complex<double>> spectrum(AngularBins);
+    for (int f = 0; f < filled.size(); f++){
+        int b0 = filled[f];
+        int b1 = filled[(f + 1) % filled.size()];
+        double v0 = bin_sum[b0] / bin_count[b0];
+        double v1 = bin_sum[b1] / bin_count[b1];
+        int gap = (b1 - b0 + AngularBins) % AngularBins;
+        if (gap == 0){
+            gap = AngularBins;
+        }
+        for (int k = 0; k < gap; k++){
+            spectrum[(b0 + k) % AngularBins] = v0 + (v1 - v0) * k / gap;
+        }
+    }
+    fft(spectrum);
+    result.harmonic_amplitudes.resize(HarmonicCount + 1);
+    result.harmonic_phases.resize(HarmonicCount + 1);
+    for (int h = 0; h <= HarmonicCount; h++){
+        double scale = (h == 0) ? 1.0 / AngularBins : 2.0 / AngularBins;
+        result.harmonic_amplitudes[h] = std::abs(spectrum[h]) * scale;
+        result.harmonic_phases[h] = std::arg(spectrum[h]) * 180.0 / M_PI;
+    }
+    return result;
+}
+
+
+QString BallbarAnalysis::Report(const ballbar_analysis_t &result, const QString &name){
+    QString report;
+    QTextStream out(&report);
+    auto line = [&out](const QString &label, const QString &value){
+        out << label.leftJustified(36, ' ') << value << "\n";
+    };
+    auto mm = [](double value){
+        return QString::number(value, 'f', 4);
+    };
+
+    out << "Circular test report (ISO 230-4)\n";
+    out << "================================\n";
+    line("Ballbar:", name);
+    line("Date:", QDateTime::currentDateTime().toString(Qt::ISODate));
+    line("Samples:", QString::number(result.samples));
+    if (!result.error.isEmpty()){
+        line("Error:", result.error);
+        return report;
+    }
+    line("Duration (s):", QString::number(result.duration, 'f', 3));
+    line("Test plane:", result.plane);
+    line("Swept angle (deg):", QString::number(result.sweep, 'f', 1));
+    out << "\n";
+    line("Nominal radius (mm):", mm(result.nominal_radius));
+    line("Least squares radius (mm):", mm(result.fitted_radius));
+    line("Radius deviation (mm):", mm(result.fitted_radius - result.nominal_radius));
+    line(QString("Center offset %1 (mm):").arg(result.plane.at(0)), mm(result.center_offset[0]));
+    line(QString("Center offset %1 (mm):").arg(result.plane.at(1)), mm(result.center_offset[1]));
+    out << "\n";
+    line("Circular deviation G (mm):", mm(result.circular_deviation));
+    line("Circular deviation G(cw) (mm):", mm(result.circular_deviation_cw));
+    line("Circular deviation G(ccw) (mm):", mm(result.circular_deviation_ccw));
+    line("Circular hysteresis H (mm):", mm(result.circular_hysteresis));
+    out << "\n";
+    out << "Reversal spikes (mm)\n";
+    for (int q = 0; q < 4; q++){
+        line(QString("  %1 deg:").arg(q * 90), mm(result.reversal_spikes[q]));
+    }
+    out << "\n";
+    out << "Harmonics of the radial deviation (mm, deg)\n";
+    for (int h = 1; h < result.harmonic_amplitudes.size(); h++){
+        line(QString("  %1:").arg(h), mm(result.harmonic_amplitudes[h]) + "  " + QString::number(result.harmonic_phases[h], 'f', 1));
+    }
+    return report;
+}
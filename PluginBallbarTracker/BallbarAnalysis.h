@@ -0,0 +1,84 @@
+#ifndef BALLBARANALYSIS_H
+#define BALLBARANALYSIS_H
+
+
+#include <QString>
+#include <QVector>
+
+
+/// One sample of a circular test, recorded at simulation rate
+struct ballbar_sample_t
+{
+    /// Simulation time (s)
+    double time;
+
+    /// Position of the ballbar end (robot TCP) with respect to the ballbar center frame (mm)
+    double position[3];
+};
+
+
+/// Results of the analysis of a circular test, following ISO 230-4
+struct ballbar_analysis_t
+{
+    /// Number of samples and duration of the test (s)
+    int samples { 0 };
+    double duration { 0.0 };
+
+    /// Plane of the ballbar center frame where the test was performed: "XY", "YZ" or "ZX"
+    QString plane;
+
+    /// Angle covered by the test (deg)
+    double sweep { 0.0 };
+
+    /// Nominal radius of the test and radius of the least squares circle (mm)
+    double nominal_radius { 0.0 };
+    double fitted_radius { 0.0 };
+
+    /// Offset of the least squares circle center with respect to the ballbar center, along the first and second axis of the test plane (mm)
+    double center_offset[2] { 0.0, 0.0 };
+
+    /// Circular deviation G: radial range around the least squares circle, for both directions and for each direction (mm)
+    double circular_deviation { 0.0 };
+    double circular_deviation_cw { 0.0 };
+    double circular_deviation_ccw { 0.0 };
+
+    /// Circular hysteresis H: maximum radial difference between both directions at the same angle (mm)
+    double circular_hysteresis { 0.0 };
+
+    /// Reversal spikes at 0, 90, 180 and 270 deg: peak deviation with respect to the neighbourhood (mm)
+    double reversal_spikes[4] { 0.0, 0.0, 0.0, 0.0 };
+
+    /// Harmonic content of the radial deviation: amplitude (mm) and phase (deg). Index 0 is the mean deviation.
+    QVector<double> harmonic_amplitudes;
+    QVector<double> harmonic_phases;
+
+    /// Error message, empty if the analysis succeeded
+    QString error;
+};
+
+
+///
+/// \brief The BallbarAnalysis class analyses a circular test recorded with a ballbar (ISO 230-4).
+/// The analysis does not use the RoboDK API: it can run on a worker thread.
+///
+class BallbarAnalysis
+{
+public:
+    /// Number of harmonics reported
+    static const int HarmonicCount = 10;
+
+    /// Number of angular bins used to calculate the hysteresis and the harmonics (must be a power of 2)
+    static const int AngularBins = 512;
+
+    /// \brief Analyse a circular test.
+    /// The test plane is the plane of the ballbar center frame (XY, YZ or ZX) closest to the recorded path.
+    /// \param samples Recorded samples
+    /// \param nominal_radius Nominal radius (mm). Set to 0 or a negative value to use the mean measured radius.
+    static ballbar_analysis_t Analyze(const QVector<ballbar_sample_t> &samples, double nominal_radius = -1);
+
+    /// Generate a text report of the analysis, in the style of ISO 230-4
+    static QString Report(const ballbar_analysis_t &result, const QString &name);
+};
+
+
+#endif // BALLBARANALYSIS_H
@@ -4,6 +4,9 @@
 #include <QStatusBar>
 #include <QMenuBar>
 #include <QtMath>
+#include <QtConcurrent>
+#include <QFile>
+#include <QTextStream>
 
 // Parents of an item up to the station, with type filtering
 static QList<Item> parentsOf(Item item, QList<int> filters = {}){
@@ -50,21 +53,46 @@ static Item findLCA(Item item1, Item item2){
     return lca;
 }
 
-// Find the pose to apply to obtain child from parent
-static Mat poseFromTo(Item item_child, Item item_parent){
-
+// Find the chain of poses to apply to obtain child from parent, with the static items grouped in constant products.
+// Robots and mechanisms move with their joints: their pose is read on every update (see chainPose).
+static QList<chain_segment_t> chainFromTo(Item item_child, Item item_parent){
+    QList<chain_segment_t> chain;
     QList<Item> parents = parentsOf(item_child);
     if (!parents.contains(item_parent)){
         qDebug() << item_child->Name() << " is not a child of " << item_parent->Name();
-        return Mat(false);
+        return chain;
     }
 
-    Mat pose = item_parent->Pose();
+    QList<Item> items;
+    items.append(item_parent);
     for (int i = parents.size() - 1; i >= 0; --i){
-        pose *= parents[i]->Pose();
+        items.append(parents[i]);
+    }
+    items.append(item_child);
+
+    chain_segment_t segment;
+    for (const auto &item : items){
+        if (item->Type() == IItem::ITEM_TYPE_ROBOT || item->Type() == IItem::ITEM_TYPE_ROBOT_AXES){
+            segment.moving = item;
+            chain.append(segment);
+            segment = chain_segment_t();
+        } else {
+            segment.fixed *= item->Pose();
+        }
     }
-    pose *= item_child->Pose();
+    chain.append(segment);
+    return chain;
+}
 
+// Pose at the end of a cached chain
+static Mat chainPose(const QList<chain_segment_t> &chain){
+    Mat pose;
+    for (const auto &segment : chain){
+        pose *= segment.fixed;
+        if (segment.moving != nullptr){
+            pose *= segment.moving->Pose();
+        }
+    }
     return pose;
 }
 
@@ -151,6 +179,10 @@ QString PluginBallbarTracker::PluginLoad(QMainWindow *mw, QMenuBar *menubar, QSt
 
 
 void PluginBallbarTracker::PluginUnload(){
+    recording = false;
+    for (auto &bb : attached_ballbars){
+        bb.analysis.waitForFinished();
+    }
     last_clicked_item = nullptr;
     attached_ballbars.clear();
 
@@ -192,6 +224,60 @@ bool PluginBallbarTracker::PluginItemClick(Item item, QMenu *menu, TypeClick cli
 }
 
 QString PluginBallbarTracker::PluginCommand(const QString &command, const QString &item_name){
+    // Circular test commands apply to all attached ballbars
+    if (command.compare("RecordStart", Qt::CaseInsensitive) == 0){
+        // The value is the nominal radius of the test in mm (optional)
+        return start_recording(item_name.toDouble()) ? "OK" : "NO BALLBAR";
+    }
+    else if (command.compare("RecordStop", Qt::CaseInsensitive) == 0){
+        stop_recording();
+        return "OK";
+    }
+    else if (command.compare("RecordCapacity", Qt::CaseInsensitive) == 0){
+        // The buffers are preallocated when the recording starts: the capacity can't change during a recording
+        if (recording){
+            return "RECORDING";
+        }
+        bool ok = false;
+        int capacity = item_name.toInt(&ok);
+        if (ok && capacity > 0){
+            recording_capacity = capacity;
+        }
+        return QString::number(recording_capacity);
+    }
+    else if (command.compare("AnalysisStatus", Qt::CaseInsensitive) == 0){
+        if (recording){
+            return "RECORDING";
+        }
+        bool analysed = false;
+        for (const auto &bb : attached_ballbars){
+            if (!bb.analysis.isFinished()){
+                return "BUSY";
+            }
+            analysed = analysed || bb.analysis.resultCount() > 0;
+        }
+        return analysed ? "DONE" : "IDLE";
+    }
+    else if (command.compare("AnalysisReport", Qt::CaseInsensitive) == 0){
+        QString report;
+        return analysis_report(report) ? report : "BUSY";
+    }
+    else if (command.compare("ExportReport", Qt::CaseInsensitive) == 0){
+        // The value is the path of the text file to create
+        QString report;
+        if (!analysis_report(report)){
+            return "BUSY";
+        }
+        QFile file(item_name);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)){
+            qDebug() << "Unable to create report file: " << item_name;
+            return "FILE ERROR";
+        }
+        QTextStream stream(&file);
+        stream << report;
+        return "OK";
+    }
+
     Item item = RDK->getItem(item_name);
     if (item == nullptr){
         qDebug() << "Item not found";
@@ -243,6 +329,9 @@ void PluginBallbarTracker::PluginEvent(TypeEvent event_type){
             if (!RDK->Valid(bb.robot) || !RDK->Valid(bb.ballbar_center_frame) || !RDK->Valid(bb.ballbar_end_frame) || !RDK->Valid(bb.ballbar_extend_mech) || !RDK->Valid(bb.ballbar_orbit_mech)){
                 qDebug() << "Detaching ballbar, items removed.";
                 attached_ballbars.erase(it--);
+            } else {
+                // Items may have been moved in the tree
+                it->chains_valid = false;
             }
         }
         break;
@@ -293,26 +382,23 @@ bool PluginBallbarTracker::process_item(Item item){
 
 void PluginBallbarTracker::update_ballbar_pose(){
     bool renderUpdate = false;
+    double recording_time = recording ? RDK->Command("TrajectoryTime").toDouble() : 0.0;
     for (auto &bb : attached_ballbars){
         if (bb.attached){
 
+            // The chains only change when the station changes
+            if (!bb.chains_valid && !update_ballbar_chains(bb)){
+                continue;
+            }
+
             // Current ballbar values
             tJoints extend_joints = bb.ballbar_extend_mech->Joints();
             tJoints orbit_joints = bb.ballbar_orbit_mech->Joints();
 
-            // Poses
-            Item lca = findLCA(bb.robot, bb.ballbar_center_frame);
-            if (lca == nullptr){
-                qDebug() << "Unable to find lowest common ancestor.";
-                continue;
-            }
-            Mat robot_pose = poseFromTo(bb.robot, lca);
-            Mat bb_center_pose = poseFromTo(bb.ballbar_center_frame, lca);
-            Mat bb_pose = poseFromTo(bb.ballbar_end_frame, lca);
-            if (!robot_pose.Valid() || !bb_center_pose.Valid() || !bb_pose.Valid()){
-                qDebug() << "Unable to retreive the ballbar poses.";
-                continue;
-            }
+            // Poses (only the moving links are read)
+            Mat robot_pose = chainPose(bb.robot_chain);
+            Mat bb_center_pose = chainPose(bb.center_chain);
+            Mat bb_pose = chainPose(bb.end_chain);
 
             // XYZs
             // TODO: Refactor tXYZ so that it is easier to work with. i.e. r = norm(subs2(v1, v2))
@@ -346,13 +432,28 @@ void PluginBallbarTracker::update_ballbar_pose(){
             bb.ballbar_extend_mech->setJoints(extend_joints);
             bb.ballbar_orbit_mech->setJoints(orbit_joints);
 
-            // Check if the position is unreachable/invalid
-            tJoints lower_limits;
-            tJoints upper_limits;
-            bb.ballbar_extend_mech->JointLimits(&lower_limits, &upper_limits);
+            // Record the TCP position in the ballbar center frame (the preallocated buffer is never reallocated)
+            if (recording){
+                Mat tool_in_center = bb_center_pose.inv() * robot_pose;
+                ballbar_sample_t sample;
+                sample.time = recording_time;
+                for (int k = 0; k < 3; k++){
+                    sample.position[k] = tool_in_center.Get(k, 3);
+                }
+                const ballbar_sample_t *last = bb.samples.isEmpty() ? nullptr : &bb.samples.last();
+                bool moved = (last == nullptr) || last->position[0] != sample.position[0] || last->position[1] != sample.position[1] || last->position[2] != sample.position[2];
+                if (moved){
+                    if (bb.samples.size() < recording_capacity){
+                        bb.samples.append(sample);
+                    } else {
+                        recording_dropped++;
+                    }
+                }
+            }
 
+            // Check if the position is unreachable/invalid
             bb.reachable = true;
-            if ((extend_joints.Data()[0] < lower_limits.Data()[0]) || (extend_joints.Data()[0] > upper_limits.Data()[0])){
+            if ((extend_joints.Data()[0] < bb.extend_lower) || (extend_joints.Data()[0] > bb.extend_upper)){
                 bb.reachable = false;
                 // as an option, you can add bb.detach();
             }
@@ -366,6 +467,30 @@ void PluginBallbarTracker::update_ballbar_pose(){
     }
 }
 
+bool PluginBallbarTracker::update_ballbar_chains(attached_ballbar_t &bb){
+    Item lca = findLCA(bb.robot, bb.ballbar_center_frame);
+    if (lca == nullptr){
+        qDebug() << "Unable to find lowest common ancestor.";
+        return false;
+    }
+    bb.robot_chain = chainFromTo(bb.robot, lca);
+    bb.center_chain = chainFromTo(bb.ballbar_center_frame, lca);
+    bb.end_chain = chainFromTo(bb.ballbar_end_frame, lca);
+    if (bb.robot_chain.isEmpty() || bb.center_chain.isEmpty() || bb.end_chain.isEmpty()){
+        qDebug() << "Unable to retreive the ballbar poses.";
+        return false;
+    }
+
+    tJoints lower_limits;
+    tJoints upper_limits;
+    bb.ballbar_extend_mech->JointLimits(&lower_limits, &upper_limits);
+    bb.extend_lower = lower_limits.Data()[0];
+    bb.extend_upper = upper_limits.Data()[0];
+
+    bb.chains_valid = true;
+    return true;
+}
+
 void PluginBallbarTracker::callback_attach_ballbar(bool attach){
     if (last_clicked_item == nullptr){
         return;
@@ -429,3 +554,54 @@ void PluginBallbarTracker::callback_attach_ballbar(bool attach){
         update_ballbar_pose();
     }
 }
+
+bool PluginBallbarTracker::start_recording(double nominal_radius){
+    if (attached_ballbars.isEmpty()){
+        qDebug() << "No ballbar attached, unable to record a circular test.";
+        return false;
+    }
+
+    // Preallocate the buffers so recording at simulation rate never allocates memory
+    for (auto &bb : attached_ballbars){
+        bb.samples.clear();
+        bb.samples.reserve(recording_capacity);
+        bb.name = bb.robot->Name() + " / " + bb.ballbar_center_frame->Name();
+    }
+    recording_nominal_radius = nominal_radius;
+    recording_dropped = 0;
+    recording = true;
+    qDebug() << "Recording circular test with " << attached_ballbars.size() << " ballbar(s)";
+    return true;
+}
+
+void PluginBallbarTracker::stop_recording(){
+    if (!recording){
+        return;
+    }
+    recording = false;
+    if (recording_dropped > 0){
+        qDebug() << "Circular test buffer full: " << recording_dropped << " samples dropped";
+    }
+
+    // The analysis runs on the global thread pool: the samples are shared with the worker and released when it finishes
+    for (auto &bb : attached_ballbars){
+        bb.analysis = QtConcurrent::run(BallbarAnalysis::Analyze, bb.samples, recording_nominal_radius);
+        bb.samples = QVector<ballbar_sample_t>();
+    }
+    StatusBar->showMessage(tr("Analysing circular test of %1 ballbar(s)").arg(attached_ballbars.size()));
+}
+
+bool PluginBallbarTracker::analysis_report(QString &report){
+    report.clear();
+    for (const auto &bb : attached_ballbars){
+        if (!bb.analysis.isFinished()){
+            return false;
+        }
+    }
+    for (const auto &bb : attached_ballbars){
+        if (bb.analysis.resultCount() > 0){
+            report += BallbarAnalysis::Report(bb.analysis.result(), bb.name) + "\n";
+        }
+    }
+    return true;
+}
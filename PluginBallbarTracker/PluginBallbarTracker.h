@@ -3,9 +3,23 @@
 
 
 #include "iapprobodk.h"
+#include "BallbarAnalysis.h"
+
+#include <QFuture>
 
 class QAction;
 
+
+/// Segment of a cached kinematic chain: a constant pose followed by the pose of a moving item (robot or mechanism)
+struct chain_segment_t
+{
+    /// Product of the poses of the static items of the segment
+    Mat fixed;
+
+    /// Robot or mechanism at the end of the segment (null for the last segment if it ends with a static item)
+    Item moving { nullptr };
+};
+
 ///
 /// \brief The PluginBallbarTracker allows you to attach a ballbar to a robot TCP.
 ///        A ballbar is statically attached to a base, and it's end can extend and rotate to follow the TCP.
@@ -92,6 +106,15 @@ public:
     /// Update the pose of all attached ballbars
     void update_ballbar_pose();
 
+    /// Start recording a circular test with all attached ballbars. Set the nominal radius to 0 to use the mean measured radius.
+    bool start_recording(double nominal_radius);
+
+    /// Stop recording and analyse the circular test of each ballbar on a worker thread
+    void stop_recording();
+
+    /// Report of the last circular test of all ballbars. Returns false if an analysis is still running.
+    bool analysis_report(QString &report);
+
 
 private:
 
@@ -109,6 +132,25 @@ private:
         Item ballbar_orbit_mech { nullptr };
         Item ballbar_extend_mech { nullptr };
 
+        /// Kinematic chains from the common ancestor to the robot, ballbar center and ballbar end (rebuilt after EventChanged)
+        bool chains_valid { false };
+        QList<chain_segment_t> robot_chain;
+        QList<chain_segment_t> center_chain;
+        QList<chain_segment_t> end_chain;
+
+        /// Joint limits of the extend mechanism (read when the chains are rebuilt)
+        double extend_lower { 0.0 };
+        double extend_upper { 0.0 };
+
+        /// Name used in the circular test reports
+        QString name;
+
+        /// Circular test samples (preallocated when the recording starts)
+        QVector<ballbar_sample_t> samples;
+
+        /// Analysis of the last circular test (calculated on a worker thread)
+        QFuture<ballbar_analysis_t> analysis;
+
         void detach(){
             attached = false;
             reachable = false;
@@ -123,9 +165,21 @@ private:
     /// Vector of all available attached ballbars
     QList<attached_ballbar_t> attached_ballbars;
 
+    /// Precompute the kinematic chains of an attached ballbar. Returns false if the items are not connected.
+    bool update_ballbar_chains(attached_ballbar_t &bb);
+
     /// Last clicked item --or item to attach to
     Item last_clicked_item { nullptr };
 
+    /// Default number of samples preallocated for each ballbar when recording a circular test
+    static const int DefaultRecordingCapacity = 200000;
+
+    /// Circular test recording state
+    bool recording { false };
+    int recording_capacity { DefaultRecordingCapacity };
+    double recording_nominal_radius { 0.0 };
+    int recording_dropped { 0 };
+
 };
 
 
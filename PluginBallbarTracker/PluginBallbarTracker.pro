@@ -27,6 +27,7 @@ CONFIG         += plugin
 #QT += core gui
 QT += widgets
 QT += network   # Allows using QTcpSocket
+QT += concurrent
 
 # Define your plugin name (name of the DLL file generated)
 TARGET          = PluginBallbarTracker
@@ -85,9 +86,11 @@ CONFIG(release, debug|release) {
 
 
 HEADERS += \
+    BallbarAnalysis.h \
     PluginBallbarTracker.h
 
 SOURCES += \
+    BallbarAnalysis.cpp \
     PluginBallbarTracker.cpp 
 
 
@@ -27,6 +27,7 @@ CONFIG         += plugin
 #QT += core gui
 QT += widgets
 QT += network   # Allows using QTcpSocket
+QT += concurrent # Parallel collision checks (built-in collision engine)
 
 # Define your plugin name (name of the DLL file generated)
 TARGET          = PluginCollisionSensor
@@ -84,9 +85,13 @@ CONFIG(release, debug|release) {
 
 
 HEADERS += \
+    distancefield.h \
+    meshcollision.h \
     plugincollisionsensor.h
 
 SOURCES += \
+    distancefield.cpp \
+    meshcollision.cpp \
     plugincollisionsensor.cpp
 
 
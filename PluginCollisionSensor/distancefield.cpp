@@ -0,0 +1,177 @@
+#include "distancefield.h"
+#include "meshcollision.h"
+
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <cmath>
+
+
+/// Maximum number of coarse cells (the voxel size is increased if required)
+static const double MAX_COARSE_CELLS = 2097152.0;
+
+
+/// Trilinear interpolation of the 8 values of a cell (x is the fastest index)
+static inline double trilinear(const float v[8], double tx, double ty, double tz) {
+    double c00 = v[0] + (v[1] - v[0]) * tx;
+    double c10 = v[2] + (v[3] - v[2]) * tx;
+    double c01 = v[4] + (v[5] - v[4]) * tx;
+    double c11 = v[6] + (v[7] - v[6]) * tx;
+    double c0 = c00 + (c10 - c00) * ty;
+    double c1 = c01 + (c11 - c01) * ty;
+    return c0 + (c1 - c0) * tz;
+}
+
+
+bool DistanceField::Build(const CollisionMesh &mesh, double voxel_size, double margin) {
+    coarse.clear();
+    bricks.clear();
+    fine.clear();
+    if (mesh.isEmpty()) {
+        return false;
+    }
+
+    tXYZ center;
+    tXYZ half;
+    mesh.Bounds(center, half);
+    double size = 2.0 * std::max(half[0], std::max(half[1], half[2]));
+    voxel = (voxel_size > 0.0) ? voxel_size : std::max(size / DefaultResolution, 0.1);
+
+    // Size the grid, increasing the voxel size for very large objects
+    while (true) {
+        brick = voxel * BrickSize;
+        double used_margin = (margin >= 0.0) ? margin : 2.0 * brick;
+        double ncoarse = 1.0;
+        for (int k = 0; k < 3; k++) {
+            origin[k] = center[k] - half[k] - used_margin;
+            ncells[k] = std::max(1, static_cast<int>(std::ceil((2.0 * (half[k] + used_margin)) / brick)));
+            ncoarse *= ncells[k] + 1;
+        }
+        if (ncoarse <= MAX_COARSE_CELLS) {
+            break;
+        }
+        voxel *= 2.0;
+    }
+
+    // Coarse distances at the corners of the bricks (one task per slice)
+    int nx = ncells[0] + 1;
+    int ny = ncells[1] + 1;
+    int nz = ncells[2] + 1;
+    coarse.resize(nx * ny * nz);
+    QVector<int> slices(nz);
+    for (int k = 0; k < nz; k++) {
+        slices[k] = k;
+    }
+    float *coarse_data = coarse.data();
+    QtConcurrent::blockingMap(slices, [this, &mesh, nx, ny, coarse_data](int k) {
+        for (int j = 0; j < ny; j++) {
+            for (int i = 0; i < nx; i++) {
+                tXYZ p = { origin[0] + i * brick, origin[1] + j * brick, origin[2] + k * brick };
+                coarse_data[coarseIndex(i, j, k)] = mesh.SignedDistance(p);
+            }
+        }
+    });
+
+    // The distance changes at most by the distance travelled: if the surface crosses a brick, all its corners are closer than the brick diagonal
+    double diagonal = brick * std::sqrt(3.0);
+    QVector<int> refined;
+    for (int k = 0; k < ncells[2]; k++) {
+        for (int j = 0; j < ncells[1]; j++) {
+            for (int i = 0; i < ncells[0]; i++) {
+                bool crossed = true;
+                for (int c = 0; c < 8 && crossed; c++) {
+                    float d = coarse[coarseIndex(i + (c & 1), j + ((c >> 1) & 1), k + ((c >> 2) & 1))];
+                    crossed = std::fabs(d) <= diagonal;
+                }
+                if (crossed) {
+                    refined.append(brickKey(i, j, k));
+                }
+            }
+        }
+    }
+
+    // Fine distances inside the bricks crossed by the surface (one task per brick)
+    const int nb = BrickSize + 1;
+    const int brick_values = nb * nb * nb;
+    fine.resize(refined.size() * brick_values);
+    QVector<int> tasks(refined.size());
+    for (int b = 0; b < refined.size(); b++) {
+        bricks.insert(refined[b], b * brick_values);
+        tasks[b] = b;
+    }
+    float *fine_data = fine.data();
+    QtConcurrent::blockingMap(tasks, [this, &mesh, &refined, nb, brick_values, diagonal, fine_data](int b) {
+        int key = refined[b];
+        int bi = key % ncells[0];
+        int bj = (key / ncells[0]) % ncells[1];
+        int bk = key / (ncells[0] * ncells[1]);
+        float *values = fine_data + b * brick_values;
+        for (int k = 0; k < nb; k++) {
+            for (int j = 0; j < nb; j++) {
+                for (int i = 0; i < nb; i++) {
+                    tXYZ p = { origin[0] + bi * brick + i * voxel, origin[1] + bj * brick + j * voxel, origin[2] + bk * brick + k * voxel };
+                    values[i + nb * (j + nb * k)] = mesh.SignedDistance(p, 2.0 * diagonal);
+                }
+            }
+        }
+    });
+    return true;
+}
+
+
+double DistanceField::coarseValue(const double local[3]) const {
+    int i = std::min(static_cast<int>(local[0]), ncells[0] - 1);
+    int j = std::min(static_cast<int>(local[1]), ncells[1] - 1);
+    int k = std::min(static_cast<int>(local[2]), ncells[2] - 1);
+    float v[8];
+    for (int c = 0; c < 8; c++) {
+        v[c] = coarse[coarseIndex(i + (c & 1), j + ((c >> 1) & 1), k + ((c >> 2) & 1))];
+    }
+    return trilinear(v, local[0] - i, local[1] - j, local[2] - k);
+}
+
+
+double DistanceField::Distance(const tXYZ point) const {
+    if (coarse.isEmpty()) {
+        return 1e30;
+    }
+
+    // Position in brick units, clamped to the grid
+    double local[3];
+    double outside2 = 0.0;
+    for (int k = 0; k < 3; k++) {
+        local[k] = (point[k] - origin[k]) / brick;
+        double d = 0.0;
+        if (local[k] < 0.0) {
+            d = -local[k];
+            local[k] = 0.0;
+        } else if (local[k] > ncells[k]) {
+            d = local[k] - ncells[k];
+            local[k] = ncells[k];
+        }
+        outside2 += d * d;
+    }
+    double outside = std::sqrt(outside2) * brick;
+
+    int i = std::min(static_cast<int>(local[0]), ncells[0] - 1);
+    int j = std::min(static_cast<int>(local[1]), ncells[1] - 1);
+    int k = std::min(static_cast<int>(local[2]), ncells[2] - 1);
+    auto it = bricks.constFind(brickKey(i, j, k));
+    if (it == bricks.constEnd()) {
+        return coarseValue(local) + outside;
+    }
+
+    // Position in voxel units inside the brick
+    double f[3] = { (local[0] - i) * BrickSize, (local[1] - j) * BrickSize, (local[2] - k) * BrickSize };
+    int vi = std::min(static_cast<int>(f[0]), BrickSize - 1);
+    int vj = std::min(static_cast<int>(f[1]), BrickSize - 1);
+    int vk = std::min(static_cast<int>(f[2]), BrickSize - 1);
+
+    const int nb = BrickSize + 1;
+    const float *values = fine.constData() + it.value();
+    float v[8];
+    for (int c = 0; c < 8; c++) {
+        v[c] = values[(vi + (c & 1)) + nb * ((vj + ((c >> 1) & 1)) + nb * (vk + ((c >> 2) & 1)))];
+    }
+    return trilinear(v, f[0] - vi, f[1] - vj, f[2] - vk) + outside;
+}
@@ -0,0 +1,75 @@
+#ifndef DISTANCEFIELD_H
+#define DISTANCEFIELD_H
+
+
+#include <QVector>
+#include <QHash>
+#include "robodktypes.h"
+
+
+class CollisionMesh;
+
+
+///
+/// \brief The DistanceField class is a sparse signed distance field of a rigid object, calculated once in the object coordinates.
+/// A coarse grid of bricks covers the object and its surroundings. Only the bricks crossed by the surface are refined with a fine grid of voxels.
+/// Queries interpolate the stored values: the cost of a query does not depend on the number of triangles of the mesh.
+///
+class DistanceField
+{
+public:
+    /// Number of voxels along each edge of a brick.
+    static const int BrickSize = 8;
+
+    /// Default number of voxels along the largest dimension of the object (used when the voxel size is not provided).
+    static const int DefaultResolution = 128;
+
+    /// \brief Calculate the distance field of a mesh.
+    /// \param mesh Mesh of the object
+    /// \param voxel_size Size of the fine voxels, in mm. Set to a negative value to use a size based on the object size.
+    /// \param margin Size of the region around the object covered by the coarse grid, in mm. Set to a negative value to use 2 bricks.
+    /// \return false if the mesh is empty
+    bool Build(const CollisionMesh &mesh, double voxel_size = -1, double margin = -1);
+
+    /// Returns true if the field was not calculated.
+    bool isEmpty() const { return coarse.isEmpty(); }
+
+    /// \brief Calculate the signed distance from a point to the object (negative inside).
+    /// Points outside the region covered by the field return the distance to the region plus the distance from the region to the object.
+    /// \param point Point in the object coordinates (mm)
+    /// \return Signed distance in mm
+    double Distance(const tXYZ point) const;
+
+    /// Size of the fine voxels (mm)
+    double VoxelSize() const { return voxel; }
+
+    /// Number of refined bricks
+    int BrickCount() const { return bricks.size(); }
+
+private:
+    int coarseIndex(int i, int j, int k) const { return i + (ncells[0] + 1) * (j + (ncells[1] + 1) * k); }
+    int brickKey(int i, int j, int k) const { return i + ncells[0] * (j + ncells[1] * k); }
+    double coarseValue(const double local[3]) const;
+
+    /// Origin of the grid (corner with the smallest coordinates), in the object coordinates
+    double origin[3] { 0, 0, 0 };
+
+    /// Size of a fine voxel and of a brick (mm)
+    double voxel { 0 };
+    double brick { 0 };
+
+    /// Number of bricks along each axis
+    int ncells[3] { 0, 0, 0 };
+
+    /// Distances at the corners of the bricks
+    QVector<float> coarse;
+
+    /// Offset of each refined brick in the list of fine values, given its key
+    QHash<int, int> bricks;
+
+    /// Distances at the corners of the voxels of the refined bricks ((BrickSize+1)^3 values per brick)
+    QVector<float> fine;
+};
+
+
+#endif // DISTANCEFIELD_H
@@ -0,0 +1,886 @@
+#include "meshcollision.h"
+#include "distancefield.h"
+
+#include <QFile>
+#include <QDataStream>
+#include <QTextStream>
+#include <QDebug>
+#include <QtConcurrent>
+#include <QVarLengthArray>
+#include <QRegularExpression>
+
+#include <algorithm>
+#include <cmath>
+
+#include "irobodk.h"
+#include "iitem.h"
+
+
+//------------------------------- Geometry helpers ------------------------------
+
+/// Small value added to the absolute rotation terms to handle parallel edges in the box test
+static const double EPS_PARALLEL = 1e-9;
+
+
+/// Separating axis test between two oriented boxes.
+/// Box a is given in its own coordinates, box b is transformed by rot/pos into the coordinates of box a.
+static bool boxesOverlap(const double ca[3], const double ea[3], const double cb[3], const double eb[3], const double rot[3][3], const double pos[3]) {
+    // Center of box b in the coordinates of a, relative to the center of a
+    double t[3];
+    for (int i = 0; i < 3; i++) {
+        t[i] = rot[i][0]*cb[0] + rot[i][1]*cb[1] + rot[i][2]*cb[2] + pos[i] - ca[i];
+    }
+
+    double absr[3][3];
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            absr[i][j] = std::fabs(rot[i][j]) + EPS_PARALLEL;
+        }
+    }
+
+    // Axes of box a
+    for (int i = 0; i < 3; i++) {
+        double rb = eb[0]*absr[i][0] + eb[1]*absr[i][1] + eb[2]*absr[i][2];
+        if (std::fabs(t[i]) > ea[i] + rb) {
+            return false;
+        }
+    }
+
+    // Axes of box b
+    for (int j = 0; j < 3; j++) {
+        double ra = ea[0]*absr[0][j] + ea[1]*absr[1][j] + ea[2]*absr[2][j];
+        double tj = t[0]*rot[0][j] + t[1]*rot[1][j] + t[2]*rot[2][j];
+        if (std::fabs(tj) > ra + eb[j]) {
+            return false;
+        }
+    }
+
+    // Cross products of the axes of a and b
+    for (int i = 0; i < 3; i++) {
+        int i1 = (i + 1) % 3;
+        int i2 = (i + 2) % 3;
+        for (int j = 0; j < 3; j++) {
+            int j1 = (j + 1) % 3;
+            int j2 = (j + 2) % 3;
+            double ra = ea[i1]*absr[i2][j] + ea[i2]*absr[i1][j];
+            double rb = eb[j1]*absr[i][j2] + eb[j2]*absr[i][j1];
+            double tl = t[i2]*rot[i1][j] - t[i1]*rot[i2][j];
+            if (std::fabs(tl) > ra + rb) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+
+/// Project a triangle on an axis
+static inline void projectTriangle(const double tri[9], const double axis[3], double &pmin, double &pmax) {
+    double p0 = DOT(tri, axis);
+    double p1 = DOT(tri + 3, axis);
+    double p2 = DOT(tri + 6, axis);
+    pmin = std::min(p0, std::min(p1, p2));
+    pmax = std::max(p0, std::max(p1, p2));
+}
+
+
+/// Returns true if the axis separates both triangles. Degenerated axes never separate.
+static inline bool separatingAxis(const double a[9], const double b[9], const double axis[3]) {
+    if (DOT(axis, axis) < 1e-18) {
+        return false;
+    }
+    double amin, amax, bmin, bmax;
+    projectTriangle(a, axis, amin, amax);
+    projectTriangle(b, axis, bmin, bmax);
+    return amax < bmin || bmax < amin;
+}
+
+
+/// Separating axis test between two triangles (9 values each). Touching triangles are considered colliding.
+static bool trianglesOverlap(const double a[9], const double b[9]) {
+    double ea[3][3];
+    double eb[3][3];
+    for (int i = 0; i < 3; i++) {
+        int n = (i + 1) % 3;
+        for (int k = 0; k < 3; k++) {
+            ea[i][k] = a[3*n + k] - a[3*i + k];
+            eb[i][k] = b[3*n + k] - b[3*i + k];
+        }
+    }
+
+    double na[3];
+    double nb[3];
+    CROSS(na, ea[0], ea[1]);
+    CROSS(nb, eb[0], eb[1]);
+    if (separatingAxis(a, b, na) || separatingAxis(a, b, nb)) {
+        return false;
+    }
+
+    double axis[3];
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            CROSS(axis, ea[i], eb[j]);
+            if (separatingAxis(a, b, axis)) {
+                return false;
+            }
+        }
+    }
+
+    // In-plane axes (required for coplanar triangles)
+    for (int i = 0; i < 3; i++) {
+        CROSS(axis, na, ea[i]);
+        if (separatingAxis(a, b, axis)) {
+            return false;
+        }
+        CROSS(axis, nb, eb[i]);
+        if (separatingAxis(a, b, axis)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/// Closest point to p on a triangle (9 values)
+static void closestPointTriangle(const double p[3], const double tri[9], double q[3]) {
+    const double *a = tri;
+    const double *b = tri + 3;
+    const double *c = tri + 6;
+    double ab[3], ac[3], ap[3], bp[3], cp[3];
+    for (int k = 0; k < 3; k++) {
+        ab[k] = b[k] - a[k];
+        ac[k] = c[k] - a[k];
+        ap[k] = p[k] - a[k];
+        bp[k] = p[k] - b[k];
+        cp[k] = p[k] - c[k];
+    }
+
+    double d1 = DOT(ab, ap);
+    double d2 = DOT(ac, ap);
+    if (d1 <= 0.0 && d2 <= 0.0) {
+        COPY3(q, a);
+        return;
+    }
+
+    double d3 = DOT(ab, bp);
+    double d4 = DOT(ac, bp);
+    if (d3 >= 0.0 && d4 <= d3) {
+        COPY3(q, b);
+        return;
+    }
+
+    double vc = d1*d4 - d3*d2;
+    if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0) {
+        double v = d1 / (d1 - d3);
+        for (int k = 0; k < 3; k++) {
+            q[k] = a[k] + v*ab[k];
+        }
+        return;
+    }
+
+    double d5 = DOT(ab, cp);
+    double d6 = DOT(ac, cp);
+    if (d6 >= 0.0 && d5 <= d6) {
+        COPY3(q, c);
+        return;
+    }
+
+    double vb = d5*d2 - d1*d6;
+    if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0) {
+        double w = d2 / (d2 - d6);
+        for (int k = 0; k < 3; k++) {
+            q[k] = a[k] + w*ac[k];
+        }
+        return;
+    }
+
+    double va = d3*d6 - d5*d4;
+    if (va <= 0.0 && (d4 - d3) >= 0.0 && (d5 - d6) >= 0.0) {
+        double w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+        for (int k = 0; k < 3; k++) {
+            q[k] = b[k] + w*(c[k] - b[k]);
+        }
+        return;
+    }
+
+    double sum = va + vb + vc;
+    if (sum <= 0.0) {
+        // Degenerated triangle
+        COPY3(q, a);
+        return;
+    }
+    double v = vb / sum;
+    double w = vc / sum;
+    for (int k = 0; k < 3; k++) {
+        q[k] = a[k] + ab[k]*v + ac[k]*w;
+    }
+}
+
+
+/// Distance from a point to an axis aligned box (0 inside)
+static inline double distancePointBox(const double p[3], const double center[3], const double half[3]) {
+    double d2 = 0.0;
+    for (int k = 0; k < 3; k++) {
+        double d = std::fabs(p[k] - center[k]) - half[k];
+        if (d > 0.0) {
+            d2 += d*d;
+        }
+    }
+    return std::sqrt(d2);
+}
+
+
+//------------------------------- CollisionMesh ------------------------------
+
+bool CollisionMesh::LoadSTL(const QString &filename) {
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qDebug() << "Unable to open " << filename;
+        return false;
+    }
+
+    QByteArray data = file.readAll();
+    file.close();
+
+    QVector<double> xyz;
+
+    // Binary STL: 80 bytes header + triangle count + 50 bytes per triangle
+    if (data.size() >= 84) {
+        QDataStream stream(data);
+        stream.setByteOrder(QDataStream::LittleEndian);
+        stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+        stream.skipRawData(80);
+        quint32 ntriangles = 0;
+        stream >> ntriangles;
+        if (84 + 50 * static_cast<qint64>(ntriangles) == data.size()) {
+            xyz.reserve(9 * ntriangles);
+            for (quint32 i = 0; i < ntriangles; i++) {
+                float values[12];
+                for (int k = 0; k < 12; k++) {
+                    stream >> values[k];
+                }
+                quint16 attributes;
+                stream >> attributes;
+
+                // Skip the normal (first 3 values)
+                for (int k = 3; k < 12; k++) {
+                    xyz.append(values[k]);
+                }
+            }
+            setTriangles(xyz);
+            return true;
+        }
+    }
+
+    // ASCII STL: only the vertex lines are relevant
+    QTextStream stream(&data);
+    while (!stream.atEnd()) {
+        QString line = stream.readLine().trimmed();
+        if (!line.startsWith("vertex", Qt::CaseInsensitive)) {
+            continue;
+        }
+        QStringList values = line.split(QRegularExpression("\\s+"));
+        if (values.size() < 4) {
+            return false;
+        }
+        for (int k = 1; k < 4; k++) {
+            xyz.append(values[k].toDouble());
+        }
+    }
+
+    if (xyz.size() % 9 != 0) {
+        return false;
+    }
+    setTriangles(xyz);
+    return true;
+}
+
+
+bool CollisionMesh::setTriangles(const tMatrix2D *trianglePoints) {
+    if (trianglePoints == nullptr) {
+        return false;
+    }
+
+    int nrows = Matrix2D_Get_nrows(trianglePoints);
+    int npoints = Matrix2D_Get_ncols(trianglePoints);
+    if (nrows < 3 || npoints % 3 != 0) {
+        return false;
+    }
+
+    QVector<double> xyz;
+    xyz.reserve(3 * npoints);
+    for (int i = 0; i < npoints; i++) {
+        const double *point = Matrix2D_Get_col(trianglePoints, i);
+        xyz.append(point[0]);
+        xyz.append(point[1]);
+        xyz.append(point[2]);
+    }
+    setTriangles(xyz);
+    return true;
+}
+
+
+void CollisionMesh::setTriangles(const QVector<double> &xyz) {
+    vertices = xyz;
+    vertices.resize(xyz.size() - xyz.size() % 9);
+    build();
+}
+
+
+bool CollisionMesh::updateTriangles(const QVector<double> &xyz) {
+    if (xyz.size() != vertices.size()) {
+        return false;
+    }
+    vertices = xyz;
+    Refit();
+    return true;
+}
+
+
+void CollisionMesh::Bounds(tXYZ center, tXYZ half) const {
+    if (nodes.isEmpty()) {
+        center[0] = center[1] = center[2] = 0.0;
+        half[0] = half[1] = half[2] = 0.0;
+        return;
+    }
+    COPY3(center, nodes[0].center);
+    COPY3(half, nodes[0].half);
+}
+
+
+void CollisionMesh::build() {
+    nodes.clear();
+    order.clear();
+
+    int ntriangles = TriangleCount();
+    if (ntriangles == 0) {
+        return;
+    }
+
+    order.resize(ntriangles);
+    for (int i = 0; i < ntriangles; i++) {
+        order[i] = i;
+    }
+
+    // A binary tree with leaves of LeafSize triangles has less than 2*N/LeafSize+1 nodes
+    nodes.reserve(2 * ntriangles / LeafSize + 2);
+    buildNode(0, ntriangles);
+}
+
+
+int CollisionMesh::buildNode(int first, int count) {
+    int id = nodes.size();
+    node_t node;
+    node.right = -1;
+    node.first = first;
+    node.count = count;
+    fitNode(node);
+    nodes.append(node);
+
+    if (count <= LeafSize) {
+        return id;
+    }
+
+    // Split along the longest axis at the median triangle centroid
+    int axis = 0;
+    if (node.half[1] > node.half[axis]) {
+        axis = 1;
+    }
+    if (node.half[2] > node.half[axis]) {
+        axis = 2;
+    }
+
+    const double *xyz = vertices.constData();
+    auto centroid = [xyz, axis](int tri) {
+        const double *t = xyz + 9 * tri;
+        return t[axis] + t[3 + axis] + t[6 + axis];
+    };
+
+    int half_count = count / 2;
+    int *begin = order.data() + first;
+    std::nth_element(begin, begin + half_count, begin + count, [&centroid](int t1, int t2) {
+        return centroid(t1) < centroid(t2);
+    });
+
+    buildNode(first, half_count);
+    int right = buildNode(first + half_count, count - half_count);
+    nodes[id].right = right;
+    return id;
+}
+
+
+void CollisionMesh::fitNode(node_t &node) const {
+    double pmin[3] = { 1e30, 1e30, 1e30 };
+    double pmax[3] = { -1e30, -1e30, -1e30 };
+    for (int i = node.first; i < node.first + node.count; i++) {
+        const double *t = triangle(order[i]);
+        for (int v = 0; v < 3; v++) {
+            for (int k = 0; k < 3; k++) {
+                pmin[k] = std::min(pmin[k], t[3*v + k]);
+                pmax[k] = std::max(pmax[k], t[3*v + k]);
+            }
+        }
+    }
+    for (int k = 0; k < 3; k++) {
+        node.center[k] = 0.5 * (pmin[k] + pmax[k]);
+        node.half[k] = 0.5 * (pmax[k] - pmin[k]);
+    }
+}
+
+
+void CollisionMesh::Refit() {
+    // Children are always stored after their parent: refit from the leaves up to the root
+    for (int id = nodes.size() - 1; id >= 0; id--) {
+        node_t &node = nodes[id];
+        if (node.right < 0) {
+            fitNode(node);
+            continue;
+        }
+
+        const node_t &left = nodes[id + 1];
+        const node_t &right = nodes[node.right];
+        for (int k = 0; k < 3; k++) {
+            double pmin = std::min(left.center[k] - left.half[k], right.center[k] - right.half[k]);
+            double pmax = std::max(left.center[k] + left.half[k], right.center[k] + right.half[k]);
+            node.center[k] = 0.5 * (pmin + pmax);
+            node.half[k] = 0.5 * (pmax - pmin);
+        }
+    }
+}
+
+
+bool CollisionMesh::Collide(const CollisionMesh &a, const CollisionMesh &b, const Mat &pose_ab) {
+    if (a.isEmpty() || b.isEmpty()) {
+        return false;
+    }
+
+    double rot[3][3];
+    double pos[3];
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            rot[i][j] = pose_ab.Get(i, j);
+        }
+        pos[i] = pose_ab.Get(i, 3);
+    }
+
+    // Depth-first traversal of both hierarchies
+    QVarLengthArray<QPair<int, int>, 128> stack;
+    stack.append(qMakePair(0, 0));
+    while (!stack.isEmpty()) {
+        QPair<int, int> pair = stack.last();
+        stack.removeLast();
+
+        const node_t &na = a.nodes[pair.first];
+        const node_t &nb = b.nodes[pair.second];
+        if (!boxesOverlap(na.center, na.half, nb.center, nb.half, rot, pos)) {
+            continue;
+        }
+
+        bool leaf_a = na.right < 0;
+        bool leaf_b = nb.right < 0;
+        if (leaf_a && leaf_b) {
+            for (int j = nb.first; j < nb.first + nb.count; j++) {
+                // Express the triangle of b in the coordinates of a
+                const double *tb = b.triangle(b.order[j]);
+                double tb_a[9];
+                for (int v = 0; v < 3; v++) {
+                    const double *p = tb + 3*v;
+                    for (int i = 0; i < 3; i++) {
+                        tb_a[3*v + i] = rot[i][0]*p[0] + rot[i][1]*p[1] + rot[i][2]*p[2] + pos[i];
+                    }
+                }
+                for (int i = na.first; i < na.first + na.count; i++) {
+                    if (trianglesOverlap(a.triangle(a.order[i]), tb_a)) {
+                        return true;
+                    }
+                }
+            }
+            continue;
+        }
+
+        // Descend into the largest node (or the only one that is not a leaf)
+        double size_a = na.half[0] + na.half[1] + na.half[2];
+        double size_b = nb.half[0] + nb.half[1] + nb.half[2];
+        if (leaf_b || (!leaf_a && size_a >= size_b)) {
+            stack.append(qMakePair(pair.first + 1, pair.second));
+            stack.append(qMakePair(na.right, pair.second));
+        } else {
+            stack.append(qMakePair(pair.first, pair.second + 1));
+            stack.append(qMakePair(pair.first, nb.right));
+        }
+    }
+    return false;
+}
+
+
+double CollisionMesh::SignedDistance(const tXYZ point, double max_distance) const {
+    if (isEmpty()) {
+        return max_distance;
+    }
+
+    double best = max_distance;
+    double best_alignment = -1.0;
+    double sign = 1.0;
+
+    QVarLengthArray<int, 64> stack;
+    stack.append(0);
+    while (!stack.isEmpty()) {
+        int id = stack.last();
+        stack.removeLast();
+
+        const node_t &node = nodes[id];
+        if (distancePointBox(point, node.center, node.half) > best) {
+            continue;
+        }
+
+        if (node.right >= 0) {
+            // Visit the closest child first (pushed last)
+            const node_t &left = nodes[id + 1];
+            const node_t &right = nodes[node.right];
+            if (distancePointBox(point, left.center, left.half) < distancePointBox(point, right.center, right.half)) {
+                stack.append(node.right);
+                stack.append(id + 1);
+            } else {
+                stack.append(id + 1);
+                stack.append(node.right);
+            }
+            continue;
+        }
+
+        for (int i = node.first; i < node.first + node.count; i++) {
+            const double *tri = triangle(order[i]);
+            double q[3];
+            closestPointTriangle(point, tri, q);
+            double v[3] = { point[0] - q[0], point[1] - q[1], point[2] - q[2] };
+            double dist = NORM(v);
+            if (dist > best + 1e-9) {
+                continue;
+            }
+
+            double e1[3] = { tri[3] - tri[0], tri[4] - tri[1], tri[5] - tri[2] };
+            double e2[3] = { tri[6] - tri[0], tri[7] - tri[1], tri[8] - tri[2] };
+            double normal[3];
+            CROSS(normal, e1, e2);
+            double nnorm = NORM(normal);
+            double alignment = (dist > 1e-12 && nnorm > 1e-12) ? DOT(v, normal) / (dist * nnorm) : 0.0;
+
+            // Closest points on edges and vertices are shared by several triangles:
+            // keep the triangle that faces the point the most to get a consistent sign
+            if (dist < best - 1e-9 || std::fabs(alignment) > best_alignment) {
+                best = std::min(best, dist);
+                best_alignment = std::fabs(alignment);
+                sign = (alignment < 0.0) ? -1.0 : 1.0;
+            }
+        }
+    }
+    return sign * best;
+}
+
+
+QVector<double> CollisionMesh::SamplePoints(int max_points) const {
+    QVector<double> points;
+    int ntriangles = TriangleCount();
+    if (ntriangles == 0 || max_points <= 0) {
+        return points;
+    }
+
+    // 3 vertices and the center of each triangle, decimated to the requested size
+    int available = 4 * ntriangles;
+    double step = std::max(1.0, static_cast<double>(available) / max_points);
+    points.reserve(3 * std::min(available, max_points));
+    for (double s = 0.0; s < available && points.size() < 3 * max_points; s += step) {
+        int id = static_cast<int>(s);
+        const double *tri = triangle(id / 4);
+        int vertex = id % 4;
+        if (vertex < 3) {
+            points.append(tri[3*vertex]);
+            points.append(tri[3*vertex + 1]);
+            points.append(tri[3*vertex + 2]);
+        } else {
+            points.append((tri[0] + tri[3] + tri[6]) / 3.0);
+            points.append((tri[1] + tri[4] + tri[7]) / 3.0);
+            points.append((tri[2] + tri[5] + tri[8]) / 3.0);
+        }
+    }
+    return points;
+}
+
+
+//------------------------------- MeshCollisionEngine ------------------------------
+
+MeshCollisionEngine::MeshCollisionEngine(RoboDK *rdk) : RDK(rdk) {}
+
+
+MeshCollisionEngine::~MeshCollisionEngine() {
+    for (auto *watcher : building) {
+        QObject::disconnect(watcher, nullptr, nullptr, nullptr);
+        watcher->waitForFinished();
+        delete watcher;
+    }
+    building.clear();
+}
+
+
+QSharedPointer<CollisionMesh> MeshCollisionEngine::getMesh(Item item) {
+    auto it = bodies.find(item);
+    if (it != bodies.end() && !it->mesh.isNull()) {
+        return it->mesh;
+    }
+
+    QSharedPointer<CollisionMesh> mesh(new CollisionMesh());
+    if (export_dir.isValid()) {
+        QString filename = export_dir.filePath(QString("item_%1.stl").arg(reinterpret_cast<quintptr>(item)));
+        if (item->Save(filename)) {
+            mesh->LoadSTL(filename);
+        }
+        QFile::remove(filename);
+    }
+
+    if (mesh->isEmpty()) {
+        qDebug() << "Unable to retrieve the geometry of " << item->Name();
+    }
+
+    bodies[item].mesh = mesh;
+    return mesh;
+}
+
+
+void MeshCollisionEngine::setMesh(Item item, const tMatrix2D *trianglePoints) {
+    QSharedPointer<CollisionMesh> mesh(new CollisionMesh());
+    mesh->setTriangles(trianglePoints);
+    body_t &body = bodies[item];
+    body.mesh = mesh;
+    body.field.reset();
+    body.samples.clear();
+    cancelField(item);
+    updateBox(body);
+}
+
+
+void MeshCollisionEngine::removeItem(Item item) {
+    cancelField(item);
+    bodies.remove(item);
+}
+
+
+void MeshCollisionEngine::keepItems(const QList<Item> &items) {
+    for (auto it = bodies.begin(); it != bodies.end(); ) {
+        if (!items.contains(it.key())) {
+            cancelField(it.key());
+            it = bodies.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+
+void MeshCollisionEngine::clear() {
+    for (const Item &item : building.keys()) {
+        cancelField(item);
+    }
+    bodies.clear();
+}
+
+
+void MeshCollisionEngine::updatePoses(const QList<Item> &items) {
+    for (const auto &item : items) {
+        getMesh(item);
+        body_t &body = bodies[item];
+        body.pose = item->PoseAbs();
+        updateBox(body);
+
+        // Distance fields are calculated once: rigid objects only change their pose
+        if (fields_enabled && body.field.isNull() && !building.contains(item)) {
+            buildField(item, body.mesh);
+        }
+    }
+}
+
+
+void MeshCollisionEngine::buildField(Item item, QSharedPointer<CollisionMesh> mesh) {
+    // Calculating a field takes a while for large meshes: the GUI thread keeps running and the field is used once ready
+    auto *watcher = new QFutureWatcher<field_t>();
+    building.insert(item, watcher);
+    QObject::connect(watcher, &QFutureWatcher<field_t>::finished, [this, item, watcher]() {
+        building.remove(item);
+        auto it = bodies.find(item);
+        if (it != bodies.end()) {
+            field_t result = watcher->result();
+            it->field = result.field;
+            it->samples = result.samples;
+        }
+        watcher->deleteLater();
+        if (field_ready) {
+            field_ready();
+        }
+    });
+    watcher->setFuture(QtConcurrent::run([mesh]() {
+        field_t result;
+        result.field.reset(new DistanceField());
+        result.field->Build(*mesh);
+        result.samples = mesh->SamplePoints(MaxSamplePoints);
+        return result;
+    }));
+}
+
+
+void MeshCollisionEngine::cancelField(Item item) {
+    auto *watcher = building.take(item);
+    if (watcher == nullptr) {
+        return;
+    }
+
+    // The calculation can't be interrupted: delete the watcher once it is done, without using the result
+    QObject::disconnect(watcher, nullptr, nullptr, nullptr);
+    QObject::connect(watcher, &QFutureWatcher<field_t>::finished, watcher, &QObject::deleteLater);
+    if (watcher->isFinished()) {
+        watcher->deleteLater();
+    }
+}
+
+
+void MeshCollisionEngine::setDistanceFieldsEnabled(bool enabled) {
+    fields_enabled = enabled;
+}
+
+
+void MeshCollisionEngine::setFieldReadyCallback(std::function<void()> callback) {
+    field_ready = callback;
+}
+
+
+void MeshCollisionEngine::updateBox(body_t &body) {
+    if (body.mesh.isNull() || body.mesh->isEmpty()) {
+        return;
+    }
+
+    tXYZ center;
+    tXYZ half;
+    body.mesh->Bounds(center, half);
+    for (int i = 0; i < 3; i++) {
+        double c = body.pose.Get(i, 0)*center[0] + body.pose.Get(i, 1)*center[1] + body.pose.Get(i, 2)*center[2] + body.pose.Get(i, 3);
+        double h = std::fabs(body.pose.Get(i, 0))*half[0] + std::fabs(body.pose.Get(i, 1))*half[1] + std::fabs(body.pose.Get(i, 2))*half[2];
+        body.box_min[i] = c - h;
+        body.box_max[i] = c + h;
+    }
+}
+
+
+bool MeshCollisionEngine::Collide(Item item1, Item item2) const {
+    auto it1 = bodies.constFind(item1);
+    auto it2 = bodies.constFind(item2);
+    if (it1 == bodies.constEnd() || it2 == bodies.constEnd()) {
+        return false;
+    }
+
+    const body_t &b1 = it1.value();
+    const body_t &b2 = it2.value();
+    if (b1.mesh.isNull() || b2.mesh.isNull() || b1.mesh->isEmpty() || b2.mesh->isEmpty()) {
+        return false;
+    }
+
+    // Broad phase: absolute axis aligned boxes
+    for (int i = 0; i < 3; i++) {
+        if (b1.box_max[i] < b2.box_min[i] || b2.box_max[i] < b1.box_min[i]) {
+            return false;
+        }
+    }
+
+    return CollisionMesh::Collide(*b1.mesh, *b2.mesh, b1.pose.inv() * b2.pose);
+}
+
+
+QVector<bool> MeshCollisionEngine::Collide(const QVector<QPair<Item, Item> > &pairs) const {
+    QVector<bool> results(pairs.size(), false);
+    if (pairs.size() < ParallelThreshold) {
+        for (int i = 0; i < pairs.size(); i++) {
+            results[i] = Collide(pairs[i].first, pairs[i].second);
+        }
+        return results;
+    }
+
+    // Each task writes its own result: no synchronization required
+    QVector<int> indexes(pairs.size());
+    for (int i = 0; i < indexes.size(); i++) {
+        indexes[i] = i;
+    }
+    bool *out = results.data();
+    QtConcurrent::blockingMap(indexes, [this, &pairs, out](int i) {
+        out[i] = Collide(pairs[i].first, pairs[i].second);
+    });
+    return results;
+}
+
+
+double MeshCollisionEngine::Distance(Item item1, Item item2) const {
+    auto it1 = bodies.constFind(item1);
+    auto it2 = bodies.constFind(item2);
+    if (it1 == bodies.constEnd() || it2 == bodies.constEnd()) {
+        return 1e30;
+    }
+
+    const body_t &b1 = it1.value();
+    const body_t &b2 = it2.value();
+    if (b1.samples.isEmpty() || b2.field.isNull() || b2.field->isEmpty()) {
+        return 1e30;
+    }
+
+    // Surface points of item1 in the coordinates of item2
+    Mat pose = b2.pose.inv() * b1.pose;
+    double rot[3][3];
+    double pos[3];
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            rot[i][j] = pose.Get(i, j);
+        }
+        pos[i] = pose.Get(i, 3);
+    }
+
+    int npoints = b1.samples.size() / 3;
+    QVarLengthArray<double, MaxSamplePoints * 3> transformed(npoints * 3);
+    QVarLengthArray<double, MaxSamplePoints> estimated(npoints);
+    double best = 1e30;
+    const double *points = b1.samples.constData();
+    for (int n = 0; n < npoints; n++) {
+        const double *p = points + 3 * n;
+        double *q = transformed.data() + 3 * n;
+        for (int i = 0; i < 3; i++) {
+            q[i] = rot[i][0]*p[0] + rot[i][1]*p[1] + rot[i][2]*p[2] + pos[i];
+        }
+        estimated[n] = b2.field->Distance(q);
+        best = std::min(best, estimated[n]);
+    }
+
+    // The distance changes at most by the distance travelled, so an interpolated value differs from the exact distance by at most the diagonal of its cell
+    // (a brick in the coarse grid). Only the points that can be the closest are refined with the exact distance to the triangles.
+    double error = std::sqrt(3.0) * b2.field->VoxelSize() * DistanceField::BrickSize;
+    double exact = best + error;
+    for (int n = 0; n < npoints; n++) {
+        if (estimated[n] <= best + 2.0 * error) {
+            exact = std::min(exact, b2.mesh->SignedDistance(transformed.data() + 3 * n, exact));
+        }
+    }
+    return exact;
+}
+
+
+QVector<double> MeshCollisionEngine::Distance(const QVector<QPair<Item, Item> > &pairs) const {
+    QVector<double> results(pairs.size(), 1e30);
+    if (pairs.size() < ParallelThreshold) {
+        for (int i = 0; i < pairs.size(); i++) {
+            results[i] = Distance(pairs[i].first, pairs[i].second);
+        }
+        return results;
+    }
+
+    QVector<int> indexes(pairs.size());
+    for (int i = 0; i < indexes.size(); i++) {
+        indexes[i] = i;
+    }
+    double *out = results.data();
+    QtConcurrent::blockingMap(indexes, [this, &pairs, out](int i) {
+        out[i] = Distance(pairs[i].first, pairs[i].second);
+    });
+    return results;
+}
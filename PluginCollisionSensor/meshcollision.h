@@ -0,0 +1,218 @@
+#ifndef MESHCOLLISION_H
+#define MESHCOLLISION_H
+
+
+#include <QVector>
+#include <QHash>
+#include <QPair>
+#include <QList>
+#include <QString>
+#include <QSharedPointer>
+#include <QTemporaryDir>
+#include <QFutureWatcher>
+#include "robodktypes.h"
+
+#include <functional>
+
+
+class DistanceField;
+
+
+///
+/// \brief The CollisionMesh class holds the triangles of an object and a bounding volume hierarchy (BVH) built in the object coordinates.
+/// Each node of the hierarchy is an axis aligned box in the object coordinates. Once the object pose is applied, each node becomes an oriented bounding box (OBB).
+/// Rigid objects never need to rebuild the hierarchy: moving an object only changes the pose used to compare two meshes.
+///
+class CollisionMesh
+{
+public:
+    /// Maximum number of triangles stored in a leaf of the hierarchy.
+    static const int LeafSize = 4;
+
+    /// Load an STL file (binary or ASCII), such as the file exported by IItem::Save. Coordinates are in mm, with respect to the object reference.
+    bool LoadSTL(const QString &filename);
+
+    /// Set the triangles given a list of points (same format as IRoboDK::AddShape: 3 consecutive points define a triangle, 3 or 6 rows per point).
+    bool setTriangles(const tMatrix2D *trianglePoints);
+
+    /// Set the triangles given a flat list of coordinates (9 values per triangle).
+    void setTriangles(const QVector<double> &xyz);
+
+    /// Update the vertices of the mesh (same number of triangles) and refit the hierarchy without rebuilding it.
+    bool updateTriangles(const QVector<double> &xyz);
+
+    /// Recalculate the bounds of the hierarchy, keeping the tree structure. Call this after the vertices changed.
+    void Refit();
+
+    /// Number of triangles
+    int TriangleCount() const { return vertices.size() / 9; }
+
+    /// Returns true if the mesh has no triangles.
+    bool isEmpty() const { return nodes.isEmpty(); }
+
+    /// \brief Get the bounding box of the mesh in the object coordinates.
+    /// \param center Center of the box (mm)
+    /// \param half Half size of the box along each axis (mm)
+    void Bounds(tXYZ center, tXYZ half) const;
+
+    /// \brief Check if two meshes collide.
+    /// \param a First mesh
+    /// \param b Second mesh
+    /// \param pose_ab Pose of mesh b with respect to mesh a
+    /// \return true if at least one pair of triangles intersect
+    static bool Collide(const CollisionMesh &a, const CollisionMesh &b, const Mat &pose_ab);
+
+    /// \brief Calculate the distance from a point to the surface of the mesh.
+    /// The sign is given by the normal of the closest triangle (negative inside a closed mesh).
+    /// \param point Point in the object coordinates (mm)
+    /// \param max_distance Surfaces further than this distance are ignored (max_distance is returned if nothing is closer)
+    /// \return Signed distance in mm
+    double SignedDistance(const tXYZ point, double max_distance = 1e30) const;
+
+    /// Retrieve up to max_points points on the surface (vertices and triangle centers), in the object coordinates. 3 values per point.
+    QVector<double> SamplePoints(int max_points) const;
+
+private:
+    struct node_t
+    {
+        /// Box center in the object coordinates
+        double center[3];
+
+        /// Box half size along each axis
+        double half[3];
+
+        /// Index of the second child (the first child always follows its parent), -1 for leaves
+        int right;
+
+        /// First triangle in the triangle order list
+        int first;
+
+        /// Number of triangles in this node
+        int count;
+    };
+
+    void build();
+    int buildNode(int first, int count);
+    void fitNode(node_t &node) const;
+    const double *triangle(int id) const { return vertices.constData() + 9 * id; }
+
+    /// Triangle vertices, 9 values per triangle
+    QVector<double> vertices;
+
+    /// Triangle indexes, sorted so that each node refers to a continuous range
+    QVector<int> order;
+
+    /// Hierarchy nodes, in depth-first order (the root is the first node)
+    QVector<node_t> nodes;
+};
+
+
+///
+/// \brief The MeshCollisionEngine class performs collision checks inside the plugin instead of calling IRoboDK::Collision for each pair.
+/// The geometry of each object is retrieved once (exported to STL using IItem::Save or given explicitly), and the absolute pose of each item is cached when it moves.
+/// Pair queries are then evaluated in parallel using the global thread pool and never call the RoboDK API from a worker thread.
+///
+class MeshCollisionEngine
+{
+public:
+    MeshCollisionEngine(RoboDK *rdk);
+    ~MeshCollisionEngine();
+
+    /// Minimum number of pairs to run a batch in parallel (smaller batches are checked in the calling thread).
+    static const int ParallelThreshold = 8;
+
+    /// Maximum number of surface points of an item used for distance queries.
+    static const int MaxSamplePoints = 256;
+
+    /// Retrieve the mesh of an object, exporting its geometry the first time. Must be called from the GUI thread.
+    QSharedPointer<CollisionMesh> getMesh(Item item);
+
+    /// Set the mesh of an item explicitly (for example, the same triangles passed to IRoboDK::AddShape).
+    void setMesh(Item item, const tMatrix2D *trianglePoints);
+
+    /// Forget an item (for example, when it is deleted).
+    void removeItem(Item item);
+
+    /// Forget all items that are not in the list (for example, after the station changed).
+    void keepItems(const QList<Item> &items);
+
+    /// Remove all cached geometry.
+    void clear();
+
+    /// Update the cached absolute pose of the given items. Meshes are loaded if required. Must be called from the GUI thread.
+    void updatePoses(const QList<Item> &items);
+
+    /// Check collision between two items using the cached poses.
+    bool Collide(Item item1, Item item2) const;
+
+    /// Check collision for a list of item pairs using the cached poses. Pairs are checked in parallel. Returns one result per pair.
+    QVector<bool> Collide(const QVector<QPair<Item, Item> > &pairs) const;
+
+    /// Enable or disable distance queries. When enabled, the distance field of each item is calculated once, in the background, when updatePoses first sees the item.
+    void setDistanceFieldsEnabled(bool enabled);
+
+    /// Function called (GUI thread) when a distance field calculated in the background is ready. Distances to the item are only available from that moment.
+    void setFieldReadyCallback(std::function<void()> callback);
+
+    /// \brief Calculate the minimum distance between two items using the cached poses.
+    /// The surface points of item1 are transformed into the distance field of item2, the cost depends on the number of points only.
+    /// The points closest to item2 according to the field are then refined with the exact distance to the triangles of item2,
+    /// so the result is the exact distance from the closest surface point of item1. The true minimum can be between surface points:
+    /// the result is larger by at most the distance from the closest point of item1 to its nearest surface point (see MaxSamplePoints).
+    /// \return Signed distance in mm (negative if item1 penetrates item2), or 1e30 if the geometry or the distance field is not available yet
+    double Distance(Item item1, Item item2) const;
+
+    /// Calculate the distance for a list of item pairs using the cached poses. Pairs are calculated in parallel. Returns one result per pair.
+    QVector<double> Distance(const QVector<QPair<Item, Item> > &pairs) const;
+
+private:
+    struct body_t
+    {
+        QSharedPointer<CollisionMesh> mesh;
+
+        /// Distance field (only calculated if distance queries are enabled)
+        QSharedPointer<DistanceField> field;
+
+        /// Surface points used for distance queries
+        QVector<double> samples;
+
+        /// Absolute pose of the item
+        Mat pose;
+
+        /// Axis aligned box in absolute coordinates (broad phase)
+        double box_min[3] { 0, 0, 0 };
+        double box_max[3] { 0, 0, 0 };
+    };
+
+    void updateBox(body_t &body);
+
+    /// Distance field and surface points of an item, calculated in the background
+    struct field_t
+    {
+        QSharedPointer<DistanceField> field;
+        QVector<double> samples;
+    };
+
+    /// Start calculating the distance field of an item in the background
+    void buildField(Item item, QSharedPointer<CollisionMesh> mesh);
+
+    /// Ignore the distance field being calculated for an item (the mesh changed or the item was removed)
+    void cancelField(Item item);
+
+    RoboDK *RDK { nullptr };
+
+    /// Folder used to export object geometry
+    QTemporaryDir export_dir;
+
+    QHash<Item, body_t> bodies;
+
+    bool fields_enabled { false };
+
+    /// Distance fields being calculated
+    QHash<Item, QFutureWatcher<field_t>*> building;
+
+    std::function<void()> field_ready;
+};
+
+
+#endif // MESHCOLLISION_H
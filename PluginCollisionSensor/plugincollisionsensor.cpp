@@ -12,11 +12,18 @@
 #include <QList>
 
 #include "plugincollisionsensor.h"
+#include "meshcollision.h"
 
 #include "robodk_interface.h"
 #include "iitem.h"
 
 
+/// Hash of an absolute pose, used to detect items that moved between two updates
+static uint poseHash(const Mat &pose) {
+    return qHashBits(pose.constData(), 16 * sizeof(float));
+}
+
+
 //------------------------------- RoboDK Plug-in commands ------------------------------
 
 PluginCollisionSensor::PluginCollisionSensor() {}
@@ -32,6 +39,13 @@ QString PluginCollisionSensor::PluginLoad(QMainWindow *mw, QMenuBar *menubar, QS
     MainWindow = mw;
     StatusBar = statusbar;
 
+    collision_engine = new MeshCollisionEngine(RDK);
+    collision_engine->setFieldReadyCallback([this]() {
+        // Evaluate the proximity sensors again now that the distance is available
+        objects_dirty = true;
+        RDK->Render();
+    });
+
     qDebug() << "Loading plugin " << PluginName();
     qDebug() << "Using settings: " << settings; // reserved for future compatibility
 
@@ -43,8 +57,12 @@ QString PluginCollisionSensor::PluginLoad(QMainWindow *mw, QMenuBar *menubar, QS
     action_set_as_sensor = new QAction(tr("Set as sensor"));
     action_set_as_sensor->setCheckable(true);
 
+    action_set_as_proximity_sensor = new QAction(tr("Set as proximity sensor"));
+    action_set_as_proximity_sensor->setCheckable(true);
+
     // Make sure to connect the action to your callback (slot)
     connect(action_set_as_sensor, SIGNAL(triggered(bool)), this, SLOT(callback_set_as_sensor(bool)));
+    connect(action_set_as_proximity_sensor, SIGNAL(triggered(bool)), this, SLOT(callback_set_as_proximity_sensor(bool)));
 
     // return string is reserverd for future compatibility
     return "";
@@ -56,12 +74,24 @@ void PluginCollisionSensor::PluginUnload() {
     qDebug() << "Unloading plugin " << PluginName();
 
     sensors.clear();
+    objects.clear();
+    pose_hashes.clear();
+    motion_pending = false;
+    objects_dirty = true;
     last_clicked_item = nullptr;
 
+    delete collision_engine;
+    collision_engine = nullptr;
+
     if (nullptr != action_set_as_sensor) {
         action_set_as_sensor->deleteLater();
         action_set_as_sensor = nullptr;
     }
+
+    if (nullptr != action_set_as_proximity_sensor) {
+        action_set_as_proximity_sensor->deleteLater();
+        action_set_as_proximity_sensor = nullptr;
+    }
 }
 
 
@@ -78,9 +108,11 @@ bool PluginCollisionSensor::PluginItemClick(Item item, QMenu *menu, TypeClick cl
         last_clicked_item = item;
 
         bool active = false;
+        bool active_proximity = false;
         for (const auto &sensor : sensors) {
             if (sensor.sensor == last_clicked_item) {
-                active = true;
+                active = (sensor.type == SENSOR_CONTACT);
+                active_proximity = (sensor.type == SENSOR_PROXIMITY);
                 break;
             }
         }
@@ -92,6 +124,11 @@ bool PluginCollisionSensor::PluginItemClick(Item item, QMenu *menu, TypeClick cl
         action_set_as_sensor->blockSignals(false);
         menu->addAction(action_set_as_sensor);
 
+        action_set_as_proximity_sensor->blockSignals(true);
+        action_set_as_proximity_sensor->setChecked(active_proximity);
+        action_set_as_proximity_sensor->blockSignals(false);
+        menu->addAction(action_set_as_proximity_sensor);
+
         return true;
     }
 
@@ -102,15 +139,41 @@ bool PluginCollisionSensor::PluginItemClick(Item item, QMenu *menu, TypeClick cl
 QString PluginCollisionSensor::PluginCommand(const QString &command, const QString &value) {
 
     // Expected format: "Activate", "Sensor Item.Name() or Python's Item.item pointer"
-    //                  "Deactivate", "Sensor Item.Name() or Python's Item.item pointer"
+    //                  "Deactivate", "Sensor Item.Name() or Python's Item.item pointer" (contact or proximity sensor)
+    //                  "ActivateProximity", "Sensor Item.Name() or Python's Item.item pointer"
+    //                  "DeactivateProximity", "Sensor Item.Name() or Python's Item.item pointer"
+    //                  "Engine", "RoboDK" or "Builtin"
+
+    if (command.compare("Engine", Qt::CaseInsensitive) == 0) {
+        if (value.compare("Builtin", Qt::CaseInsensitive) == 0) {
+            use_builtin_engine = true;
+        } else if (value.compare("RoboDK", Qt::CaseInsensitive) == 0) {
+            use_builtin_engine = false;
+            collision_engine->clear();
+        } else {
+            return use_builtin_engine ? "Builtin" : "RoboDK";
+        }
+
+        // Poses must be cached again by the selected engine
+        objects_dirty = true;
+        return "OK";
+    }
 
     last_clicked_item = nullptr;
 
     bool activate = true;
+    int type = SENSOR_CONTACT;
     if (command.compare("Activate", Qt::CaseInsensitive) == 0) {
         activate = true;
     } else if (command.compare("Deactivate", Qt::CaseInsensitive) == 0) {
         activate = false;
+        type = SENSOR_ANY;
+    } else if (command.compare("ActivateProximity", Qt::CaseInsensitive) == 0) {
+        activate = true;
+        type = SENSOR_PROXIMITY;
+    } else if (command.compare("DeactivateProximity", Qt::CaseInsensitive) == 0) {
+        activate = false;
+        type = SENSOR_PROXIMITY;
     } else {
         return "Unknown Command";
     }
@@ -137,7 +200,7 @@ QString PluginCollisionSensor::PluginCommand(const QString &command, const QStri
     }
 
     last_clicked_item = candidate;
-    callback_set_as_sensor(activate);
+    setSensor(candidate, type, activate);
     return "OK";
 }
 
@@ -148,9 +211,15 @@ void PluginCollisionSensor::PluginEvent(TypeEvent event_type) {
     case EventChanged:
     {
         cleanupRemovedItems();
+        objects_dirty = true;
         break;
     }
+    case EventMoved:
+    case EventTrajectoryStep:
+        motion_pending = true;
+        break;
     case EventRender:
+        // Render events are also triggered by camera moves: only evaluate sensors if something moved
         updateSensors();
         break;
     default:
@@ -162,26 +231,47 @@ void PluginCollisionSensor::PluginEvent(TypeEvent event_type) {
 //------------------------------- Plug-in commands ------------------------------
 
 void PluginCollisionSensor::callback_set_as_sensor(bool activate) {
-    if (last_clicked_item == nullptr) {
+    setSensor(last_clicked_item, SENSOR_CONTACT, activate);
+}
+
+
+void PluginCollisionSensor::callback_set_as_proximity_sensor(bool activate) {
+    setSensor(last_clicked_item, SENSOR_PROXIMITY, activate);
+}
+
+
+void PluginCollisionSensor::setSensor(Item item, int type, bool activate) {
+    if (item == nullptr) {
         return;
     }
 
+    // An item can only be one type of sensor: remove the previous one
+    QMutableListIterator<sensor_t> i(sensors);
+    while (i.hasNext()) {
+        const sensor_t &sensor = i.next();
+        if (sensor.sensor == item && (activate || type == SENSOR_ANY || sensor.type == type)) {
+            i.remove();
+        }
+    }
+
     // Request to deactivate
     if (!activate) {
-        QMutableListIterator<sensor_t> i(sensors);
-        while (i.hasNext()) {
-            if (i.next().sensor == last_clicked_item) {
-                i.remove();
-            }
-        }
         return;
     }
 
     // Request to activate
     sensor_t sensor;
-    sensor.sensor = last_clicked_item;
+    sensor.sensor = item;
     sensor.station = RDK->getActiveStation();
+    sensor.type = type;
     sensors.append(sensor);
+
+    // Force the evaluation of the new sensor on the next render
+    motion_pending = true;
+    if (type == SENSOR_PROXIMITY) {
+        // Distance fields and poses of all objects are required
+        objects_dirty = true;
+    }
 }
 
 
@@ -203,26 +293,207 @@ bool PluginCollisionSensor::processItem(Item item) {
 
 void PluginCollisionSensor::updateSensors() {
 
-    QList<Item> objects = RDK->getItemList(IItem::ITEM_TYPE_OBJECT);
+    if (sensors.empty()) {
+        motion_pending = false;
+        return;
+    }
 
-    for (const auto &sensor : sensors) {
-        QString status = "0";
-        for (const auto &object : objects) {
-            if (sensor.sensor == object) {
+    if (!motion_pending && !objects_dirty) {
+        return;
+    }
+
+    bool full_update = objects_dirty;
+    if (objects_dirty) {
+        objects = RDK->getItemList(IItem::ITEM_TYPE_OBJECT);
+        pose_hashes.clear();
+        objects_dirty = false;
+    }
+    motion_pending = false;
+
+    // Find the objects that actually moved since the last update
+    QList<Item> moved;
+    for (const auto &object : objects) {
+        uint hash = poseHash(object->PoseAbs());
+        auto it = pose_hashes.find(object);
+        if (it == pose_hashes.end() || it.value() != hash) {
+            pose_hashes[object] = hash;
+            moved.append(object);
+        }
+    }
+
+    Item station = RDK->getActiveStation();
+    bool proximity = hasProximitySensors(station);
+    if (use_builtin_engine || proximity) {
+        collision_engine->setDistanceFieldsEnabled(proximity);
+        if (full_update) {
+            collision_engine->keepItems(objects);
+        }
+        collision_engine->updatePoses(moved);
+    }
+
+    // Select the objects to check for each sensor
+    QList<sensor_query_t> queries;
+    QList<sensor_query_t> proximity_queries;
+    for (auto &sensor : sensors) {
+        if (sensor.station != station) {
+            continue;
+        }
+
+        sensor_query_t query;
+        query.sensor = &sensor;
+        if (sensor.type == SENSOR_PROXIMITY) {
+            // Distances change when anything moves: only the distances to the objects that moved are updated
+            if (full_update || sensor.status < 0 || moved.contains(sensor.sensor)) {
+                sensor.distances.clear();
+                query.candidates = &objects;
+            } else if (!moved.empty()) {
+                query.candidates = &moved;
+            } else {
                 continue;
             }
+            proximity_queries.append(query);
+            continue;
+        }
 
-            if (RDK->Collision(sensor.sensor, object)) {
-                qDebug() << sensor.sensor->Name() << " is sensing " << object->Name();
-                status = "1";
-                break;
+        if (full_update || sensor.status < 0 || moved.contains(sensor.sensor)
+                || (sensor.status == 1 && moved.contains(sensor.sensed))) {
+            // The sensor moved (or its trigger moved away): check against all objects
+            query.candidates = &objects;
+        } else if (sensor.status == 1) {
+            // The object triggering the sensor did not move: the status can't change
+            continue;
+        } else if (!moved.empty()) {
+            // Only objects that moved can trigger a sensor that did not move
+            query.candidates = &moved;
+        } else {
+            continue;
+        }
+        queries.append(query);
+    }
+
+    if (!proximity_queries.empty()) {
+        updateProximitySensors(proximity_queries);
+    }
+
+    if (use_builtin_engine) {
+        findSensedObjectsBuiltin(queries);
+    } else {
+        for (auto &query : queries) {
+            query.sensed = findSensedObject(query.sensor->sensor, *query.candidates);
+        }
+    }
+
+    for (const auto &query : queries) {
+        sensor_t &sensor = *query.sensor;
+        sensor.sensed = query.sensed;
+        int status = (query.sensed != nullptr) ? 1 : 0;
+        if (status != sensor.status) {
+            sensor.status = status;
+            RDK->setParam(sensor.sensor->Name(), status == 1 ? "1" : "0");
+        }
+    }
+}
+
+
+Item PluginCollisionSensor::findSensedObject(Item sensor, const QList<Item> &candidates) {
+    for (const auto &object : candidates) {
+        if (sensor == object) {
+            continue;
+        }
+
+        if (RDK->Collision(sensor, object)) {
+            qDebug() << sensor->Name() << " is sensing " << object->Name();
+            return object;
+        }
+    }
+    return nullptr;
+}
+
+
+void PluginCollisionSensor::findSensedObjectsBuiltin(QList<sensor_query_t> &queries) {
+    // Check all sensor/object pairs in one parallel batch
+    QVector<QPair<Item, Item> > pairs;
+    for (const auto &query : queries) {
+        for (const auto &object : *query.candidates) {
+            if (object != query.sensor->sensor) {
+                pairs.append(qMakePair(query.sensor->sensor, object));
+            }
+        }
+    }
+
+    QVector<bool> results = collision_engine->Collide(pairs);
+
+    // Pairs are in the same order as the queries: keep the first object sensed by each sensor
+    int id = 0;
+    for (auto &query : queries) {
+        query.sensed = nullptr;
+        for (const auto &object : *query.candidates) {
+            if (object == query.sensor->sensor) {
+                continue;
+            }
+            if (results[id++] && query.sensed == nullptr) {
+                query.sensed = object;
+                qDebug() << query.sensor->sensor->Name() << " is sensing " << object->Name();
+            }
+        }
+    }
+}
+
+
+void PluginCollisionSensor::updateProximitySensors(const QList<sensor_query_t> &queries) {
+    QVector<QPair<Item, Item> > pairs;
+    for (const auto &query : queries) {
+        for (const auto &object : *query.candidates) {
+            if (object != query.sensor->sensor) {
+                pairs.append(qMakePair(query.sensor->sensor, object));
+            }
+        }
+    }
+
+    // Each distance only depends on the number of surface points of the sensor
+    QVector<double> distances = collision_engine->Distance(pairs);
+
+    int id = 0;
+    for (const auto &query : queries) {
+        sensor_t &sensor = *query.sensor;
+        for (const auto &object : *query.candidates) {
+            if (object != sensor.sensor) {
+                sensor.distances[object] = distances[id++];
             }
         }
-        RDK->setParam(sensor.sensor->Name(), status);
+
+        double distance = 1e30;
+        Item closest = nullptr;
+        for (auto it = sensor.distances.constBegin(); it != sensor.distances.constEnd(); ++it) {
+            if (it.value() < distance) {
+                distance = it.value();
+                closest = it.key();
+            }
+        }
+
+        sensor.sensed = closest;
+        sensor.status = (distance <= 0.0) ? 1 : 0;
+
+        // Publish the distance in mm (-1 if there is no object to measure)
+        QString value = (closest == nullptr) ? QString("-1") : QString::number(distance, 'f', 1);
+        if (value != sensor.published) {
+            sensor.published = value;
+            RDK->setParam(sensor.sensor->Name(), value);
+        }
     }
 }
 
 
+bool PluginCollisionSensor::hasProximitySensors(Item station) const {
+    for (const auto &sensor : sensors) {
+        if (sensor.type == SENSOR_PROXIMITY && sensor.station == station) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
 void PluginCollisionSensor::cleanupRemovedItems() {
 
     if (sensors.empty()) {
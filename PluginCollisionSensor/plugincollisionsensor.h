@@ -5,6 +5,7 @@
 #include <QObject>
 #include <QtPlugin>
 #include <QDockWidget>
+#include <QHash>
 #include "iapprobodk.h"
 #include "robodktypes.h"
 
@@ -14,6 +15,7 @@ class QMenu;
 class QAction;
 class IRoboDK;
 class IItem;
+class MeshCollisionEngine;
 
 
 ///
@@ -56,30 +58,104 @@ public slots:
     /// Callback to set the lact clicked Item as a Sensor
     void callback_set_as_sensor(bool active);
 
+    /// Callback to set the lact clicked Item as a Proximity Sensor
+    void callback_set_as_proximity_sensor(bool active);
+
 public:
 
     /// Process/validates an item candidate. Returns true if it succeeds, else false.
     bool processItem(Item item);
 
+    /// Activate or deactivate a sensor. An item can only be one type of sensor. Use SENSOR_ANY to deactivate a sensor of any type.
+    void setSensor(Item item, int type, bool activate);
+
     /// Remove deleted or invalid Items
     void cleanupRemovedItems();
 
-    /// Update sensor statuses
+    /// Update sensor statuses. Only sensors affected by a motion since the last update are re-evaluated.
     void updateSensors();
 
+    /// Returns the first object of the list colliding with the sensor, or nullptr if none.
+    Item findSensedObject(Item sensor, const QList<Item> &candidates);
+
 private:
 
     /// Action to set the selected Item as a Sensor
     QAction *action_set_as_sensor { nullptr };
 
+    /// Action to set the selected Item as a Proximity Sensor
+    QAction *action_set_as_proximity_sensor { nullptr };
+
+    /// Sensor types
+    enum {
+        /// Any type of sensor (to deactivate a sensor)
+        SENSOR_ANY = -1,
+
+        /// Contact sensor: the station parameter is 1 if the sensor collides with an object, 0 otherwise
+        SENSOR_CONTACT = 0,
+
+        /// Proximity sensor: the station parameter is the minimum distance to the closest object, in mm
+        SENSOR_PROXIMITY = 1
+    };
+
     struct sensor_t
     {
         Item sensor { nullptr };
         Item station { nullptr };
+
+        /// Sensor type (SENSOR_CONTACT or SENSOR_PROXIMITY)
+        int type { SENSOR_CONTACT };
+
+        /// Last status published to the station parameter (-1 if not yet evaluated)
+        int status { -1 };
+
+        /// Object that triggered the sensor during the last evaluation
+        Item sensed { nullptr };
+
+        /// Proximity sensors: last distance to each object (mm)
+        QHash<Item, double> distances;
+
+        /// Proximity sensors: last value published to the station parameter
+        QString published;
     };
 
     QList<sensor_t> sensors;
 
+    /// Objects to check for one sensor, and the result
+    struct sensor_query_t
+    {
+        sensor_t *sensor { nullptr };
+        const QList<Item> *candidates { nullptr };
+        Item sensed { nullptr };
+    };
+
+    /// Find the objects sensed by each sensor using the built-in collision engine (all pairs are checked in parallel)
+    void findSensedObjectsBuiltin(QList<sensor_query_t> &queries);
+
+    /// Update the distances of the proximity sensors (all pairs are calculated in parallel)
+    void updateProximitySensors(const QList<sensor_query_t> &queries);
+
+    /// Returns true if at least one proximity sensor is active in the station
+    bool hasProximitySensors(Item station) const;
+
+    /// Objects of the active station that can trigger a sensor (refreshed when the station changes)
+    QList<Item> objects;
+
+    /// Pose hash of each object, used to detect which objects actually moved
+    QHash<Item, uint> pose_hashes;
+
+    /// Something moved since the last update (EventMoved or EventTrajectoryStep)
+    bool motion_pending { false };
+
+    /// The station changed, the object list must be refreshed and all sensors re-evaluated
+    bool objects_dirty { true };
+
+    /// Collision engine used instead of IRoboDK::Collision when use_builtin_engine is set
+    MeshCollisionEngine *collision_engine { nullptr };
+
+    /// Use the built-in mesh collision engine (set with the "Engine" plugin command)
+    bool use_builtin_engine { false };
+
     Item last_clicked_item { nullptr };
 
 };
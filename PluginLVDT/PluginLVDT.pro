@@ -84,9 +84,11 @@ CONFIG(release, debug|release) {
 
 
 HEADERS += \
+    gaugeacquisition.h \
     pluginlvdt.h
 
 SOURCES += \
+    gaugeacquisition.cpp \
     pluginlvdt.cpp 
 
 
@@ -0,0 +1,223 @@
+#include "gaugeacquisition.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QDataStream>
+#include <QDebug>
+
+#include <cmath>
+#include <chrono>
+
+
+GaugeAcquisition::GaugeAcquisition() : generator(std::random_device()()) {
+}
+
+
+GaugeAcquisition::~GaugeAcquisition(){
+    Stop();
+}
+
+
+bool GaugeAcquisition::Start(const QStringList &channels, const QString &filename){
+    Stop();
+
+    channel_names = channels;
+    file_name = filename;
+    binary = !filename.isEmpty() && QFileInfo(filename).suffix().compare("csv", Qt::CaseInsensitive) != 0;
+
+    has_previous = false;
+    previous_values.clear();
+    last_values.fill(0.0, channels.size());
+    last_sample_time = 0.0;
+    sample_count = 0;
+    dropped_count = 0;
+
+    if (!file_name.isEmpty()){
+        // Make sure the file can be created before starting the writer
+        QFile file(file_name);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)){
+            qDebug() << "Unable to create acquisition file: " << file_name;
+            return false;
+        }
+        file.close();
+
+        ring.resize(DefaultCapacity);
+        ring_mask = DefaultCapacity - 1;
+        ring_head = 0;
+        ring_tail = 0;
+        writer_stop = false;
+        writer = std::thread(&GaugeAcquisition::writerLoop, this);
+    }
+
+    running = true;
+    qDebug() << "Gage acquisition started: " << channels.size() << " channels at " << rate << " Hz";
+    return true;
+}
+
+
+void GaugeAcquisition::Stop(){
+    if (!running){
+        return;
+    }
+    running = false;
+
+    if (writer.joinable()){
+        writer_stop = true;
+        writer.join();
+    }
+    ring.clear();
+    ring.squeeze();
+
+    qDebug() << "Gage acquisition stopped: " << sample_count << " samples (" << dropped_count << " dropped)";
+}
+
+
+void GaugeAcquisition::setRate(double rate_hz){
+    if (rate_hz > 0.0){
+        rate = rate_hz;
+    }
+}
+
+
+double GaugeAcquisition::LastValue(int channel) const {
+    if (channel < 0 || channel >= last_values.size()){
+        return 0.0;
+    }
+    return last_values[channel];
+}
+
+
+void GaugeAcquisition::addValues(double time, const QVector<double> &values){
+    if (!running || values.size() != channel_names.size()){
+        return;
+    }
+
+    double period = 1.0 / rate;
+    if (!has_previous || time < previous_time || (time - previous_time) > MaxSamplesPerStep * period){
+        // First reading, or the simulation was reset: sample the current values
+        addSample(time, values.constData());
+        next_sample_time = time + period;
+    } else {
+        // Generate the samples between the previous and the current reading
+        QVector<double> interpolated(values.size());
+        double step = time - previous_time;
+        while (next_sample_time <= time){
+            double alpha = (step > 0.0) ? (next_sample_time - previous_time) / step : 1.0;
+            for (int i = 0; i < values.size(); i++){
+                interpolated[i] = previous_values[i] + alpha * (values[i] - previous_values[i]);
+            }
+            addSample(next_sample_time, interpolated.constData());
+            next_sample_time += period;
+        }
+    }
+
+    has_previous = true;
+    previous_time = time;
+    previous_values = values;
+}
+
+
+double GaugeAcquisition::applyModel(double value){
+    if (noise > 0.0){
+        value += noise * distribution(generator);
+    }
+    if (resolution > 0.0){
+        value = std::round(value / resolution) * resolution;
+    }
+    return value;
+}
+
+
+void GaugeAcquisition::addSample(double time, const double *values){
+    int nchannels = channel_names.size();
+    for (int i = 0; i < nchannels; i++){
+        last_values[i] = applyModel(values[i]);
+    }
+    last_sample_time = time;
+    sample_count++;
+
+    if (ring.isEmpty()){
+        return;
+    }
+
+    // Push a complete frame or nothing, so the writer always reads complete samples
+    size_t frame_size = nchannels + 1;
+    size_t head = ring_head.load(std::memory_order_relaxed);
+    size_t tail = ring_tail.load(std::memory_order_acquire);
+    if (static_cast<size_t>(ring.size()) - (head - tail) < frame_size){
+        dropped_count++;
+        return;
+    }
+
+    double *data = ring.data();
+    data[head & ring_mask] = time;
+    for (int i = 0; i < nchannels; i++){
+        data[(head + 1 + i) & ring_mask] = last_values[i];
+    }
+    ring_head.store(head + frame_size, std::memory_order_release);
+}
+
+
+void GaugeAcquisition::writerLoop(){
+    QFile file(file_name);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)){
+        return;
+    }
+
+    int nchannels = channel_names.size();
+    size_t frame_size = nchannels + 1;
+
+    QDataStream binary_stream(&file);
+    binary_stream.setByteOrder(QDataStream::LittleEndian);
+    binary_stream.setFloatingPointPrecision(QDataStream::DoublePrecision);
+    QTextStream text_stream(&file);
+
+    if (binary){
+        file.write("RDKGAGE1", 8);
+        binary_stream << static_cast<quint32>(nchannels);
+        for (const auto &name : channel_names){
+            QByteArray utf8 = name.toUtf8();
+            binary_stream << static_cast<quint16>(utf8.size());
+            binary_stream.writeRawData(utf8.constData(), utf8.size());
+        }
+    } else {
+        text_stream << "time_s";
+        for (const auto &name : channel_names){
+            text_stream << "," << name;
+        }
+        text_stream << "\n";
+    }
+
+    const double *data = ring.constData();
+    while (true){
+        // Read the stop flag first: once set, all frames were already pushed
+        bool stop = writer_stop.load(std::memory_order_acquire);
+
+        size_t tail = ring_tail.load(std::memory_order_relaxed);
+        size_t head = ring_head.load(std::memory_order_acquire);
+        while (head - tail >= frame_size){
+            if (binary){
+                for (size_t i = 0; i < frame_size; i++){
+                    binary_stream << data[(tail + i) & ring_mask];
+                }
+            } else {
+                text_stream << QString::number(data[tail & ring_mask], 'f', 6);
+                for (size_t i = 1; i < frame_size; i++){
+                    text_stream << "," << QString::number(data[(tail + i) & ring_mask], 'f', 6);
+                }
+                text_stream << "\n";
+            }
+            tail += frame_size;
+        }
+        ring_tail.store(tail, std::memory_order_release);
+
+        if (stop){
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+
+    text_stream.flush();
+    file.close();
+}
@@ -0,0 +1,120 @@
+#ifndef GAUGEACQUISITION_H
+#define GAUGEACQUISITION_H
+
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include <atomic>
+#include <random>
+#include <thread>
+
+
+///
+/// \brief The GaugeAcquisition class records the readings of a set of linear gages (channels) as a measurement stream, like a gage DAQ would.
+/// Readings are added from the GUI thread at simulation time and stored in a lock-free ring buffer (single producer, single consumer).
+/// A writer thread empties the buffer to a CSV or binary file, so the GUI thread never waits for the disk.
+///
+/// Binary files start with the 8 characters "RDKGAGE1", the number of channels (uint32) and the name of each channel (uint16 size + UTF-8 text).
+/// Each sample follows as little-endian doubles: time (s) and one value per channel (mm).
+///
+class GaugeAcquisition
+{
+public:
+    /// Default size of the ring buffer (number of doubles, must be a power of 2).
+    static const int DefaultCapacity = 1 << 20;
+
+    /// Maximum number of interpolated samples added for one call to \ref addValues.
+    static const int MaxSamplesPerStep = 100000;
+
+    GaugeAcquisition();
+    ~GaugeAcquisition();
+
+    /// \brief Start a new acquisition.
+    /// \param channels Name of each channel
+    /// \param filename File to stream to: a .csv extension generates a CSV file, any other extension a binary file. Leave empty to only keep the last values.
+    /// \return false if the file could not be created
+    bool Start(const QStringList &channels, const QString &filename = "");
+
+    /// Stop the acquisition. All buffered samples are written before returning.
+    void Stop();
+
+    /// Returns true if an acquisition is running.
+    bool isRunning() const { return running; }
+
+    /// Set the sampling rate in Hz (simulation time).
+    void setRate(double rate_hz);
+    double Rate() const { return rate; }
+
+    /// Set the standard deviation of the Gaussian noise added to each reading (mm). Set to 0 to disable.
+    void setNoise(double stddev_mm) { noise = stddev_mm; }
+    double Noise() const { return noise; }
+
+    /// Set the resolution of the readings (mm). Set to 0 to disable quantization.
+    void setResolution(double resolution_mm) { resolution = resolution_mm; }
+    double Resolution() const { return resolution; }
+
+    /// \brief Add the exact values of all channels at a given simulation time.
+    /// Samples are generated at the sampling rate, interpolating linearly from the values of the previous call.
+    /// \param time Simulation time in seconds (such as the result of the TrajectoryTime command)
+    /// \param values One value per channel (mm)
+    void addValues(double time, const QVector<double> &values);
+
+    /// Channel names of the current (or last) acquisition
+    const QStringList &Channels() const { return channel_names; }
+
+    /// Last sample (after applying the noise and resolution model) of a channel
+    double LastValue(int channel) const;
+
+    /// Time of the last sample (s)
+    double LastTime() const { return last_sample_time; }
+
+    /// Number of samples acquired since the acquisition started
+    quint64 SampleCount() const { return sample_count; }
+
+    /// Number of samples lost because the ring buffer was full
+    quint64 DroppedCount() const { return dropped_count; }
+
+private:
+    void addSample(double time, const double *values);
+    double applyModel(double value);
+    void writerLoop();
+
+    QStringList channel_names;
+    QString file_name;
+    bool binary { false };
+
+    double rate { 1000.0 };
+    double noise { 0.0 };
+    double resolution { 0.0 };
+
+    std::mt19937 generator;
+    std::normal_distribution<double> distribution { 0.0, 1.0 };
+
+    /// Time and values of the previous call to addValues (for interpolation)
+    bool has_previous { false };
+    double previous_time { 0.0 };
+    QVector<double> previous_values;
+
+    /// Time of the next sample to generate
+    double next_sample_time { 0.0 };
+
+    double last_sample_time { 0.0 };
+    QVector<double> last_values;
+    quint64 sample_count { 0 };
+    quint64 dropped_count { 0 };
+
+    /// Ring buffer: one frame per sample (time followed by one value per channel)
+    QVector<double> ring;
+    size_t ring_mask { 0 };
+    std::atomic<size_t> ring_head { 0 };
+    std::atomic<size_t> ring_tail { 0 };
+
+    bool running { false };
+    std::atomic<bool> writer_stop { false };
+    std::thread writer;
+};
+
+
+#endif // GAUGEACQUISITION_H
@@ -10,12 +10,26 @@
 #include <QDesktopServices>
 #include <QInputDialog>
 
+#include <cmath>
+
 #include "pluginlvdt.h"
 
 #include "robodk_interface.h"
 #include "iitem.h"
 
 
+/// Key of the grid cell containing a point
+static quint64 gridCellKey(const double xyz[3], double cell_size) {
+    // 21 bits per axis: the key is unique within +/- 1 million cells
+    quint64 key = 0;
+    for (int i = 0; i < 3; i++) {
+        qint64 index = static_cast<qint64>(std::floor(xyz[i] / cell_size)) + (1 << 20);
+        key = (key << 21) | (static_cast<quint64>(index) & 0x1FFFFF);
+    }
+    return key;
+}
+
+
 //------------------------------- RoboDK Plug-in commands ------------------------------
 
 PluginLVDT::PluginLVDT(){
@@ -56,7 +70,10 @@ void PluginLVDT::PluginUnload(){
     qDebug() << "Unloading plugin " << PluginName();
 
     last_clicked_item = nullptr;
+    acquisition.Stop();
+    acquisition_channels.clear();
     lvdts.clear();
+    invalidateCache();
 
     if (nullptr != action_active)
     {
@@ -107,6 +124,57 @@ bool PluginLVDT::PluginItemClick(Item item, QMenu *menu, TypeClick click_type){
 
 QString PluginLVDT::PluginCommand(const QString &command, const QString &value){
     qDebug() << "Sent command: " << command << "    With value: " << value;
+
+    // Virtual gage acquisition:
+    //   "AcquisitionStart", "file path (.csv for text, any other extension for binary) or empty to keep the last values only"
+    //   "AcquisitionStop", ""
+    //   "AcquisitionRate", "sampling rate in Hz (simulation time)"
+    //   "AcquisitionNoise", "standard deviation of the noise in mm"
+    //   "AcquisitionResolution", "resolution in mm"
+    //   "AcquisitionValue", "LVDT name or channel index": returns the last sample in mm
+    //   "AcquisitionValues", "": returns the time and the last sample of all channels
+    //   "AcquisitionStatus", "": returns the number of channels, samples and dropped samples
+    if (command.compare("AcquisitionStart", Qt::CaseInsensitive) == 0){
+        return startAcquisition(value) ? "OK" : "Unable to create file";
+    } else if (command.compare("AcquisitionStop", Qt::CaseInsensitive) == 0){
+        acquisition.Stop();
+        acquisition_channels.clear();
+        return "OK";
+    } else if (command.compare("AcquisitionRate", Qt::CaseInsensitive) == 0){
+        if (!value.isEmpty()){
+            acquisition.setRate(value.toDouble());
+        }
+        return QString::number(acquisition.Rate());
+    } else if (command.compare("AcquisitionNoise", Qt::CaseInsensitive) == 0){
+        if (!value.isEmpty()){
+            acquisition.setNoise(value.toDouble());
+        }
+        return QString::number(acquisition.Noise());
+    } else if (command.compare("AcquisitionResolution", Qt::CaseInsensitive) == 0){
+        if (!value.isEmpty()){
+            acquisition.setResolution(value.toDouble());
+        }
+        return QString::number(acquisition.Resolution());
+    } else if (command.compare("AcquisitionValue", Qt::CaseInsensitive) == 0){
+        bool is_index;
+        int channel = value.toInt(&is_index);
+        if (!is_index){
+            channel = acquisition.Channels().indexOf(value);
+        }
+        if (channel < 0 || channel >= acquisition.Channels().size()){
+            return "Invalid channel";
+        }
+        return QString::number(acquisition.LastValue(channel), 'f', 6);
+    } else if (command.compare("AcquisitionValues", Qt::CaseInsensitive) == 0){
+        QStringList values;
+        values.append(QString::number(acquisition.LastTime(), 'f', 6));
+        for (int i = 0; i < acquisition.Channels().size(); i++){
+            values.append(QString::number(acquisition.LastValue(i), 'f', 6));
+        }
+        return values.join(",");
+    } else if (command.compare("AcquisitionStatus", Qt::CaseInsensitive) == 0){
+        return QString("%1,%2,%3").arg(acquisition.Channels().size()).arg(acquisition.SampleCount()).arg(acquisition.DroppedCount());
+    }
     return "";
 }
 
@@ -117,12 +185,18 @@ void PluginLVDT::PluginEvent(TypeEvent event_type){
     case EventChanged:
     {
         cleanupRemovedItems();
+        invalidateCache();
         updateLvdts(); // If a robot/tool was removed, we might need to reset an LVDT
         break;
     }
     case EventMoved:
         updateLvdts();
         break;
+    case EventTrajectoryStep:
+        // The robots moved in this step: calculate the readings before sampling them
+        updateLvdts();
+        sampleLvdts();
+        break;
     default:
         break;
 
@@ -145,6 +219,7 @@ void PluginLVDT::callback_mechanism_active(bool activate){
                 i.remove();
             }
         }
+        grid_dirty = true;
         return;
     }
 
@@ -161,6 +236,7 @@ void PluginLVDT::callback_mechanism_active(bool activate){
     }
 
     lvdts.append(lvdt);
+    grid_dirty = true;
     qDebug() << "Starting mechanism simulation for " << lvdt.mechanism->Name();
 }
 
@@ -212,47 +288,78 @@ void PluginLVDT::updateLvdts(){
         return;
     }
 
-    QList<Item> tools = RDK->getItemList(IItem::ITEM_TYPE_TOOL);
+    if (tools_dirty){
+        tools = RDK->getItemList(IItem::ITEM_TYPE_TOOL);
+        tools_dirty = false;
+    }
 
-    for (const auto& lvdt : lvdts){
-        Mat poseabs_lvdt = lvdt.mechanism->PoseAbs();
+    updateLvdtCache();
 
-        tJoints lower_limits;
-        tJoints upper_limits;
-        lvdt.mechanism->JointLimits(&lower_limits, &upper_limits);
+    // Fully extended by default
+    QVector<double> new_values(lvdts.size());
+    for (int id = 0; id < lvdts.size(); id++){
+        new_values[id] = lvdts[id].low;
+    }
 
-        double low = lower_limits.Data()[0];
-        double high = upper_limits.Data()[0];
-        double new_value = low;
+    // Each TCP is calculated once and only tested against the LVDTs of its grid cell
+    for (const auto& tool : tools){
+        if (!tool->Visible()) {
+            continue;
+        }
 
-        for (const auto& tool : tools){
-            if (!tool->Visible()) {
-                continue;
-            }
+        Mat poseabs_tcp = tool->PoseAbs() * tool->PoseTool();
+        tXYZ xyz_abs;
+        poseabs_tcp.Pos(xyz_abs);
 
-            Mat poseabs_tcp = tool->PoseAbs() * tool->PoseTool();
-            Mat tcp_wrt_lvdt = poseabs_lvdt.inv() * poseabs_tcp;
+        auto cell = lvdt_grid.constFind(gridCellKey(xyz_abs, grid_cell_size));
+        if (cell == lvdt_grid.constEnd()){
+            continue;
+        }
+
+        for (int id : cell.value()){
+            const lvdt_data_t &lvdt = lvdts[id];
 
             tXYZ xyz_tcp;
-            tcp_wrt_lvdt.Pos(xyz_tcp);
+            MULT_MAT_POINT(xyz_tcp, lvdt.pose_inv, xyz_abs);
             if ((std::abs(xyz_tcp[0]) > lvdt.radius) || (std::abs(xyz_tcp[1]) > lvdt.radius)){
                 // Out of reach in the XY plane
                 continue;
             }
 
-            if ((-xyz_tcp[2] < low) || (-xyz_tcp[2] > high)){
+            if ((-xyz_tcp[2] < lvdt.low) || (-xyz_tcp[2] > lvdt.high)){
                 // Out of reach in the Z axis
                 continue;
             }
 
-            new_value = std::max(new_value, -xyz_tcp[2]);
+            new_values[id] = std::max(new_values[id], -xyz_tcp[2]);
+        }
+    }
+
+    Item station = RDK->getActiveStation();
+    bool changed = false;
+    for (int id = 0; id < lvdts.size(); id++){
+        lvdt_data_t &lvdt = lvdts[id];
+        if (lvdt.station != station){
+            continue;
+        }
+        lvdt.value = new_values[id];
+
+        // Compare with the joints of the mechanism, not with the last value set: the gage may have been jogged by hand
+        tJoints current = lvdt.mechanism->Joints();
+        if (current.Length() == 1 && current.Data()[0] == lvdt.value){
+            continue;
         }
+        changed = true;
 
         tJoints joints;
-        joints.SetValues(&new_value, 1);
+        joints.SetValues(&lvdt.value, 1);
         lvdt.mechanism->setJoints(joints);
     }
 
+    if (!changed){
+        return;
+    }
+
     // We must force a new update before render (a render is on its way),
     // Keep in mind we are already inside an update operation
     // RoboDK will check for recursivity and prevent it
@@ -260,6 +367,134 @@ void PluginLVDT::updateLvdts(){
 }
 
 
+void PluginLVDT::updateLvdtCache(){
+    Item station = RDK->getActiveStation();
+    for (auto& lvdt : lvdts){
+        if (lvdt.station != station){
+            continue;
+        }
+
+        // Limits only change when the station changes
+        if (!lvdt.limits_valid){
+            tJoints lower_limits;
+            tJoints upper_limits;
+            lvdt.mechanism->JointLimits(&lower_limits, &upper_limits);
+            lvdt.low = lower_limits.Data()[0];
+            lvdt.high = upper_limits.Data()[0];
+            lvdt.limits_valid = true;
+            grid_dirty = true;
+        }
+
+        Mat pose_abs = lvdt.mechanism->PoseAbs();
+        if (!lvdt.pose_valid || pose_abs != lvdt.pose_abs){
+            lvdt.pose_abs = pose_abs;
+            Mat pose_inv = pose_abs.inv();
+            for (int c = 0; c < 4; c++){
+                for (int r = 0; r < 4; r++){
+                    lvdt.pose_inv[4*c + r] = pose_inv.Get(r, c);
+                }
+            }
+            lvdt.pose_valid = true;
+            grid_dirty = true;
+        }
+    }
+
+    if (!grid_dirty){
+        return;
+    }
+
+    // The cell size is the largest reach of all LVDTs, so each LVDT only covers a few cells
+    grid_cell_size = 1.0;
+    for (const auto& lvdt : lvdts){
+        if (lvdt.station == station){
+            grid_cell_size = std::max(grid_cell_size, std::max(2.0 * lvdt.radius, lvdt.high - lvdt.low));
+        }
+    }
+
+    lvdt_grid.clear();
+    for (int id = 0; id < lvdts.size(); id++){
+        const lvdt_data_t &lvdt = lvdts[id];
+        if (lvdt.station != station){
+            continue;
+        }
+
+        // Absolute bounding box of the reach of the LVDT (XY radius, Z travel)
+        double box_min[3] = { 1e30, 1e30, 1e30 };
+        double box_max[3] = { -1e30, -1e30, -1e30 };
+        for (int c = 0; c < 8; c++){
+            tXYZ corner_abs;
+            tXYZ corner = { (c & 1) ? lvdt.radius : -lvdt.radius, (c & 2) ? lvdt.radius : -lvdt.radius, (c & 4) ? -lvdt.high : -lvdt.low };
+            lvdt.pose_abs.Pos(corner_abs);
+            for (int i = 0; i < 3; i++){
+                corner_abs[i] += lvdt.pose_abs.Get(i, 0) * corner[0] + lvdt.pose_abs.Get(i, 1) * corner[1] + lvdt.pose_abs.Get(i, 2) * corner[2];
+                box_min[i] = std::min(box_min[i], corner_abs[i]);
+                box_max[i] = std::max(box_max[i], corner_abs[i]);
+            }
+        }
+
+        // Register the LVDT in all the cells covered by its reach
+        tXYZ xyz;
+        for (double x = std::floor(box_min[0] / grid_cell_size); x <= std::floor(box_max[0] / grid_cell_size); x += 1.0){
+            for (double y = std::floor(box_min[1] / grid_cell_size); y <= std::floor(box_max[1] / grid_cell_size); y += 1.0){
+                for (double z = std::floor(box_min[2] / grid_cell_size); z <= std::floor(box_max[2] / grid_cell_size); z += 1.0){
+                    xyz[0] = (x + 0.5) * grid_cell_size;
+                    xyz[1] = (y + 0.5) * grid_cell_size;
+                    xyz[2] = (z + 0.5) * grid_cell_size;
+                    lvdt_grid[gridCellKey(xyz, grid_cell_size)].append(id);
+                }
+            }
+        }
+    }
+    grid_dirty = false;
+}
+
+
+void PluginLVDT::sampleLvdts(){
+    if (!acquisition.isRunning()){
+        return;
+    }
+
+    // Use the values calculated by updateLvdts for this step: no additional calls to RoboDK
+    QVector<double> values(acquisition_channels.size(), 0.0);
+    for (int channel = 0; channel < acquisition_channels.size(); channel++){
+        for (const auto& lvdt : lvdts){
+            if (lvdt.mechanism == acquisition_channels[channel]){
+                values[channel] = lvdt.value;
+                break;
+            }
+        }
+    }
+
+    double time_sec = RDK->Command("TrajectoryTime").toDouble();
+    acquisition.addValues(time_sec, values);
+}
+
+
+bool PluginLVDT::startAcquisition(const QString &filename){
+    Item station = RDK->getActiveStation();
+    QStringList names;
+    acquisition_channels.clear();
+    for (const auto& lvdt : lvdts){
+        if (lvdt.station == station && lvdt.active){
+            acquisition_channels.append(lvdt.mechanism);
+            names.append(lvdt.mechanism->Name());
+        }
+    }
+    return acquisition.Start(names, filename);
+}
+
+
+void PluginLVDT::invalidateCache(){
+    for (auto& lvdt : lvdts){
+        lvdt.limits_valid = false;
+        lvdt.pose_valid = false;
+    }
+    tools.clear();
+    tools_dirty = true;
+    grid_dirty = true;
+}
+
+
 void PluginLVDT::cleanupRemovedItems() {
     if (lvdts.empty()){
         return;
@@ -275,6 +510,7 @@ void PluginLVDT::cleanupRemovedItems() {
         if (!stations.contains(lvdt.station)) {
             qDebug() << "Station closed. Removing affected items.";
             it = lvdts.erase(it);
+            grid_dirty = true;
             continue;
         }
 
@@ -284,6 +520,7 @@ void PluginLVDT::cleanupRemovedItems() {
             if (!RDK->Valid(lvdt.mechanism)) {
                 qDebug() << "LVDT deleted. Removing affected items.";
                 it = lvdts.erase(it);
+                grid_dirty = true;
                 continue;
             }
         }
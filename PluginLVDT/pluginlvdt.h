@@ -7,10 +7,13 @@
 #include <QDockWidget>
 #include "iapprobodk.h"
 #include "robodktypes.h"
+#include "gaugeacquisition.h"
 
 
 #include <QTimer>
 #include <QElapsedTimer>
+#include <QHash>
+#include <QVector>
 
 
 
@@ -74,6 +77,18 @@ public:
     /// Update the poses of LVDTs
     void updateLvdts();
 
+    /// Update the cached limits and poses of the LVDTs, and the spatial grid if any LVDT moved
+    void updateLvdtCache();
+
+    /// Invalidate all cached data (the station changed)
+    void invalidateCache();
+
+    /// Add the current LVDT values to the acquisition (called on each simulation step, after updateLvdts)
+    void sampleLvdts();
+
+    /// Start acquiring all active LVDTs of the current station. Returns false if the file can't be created.
+    bool startAcquisition(const QString &filename);
+
     /// Remove deleted or invalid LVDTs
     void cleanupRemovedItems();
 
@@ -90,11 +105,43 @@ private:
         float radius { 12.5f };
         Item mechanism { nullptr };
         Item station { nullptr };
+
+        /// Cached joint limits (valid until the station changes)
+        bool limits_valid { false };
+        double low { 0.0 };
+        double high { 0.0 };
+
+        /// Cached absolute pose of the LVDT and its inverse (column-major, for MULT_MAT_POINT)
+        bool pose_valid { false };
+        Mat pose_abs;
+        double pose_inv[16];
+
+        /// Last value calculated for the mechanism (reading of the gage)
+        double value { 0.0 };
     };
 
     /// Vector of all available LVDT
     QList<lvdt_data_t> lvdts;
 
+    /// Spatial hash of the reach of each LVDT: grid cell -> LVDT indexes
+    QHash<quint64, QVector<int>> lvdt_grid;
+
+    /// Size of the grid cells (mm)
+    double grid_cell_size { 1.0 };
+
+    /// The spatial hash must be rebuilt (an LVDT moved, or was added or removed)
+    bool grid_dirty { true };
+
+    /// Cached list of tools (refreshed when the station changes)
+    QList<Item> tools;
+    bool tools_dirty { true };
+
+    /// Virtual gage acquisition (DAQ)
+    GaugeAcquisition acquisition;
+
+    /// LVDT mechanism of each acquisition channel
+    QList<Item> acquisition_channels;
+
     /// Last clicked item --or item to attach to
     Item last_clicked_item { nullptr };
 
@@ -3,6 +3,63 @@
 #include <QAction>
 #include <QStatusBar>
 #include <QMenuBar>
+#include <QHash>
+
+#include <algorithm>
+#include <cmath>
+
+
+// Pose error from the current to the target pose: position error in mm, followed by the orientation error in rad scaled by rotation_weight
+static void poseError(const Mat &current, const Mat &target, double rotation_weight, double error[6]){
+    double rot[3] = {0.0, 0.0, 0.0};
+    for (int c = 0; c < 3; c++){
+        // Sum of the cross products of the current and target axes (small angle rotation vector)
+        double a[3] = {current.Get(0, c), current.Get(1, c), current.Get(2, c)};
+        double b[3] = {target.Get(0, c), target.Get(1, c), target.Get(2, c)};
+        rot[0] += a[1] * b[2] - a[2] * b[1];
+        rot[1] += a[2] * b[0] - a[0] * b[2];
+        rot[2] += a[0] * b[1] - a[1] * b[0];
+    }
+    for (int i = 0; i < 3; i++){
+        error[i] = target.Get(i, 3) - current.Get(i, 3);
+        error[3 + i] = 0.5 * rot[i] * rotation_weight;
+    }
+}
+
+// Solve A x = b with Gaussian elimination and partial pivoting. The solution is stored in b.
+static bool solveLinear6(double A[6][6], double b[6]){
+    for (int col = 0; col < 6; col++){
+        int pivot = col;
+        for (int row = col + 1; row < 6; row++){
+            if (std::fabs(A[row][col]) > std::fabs(A[pivot][col])){
+                pivot = row;
+            }
+        }
+        if (std::fabs(A[pivot][col]) < 1e-12){
+            return false;
+        }
+        if (pivot != col){
+            for (int k = 0; k < 6; k++){
+                std::swap(A[col][k], A[pivot][k]);
+            }
+            std::swap(b[col], b[pivot]);
+        }
+        for (int row = col + 1; row < 6; row++){
+            double factor = A[row][col] / A[col][col];
+            for (int k = col; k < 6; k++){
+                A[row][k] -= factor * A[col][k];
+            }
+            b[row] -= factor * b[col];
+        }
+    }
+    for (int row = 5; row >= 0; row--){
+        for (int k = row + 1; k < 6; k++){
+            b[row] -= A[row][k] * b[k];
+        }
+        b[row] /= A[row][row];
+    }
+    return true;
+}
 
 
 //------------------------------- RoboDK Plug-in commands ------------------------------
@@ -78,6 +135,21 @@ bool PluginLockTCP::PluginItemClick(Item item, QMenu *menu, TypeClick click_type
 }
 
 QString PluginLockTCP::PluginCommand(const QString &command, const QString &item_name){
+    if (command.compare("Tracking", Qt::CaseInsensitive) == 0){
+        QString mode = item_name.trimmed();
+        if (mode.compare("Full", Qt::CaseInsensitive) == 0){
+            tracking_mode = TrackingFull;
+        } else if (mode.compare("Warm", Qt::CaseInsensitive) == 0){
+            tracking_mode = TrackingWarm;
+        } else if (mode.compare("DLS", Qt::CaseInsensitive) == 0){
+            tracking_mode = TrackingDLS;
+        } else {
+            return "INVALID MODE";
+        }
+        qDebug() << "Tracking mode set to " << mode;
+        return "OK";
+    }
+
     Item item = RDK->getItem(item_name);
     if (item == nullptr){
         qDebug() << "Item not found";
@@ -97,6 +169,11 @@ QString PluginLockTCP::PluginCommand(const QString &command, const QString &item
 void PluginLockTCP::PluginEvent(TypeEvent event_type){
     switch (event_type){
     case EventChanged:{
+        // Items may have been added, removed or moved in the tree: find the rails again
+        for (auto& locked_item : locked_items){
+            locked_item.rail_valid = false;
+        }
+
         // Check if any locked TCPs were removed
         for (auto it = locked_items.begin(); it != locked_items.end(); it++){
             locked_item_t l_item = *it;
@@ -166,16 +243,41 @@ bool PluginLockTCP::process_item(Item item){
 
 void PluginLockTCP::update_tcp_pose(){
     bool renderUpdate = false;
+
+    // Absolute pose of each rail, read once for all the robots mounted on it
+    QHash<Item, Mat> rail_poses;
+
     for (auto& locked_item : locked_items){
         if (locked_item.locked){
-            // There is not guarrantee that the robot parent is the rail.. find it!
-            Mat pose = retrieve_pose_to_rail(locked_item.robot);
+            // There is not guarrantee that the robot parent is the rail.. find it once and keep the static offset
+            if (!locked_item.rail_valid){
+                locked_item.rail = retrieve_rail(locked_item.robot, locked_item.rail_offset);
+                locked_item.rail_valid = true;
+            }
+            auto rail_pose = rail_poses.find(locked_item.rail);
+            if (rail_pose == rail_poses.end()){
+                rail_pose = rail_poses.insert(locked_item.rail, locked_item.rail->PoseAbs());
+            }
+            Mat pose = locked_item.rail_offset * rail_pose.value();
             Mat robot_pose = pose.inv() * locked_item.pose;
-            tJoints jnew = locked_item.robot->SolveIK(robot_pose);
+
+            // Track the pose locally from the last solution when possible: the configuration can't change
+            tJoints jnew;
+            bool check_config = true;
+            if (tracking_mode == TrackingDLS && solve_dls(locked_item, robot_pose, jnew)){
+                check_config = false;
+            } else if (tracking_mode == TrackingFull || tracking_mode == TrackingDLS){
+                jnew = locked_item.robot->SolveIK(robot_pose);
+            } else {
+                // The current joints hold the last accepted arm joints and the new external axes
+                tJoints seed = locked_item.robot->Joints();
+                jnew = locked_item.robot->SolveIK(robot_pose, &seed);
+            }
 
             // Out of reach, fully extended
             if (jnew.Length() == 0){
                 locked_item.robot->setJoints(locked_item.last_jnts);
+                rail_poses.remove(locked_item.rail); // the external axes moved back
                 renderUpdate = true;
                 qDebug() << locked_item.robot->Name() << " is out of reach, fully extended, skipping.";
                 continue;
@@ -187,24 +289,27 @@ void PluginLockTCP::update_tcp_pose(){
                 continue;
             }
 
-            // Joints config changed
-            tConfig new_config;
-            locked_item.robot->JointsConfig(jnew, new_config);
-            tConfig prev_config;
-            locked_item.robot->JointsConfig(locked_item.last_jnts, prev_config);
-            bool joints_changed = false;
-            for (int i = 0; i < RDK_SIZE_MAX_CONFIG; ++i){
-                if (static_cast<short>(new_config[i]) !=  static_cast<short>(prev_config[i])){
-                    joints_changed = true;
-                    break;
+            // Joints config changed (the local tracking keeps the configuration)
+            if (check_config){
+                tConfig new_config;
+                locked_item.robot->JointsConfig(jnew, new_config);
+                tConfig prev_config;
+                locked_item.robot->JointsConfig(locked_item.last_jnts, prev_config);
+                bool joints_changed = false;
+                for (int i = 0; i < RDK_SIZE_MAX_CONFIG; ++i){
+                    if (static_cast<short>(new_config[i]) !=  static_cast<short>(prev_config[i])){
+                        joints_changed = true;
+                        break;
+                    }
                 }
-            }
 
-            if (joints_changed){
-                locked_item.robot->setJoints(locked_item.last_jnts);
-                renderUpdate = true;
-                qDebug() << locked_item.robot->Name() << " joints configuration changed, skipping";
-                continue;
+                if (joints_changed){
+                    locked_item.robot->setJoints(locked_item.last_jnts);
+                    rail_poses.remove(locked_item.rail); // the external axes moved back
+                    renderUpdate = true;
+                    qDebug() << locked_item.robot->Name() << " joints configuration changed, skipping";
+                    continue;
+                }
             }
 
             // New valid pose
@@ -231,29 +336,163 @@ void PluginLockTCP::callback_tcp_lock(bool lock){
             Mat pose = retrieve_pose_to_rail(locked_item.robot);
             locked_item.pose = pose * locked_item.robot->SolveFK(locked_item.robot->Joints());
             locked_item.last_jnts = locked_item.robot->Joints();
+            locked_item.robot->JointLimits(&locked_item.lower_limits, &locked_item.upper_limits);
+            locked_item.rail_valid = false;
+            locked_item.jacobian.clear();
             locked_item.locked = lock;
         }
     }
 }
 
+void PluginLockTCP::update_jacobian(locked_item_t &locked_item, const tJoints &joints, const Mat &current){
+    Item robot = locked_item.robot;
+    const int njoints = joints.Length();
+
+    // Step of the numerical Jacobian in deg or mm. SolveFK is computed in single precision: smaller steps are lost in the rounding at 1 m from the base.
+    const double delta = 1e-2;
+
+    // Perturbations smaller than the single precision rounding are treated as no motion (for example, synchronized external axes)
+    const double min_change = 1e-3;
+
+    // The external axes don't move the flange with respect to the robot base, so their columns are zero and they don't move.
+    locked_item.jacobian.fill(0.0, 6 * njoints);
+    for (int j = 0; j < njoints; j++){
+        tJoints perturbed(joints);
+        perturbed.Data()[j] += delta;
+        double column[6];
+        poseError(current, robot->SolveFK(perturbed), dls_rotation_weight, column);
+        double change = 0.0;
+        for (int i = 0; i < 6; i++){
+            change = std::max(change, std::fabs(column[i]));
+        }
+        if (change < min_change){
+            continue;
+        }
+        for (int i = 0; i < 6; i++){
+            locked_item.jacobian[i * njoints + j] = column[i] / delta;
+        }
+    }
+    locked_item.jacobian_joints = joints;
+}
+
+bool PluginLockTCP::solve_dls(locked_item_t &locked_item, const Mat &robot_pose, tJoints &joints){
+    Item robot = locked_item.robot;
+    joints = robot->Joints();
+    const int njoints = joints.Length();
+    if (njoints == 0){
+        return false;
+    }
+
+    double *q = joints.Data();
+    const double tolerance_rotation = dls_tolerance_rad * dls_rotation_weight;
+
+    Mat current = robot->SolveFK(joints);
+    double error[6];
+    poseError(current, robot_pose, dls_rotation_weight, error);
+
+    // The Jacobian is kept from the previous updates (corrected after each step) while the joints stay close to where it was calculated
+    bool jacobian_valid = locked_item.jacobian.size() == 6 * njoints && locked_item.jacobian_joints.Length() == njoints;
+    for (int j = 0; jacobian_valid && j < njoints; j++){
+        jacobian_valid = std::fabs(q[j] - locked_item.jacobian_joints.ValuesD()[j]) <= dls_jacobian_max_change;
+    }
+    if (!jacobian_valid){
+        update_jacobian(locked_item, joints, current);
+    }
+    QVector<double> &J = locked_item.jacobian;
+
+    for (int iteration = 0; ; iteration++){
+        double error_position = std::sqrt(error[0] * error[0] + error[1] * error[1] + error[2] * error[2]);
+        double error_rotation = std::sqrt(error[3] * error[3] + error[4] * error[4] + error[5] * error[5]);
+        if (error_position <= dls_tolerance_mm && error_rotation <= tolerance_rotation){
+            return true;
+        }
+        if (iteration >= dls_max_iterations){
+            qDebug() << robot->Name() << " local tracking did not converge, using a full solve";
+            locked_item.jacobian.clear();
+            return false;
+        }
+
+        // Damped least squares step: dq = J^T (J J^T + damping^2 I)^-1 error
+        double A[6][6];
+        for (int i = 0; i < 6; i++){
+            for (int k = 0; k < 6; k++){
+                double sum = (i == k) ? dls_damping * dls_damping : 0.0;
+                for (int j = 0; j < njoints; j++){
+                    sum += J[i * njoints + j] * J[k * njoints + j];
+                }
+                A[i][k] = sum;
+            }
+        }
+        double y[6];
+        std::copy(error, error + 6, y);
+        if (!solveLinear6(A, y)){
+            locked_item.jacobian.clear();
+            return false;
+        }
+
+        QVector<double> dq(njoints, 0.0);
+        double dq_norm2 = 0.0;
+        for (int j = 0; j < njoints; j++){
+            for (int i = 0; i < 6; i++){
+                dq[j] += J[i * njoints + j] * y[i];
+            }
+
+            // Large steps may jump to another configuration
+            if (std::fabs(dq[j]) > dls_max_step){
+                locked_item.jacobian.clear();
+                return false;
+            }
+            q[j] += dq[j];
+            dq_norm2 += dq[j] * dq[j];
+
+            if (j < locked_item.lower_limits.Length() && j < locked_item.upper_limits.Length()){
+                if (q[j] < locked_item.lower_limits.ValuesD()[j] || q[j] > locked_item.upper_limits.ValuesD()[j]){
+                    qDebug() << robot->Name() << " joint " << (j + 1) << " reached a limit";
+                    return false;
+                }
+            }
+        }
+
+        Mat previous = current;
+        current = robot->SolveFK(joints);
+        poseError(current, robot_pose, dls_rotation_weight, error);
+
+        // Broyden update of the Jacobian with the motion of the step: J += (motion - J dq) dq^T / |dq|^2
+        if (dq_norm2 > 0.0){
+            double motion[6];
+            poseError(previous, current, dls_rotation_weight, motion);
+            for (int i = 0; i < 6; i++){
+                double predicted = 0.0;
+                for (int j = 0; j < njoints; j++){
+                    predicted += J[i * njoints + j] * dq[j];
+                }
+                double correction = (motion[i] - predicted) / dq_norm2;
+                for (int j = 0; j < njoints; j++){
+                    J[i * njoints + j] += correction * dq[j];
+                }
+            }
+        }
+    }
+}
+
 Mat PluginLockTCP::retrieve_pose_to_rail(Item item){
+    Mat offset;
+    Item rail = retrieve_rail(item, offset);
+    return offset * rail->PoseAbs();
+}
+
+Item PluginLockTCP::retrieve_rail(Item item, Mat &offset){
     IItem* parent = item;
-    Mat pose = Mat();
-    bool found = false;
+    offset = Mat();
     while (parent != nullptr && parent->Type() != IItem::ITEM_TYPE_STATION && parent->Type() != IItem::ITEM_TYPE_ANY) {
         parent = parent->Parent();
         if (parent->Type() == IItem::ITEM_TYPE_ROBOT){
-            found = true;
-            pose *= parent->PoseAbs();
-            break;
+            return parent;
         }
-        pose *= parent->Pose();
-    }
-
-    if (!found){
-        pose = item->Parent()->PoseAbs(); // robot not attached to a rail
+        offset *= parent->Pose();
     }
 
-    return pose;
+    // Robot not attached to a rail
+    offset = Mat();
+    return item->Parent();
 }
-
@@ -96,6 +96,25 @@ public:
     /// \return The absolute pose
     Mat retrieve_pose_to_rail(Item item);
 
+    /// Retrieve the rail (or parent) the item is mounted on and the static offset of the intermediary frames.
+    /// The pose returned by \ref retrieve_pose_to_rail is offset * rail->PoseAbs().
+    /// \param item item to start with, usually the robot
+    /// \param offset static offset of the intermediary frames
+    /// \return The rail, or the parent of the item if it is not mounted on a rail
+    Item retrieve_rail(Item item, Mat &offset);
+
+    /// Tracking modes used to follow the locked TCP when the external axes move
+    enum TrackingMode {
+        /// Full inverse kinematics, closest to the current robot joints (slowest, default)
+        TrackingFull = 0,
+
+        /// Inverse kinematics seeded with the last accepted joints
+        TrackingWarm,
+
+        /// Damped least squares Jacobian steps from the last accepted joints, with a full solve as fallback
+        TrackingDLS
+    };
+
 private:
 
     /// Lock/unlock action. callback_tcp_lock is triggered with this action.  Actions are required to populate toolbars and menus and allows getting callbacks.
@@ -108,11 +127,43 @@ private:
         Item robot { nullptr };
         Mat pose; // initial TCP pose when locked
         tJoints last_jnts; // last accepted joints
+        tJoints lower_limits; // joint limits, retrieved when locked
+        tJoints upper_limits;
+
+        /// Cached rail (or parent) and static offset of the intermediary frames, invalidated when the station changes
+        bool rail_valid { false };
+        Item rail { nullptr };
+        Mat rail_offset;
+
+        /// Jacobian of the last local tracking (6 rows, one column per joint) and the joints where it was calculated
+        QVector<double> jacobian;
+        tJoints jacobian_joints;
     };
 
     /// Vector of all available locked items
     QVector<locked_item_t> locked_items;
 
+    /// Solve the robot joints to reach the pose with damped least squares steps, starting from the current joints.
+    /// The robot configuration is kept by construction. Returns false if it doesn't converge or a limit is reached.
+    bool solve_dls(locked_item_t &locked_item, const Mat &robot_pose, tJoints &joints);
+
+    /// Calculate the Jacobian of the robot at the joints with finite differences (one SolveFK per joint)
+    void update_jacobian(locked_item_t &locked_item, const tJoints &joints, const Mat &current);
+
+    /// Current tracking mode
+    TrackingMode tracking_mode { TrackingFull };
+
+    /// Damped least squares settings
+    int dls_max_iterations { 5 };
+    double dls_damping { 0.01 };
+    double dls_tolerance_mm { 0.001 };
+    double dls_tolerance_rad { 1e-5 };
+    double dls_max_step { 5.0 }; // deg or mm per iteration
+    double dls_jacobian_max_change { 2.0 }; // deg or mm from the joints where the Jacobian was calculated before calculating it again
+
+    /// Weight of the orientation error (mm per rad) to mix it with the position error
+    double dls_rotation_weight { 100.0 };
+
     /// Last clicked item --or item to lock/unlock
     Item last_clicked_item { nullptr };
 
@@ -0,0 +1,176 @@
+#include <QMainWindow>
+#include <QDebug>
+#include <QStatusBar>
+#include <QMenuBar>
+
+#include "pluginsnapshotdataset.h"
+
+#include "irobodk.h"
+#include "iitem.h"
+
+
+//------------------------------- RoboDK Plug-in commands ------------------------------
+
+PluginSnapshotDataset::PluginSnapshotDataset(){
+}
+
+
+QString PluginSnapshotDataset::PluginName(){
+    return "Snapshot Dataset";
+}
+
+
+QString PluginSnapshotDataset::PluginLoad(QMainWindow *mw, QMenuBar *menubar, QStatusBar *statusbar, RoboDK *rdk, const QString &settings){
+    RDK = rdk;
+    MainWindow = mw;
+    StatusBar = statusbar;
+
+    qDebug() << "Loading plugin " << PluginName();
+    qDebug() << "Using settings: " << settings; // reserved for future compatibility
+
+    // it is highly recommended to use the statusbar for debugging purposes (pass /DEBUG as an argument to see debug result in RoboDK)
+    qDebug() << "Setting up the status bar";
+    StatusBar->showMessage(tr("RoboDK Plugin %1 is being loaded").arg(PluginName()));
+
+    pipeline = new SnapshotPipeline(RDK, this);
+    connect(pipeline, SIGNAL(captureFinished()), this, SLOT(callback_capture_finished()));
+
+    // return string is reserverd for future compatibility
+    return "";
+}
+
+
+void PluginSnapshotDataset::PluginUnload(){
+    // Cleanup the plugin
+    qDebug() << "Unloading plugin " << PluginName();
+
+    if (nullptr != pipeline){
+        disconnect(pipeline, SIGNAL(captureFinished()), this, SLOT(callback_capture_finished()));
+        delete pipeline; // waits for the frames being encoded
+        pipeline = nullptr;
+    }
+    poses.clear();
+}
+
+
+QString PluginSnapshotDataset::PluginCommand(const QString &command, const QString &value){
+    qDebug() << "Sent command: " << command << "    With value: " << value;
+
+    // Expected format: "Poses", "File". Load the poses of the dataset (one pose per line: x,y,z,r,p,w or 16 values)
+    //                  "Output", "Directory". Directory of the images
+    //                  "Mode", "Camera" or "View". Snapshots of a simulated camera (default) or of the main 3D view
+    //                  "Camera", "Params". Parameters of the simulated camera, such as "SIZE=1280x720 FOV=40"
+    //                  "RemoveBackground", "1" or "0". Make the background transparent (camera mode only)
+    //                  "Crop", "1" or "0". Crop to the region of interest (requires RemoveBackground)
+    //                  "KeepRatio", "1" or "0". Keep the image ratio when cropping
+    //                  "Size", "WxH". Resize the images (leave empty to keep the snapshot size)
+    //                  "Format", "png" or "jpg". Image format
+    //                  "Quality", "0-100". Image quality (-1 for the default)
+    //                  "Workers", "N". Number of encoding threads (0 for automatic)
+    //                  "QueueSize", "N". Maximum number of frames waiting to be encoded
+    //                  "Start", "" or "File". Start generating the dataset (optionally loading the poses first)
+    //                  "Stop", "". Stop taking snapshots
+    //                  "Status", "". Returns RUNNING, DONE or IDLE followed by captured, encoded, failed and total frames
+
+    if (pipeline == nullptr){
+        return "Plugin not loaded";
+    }
+
+    snapshot_settings_t &settings = pipeline->Settings();
+    if (command.compare("Poses", Qt::CaseInsensitive) == 0) {
+        if (!SnapshotPipeline::LoadPoses(value, poses)){
+            return "Invalid file";
+        }
+        return QString::number(poses.size());
+
+    } else if (command.compare("Output", Qt::CaseInsensitive) == 0) {
+        settings.output_dir = value;
+        return "OK";
+
+    } else if (command.compare("Mode", Qt::CaseInsensitive) == 0) {
+        settings.view_mode = value.compare("View", Qt::CaseInsensitive) == 0;
+        return "OK";
+
+    } else if (command.compare("Camera", Qt::CaseInsensitive) == 0) {
+        settings.camera_params = value;
+        return "OK";
+
+    } else if (command.compare("RemoveBackground", Qt::CaseInsensitive) == 0) {
+        settings.remove_background = value.toInt() != 0;
+        return "OK";
+
+    } else if (command.compare("Crop", Qt::CaseInsensitive) == 0) {
+        settings.crop = value.toInt() != 0;
+        return "OK";
+
+    } else if (command.compare("KeepRatio", Qt::CaseInsensitive) == 0) {
+        settings.keep_ratio = value.toInt() != 0;
+        return "OK";
+
+    } else if (command.compare("Size", Qt::CaseInsensitive) == 0) {
+        QStringList size = value.toLower().split("x");
+        settings.output_size = (size.length() == 2) ? QSize(size.at(0).toInt(), size.at(1).toInt()) : QSize();
+        return "OK";
+
+    } else if (command.compare("Format", Qt::CaseInsensitive) == 0) {
+        QString format = value.toLower();
+        if (format != "png" && format != "jpg" && format != "jpeg"){
+            return "Invalid format";
+        }
+        settings.format = format;
+        return "OK";
+
+    } else if (command.compare("Quality", Qt::CaseInsensitive) == 0) {
+        settings.quality = qBound(-1, value.toInt(), 100);
+        return "OK";
+
+    } else if (command.compare("Workers", Qt::CaseInsensitive) == 0) {
+        settings.workers = qMax(0, value.toInt());
+        return "OK";
+
+    } else if (command.compare("QueueSize", Qt::CaseInsensitive) == 0) {
+        settings.queue_size = qMax(1, value.toInt());
+        return "OK";
+
+    } else if (command.compare("Start", Qt::CaseInsensitive) == 0) {
+        if (!value.isEmpty() && !SnapshotPipeline::LoadPoses(value, poses)){
+            return "Invalid file";
+        }
+        if (!pipeline->Start(poses)){
+            return pipeline->isRunning() ? "Already running" : "Invalid settings";
+        }
+        StatusBar->showMessage(tr("Generating snapshot dataset: %1 frames").arg(poses.size()));
+        return "OK";
+
+    } else if (command.compare("Stop", Qt::CaseInsensitive) == 0) {
+        pipeline->Stop();
+        return "OK";
+
+    } else if (command.compare("Status", Qt::CaseInsensitive) == 0) {
+        return pipeline->Status();
+    }
+
+    return "";
+}
+
+
+void PluginSnapshotDataset::PluginEvent(TypeEvent event_type){
+    switch (event_type) {
+    case EventAbout2ChangeStation:
+    case EventAbout2CloseStation:
+        // The temporary camera belongs to the active station
+        if (pipeline != nullptr){
+            pipeline->Stop();
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+
+//----------------------------------------------------------------------------------
+
+void PluginSnapshotDataset::callback_capture_finished(){
+    StatusBar->showMessage(tr("Snapshot dataset captured (%1 of %2 frames), encoding in the background").arg(pipeline->Captured()).arg(pipeline->Total()));
+}
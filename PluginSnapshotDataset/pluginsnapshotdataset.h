@@ -0,0 +1,66 @@
+#ifndef PLUGINSNAPSHOTDATASET_H
+#define PLUGINSNAPSHOTDATASET_H
+
+
+#include <QObject>
+#include <QtPlugin>
+#include "iapprobodk.h"
+#include "robodktypes.h"
+#include "snapshotpipeline.h"
+
+
+class QAction;
+class IRoboDK;
+class IItem;
+
+///
+/// \brief The PluginSnapshotDataset class generates image datasets from a list of camera or view poses.
+/// Snapshots are taken back-to-back and encoded in the background (see \ref SnapshotPipeline).
+///
+class PluginSnapshotDataset : public QObject, IAppRoboDK
+{
+    Q_OBJECT
+    Q_PLUGIN_METADATA(IID "RoboDK.IAppRoboDK")// FILE "metadatalugin.json")
+    Q_INTERFACES(IAppRoboDK)
+
+public:
+    //------------------------------- RoboDK Plug-in Interface commands ------------------------------
+
+    PluginSnapshotDataset();
+
+    QString PluginName(void) override;
+    virtual QString PluginLoad(QMainWindow *mw, QMenuBar *menubar, QStatusBar *statusbar, RoboDK *rdk, const QString &settings="") override;
+    virtual void PluginUnload() override;
+    virtual QString PluginCommand(const QString &command, const QString &value) override;
+    virtual void PluginEvent(TypeEvent event_type) override;
+
+    //----------------------------------------------------------------------------------
+
+    // Recommended pointers to use in your plugin:
+public:
+    /// RoboDK's <strong>main window</strong> pointer.
+    QMainWindow *MainWindow { nullptr };
+
+    /// RoboDK's main <strong>status bar</strong> pointer.
+    QStatusBar *StatusBar { nullptr };
+
+    /// Pointer to the <strong>RoboDK API</strong> interface.
+    RoboDK *RDK { nullptr };
+
+
+public slots:
+    /// Called when all the snapshots of a dataset were taken
+    void callback_capture_finished();
+
+
+private:
+
+    /// Dataset generator
+    SnapshotPipeline *pipeline { nullptr };
+
+    /// Poses of the next dataset
+    QList<Mat> poses;
+};
+
+
+#endif // PLUGINSNAPSHOTDATASET_H
@@ -0,0 +1,291 @@
+#include "snapshotpipeline.h"
+#include "irobodk.h"
+#include "iitem.h"
+
+#include <QDir>
+#include <QFile>
+#include <QTextStream>
+#include <QPainter>
+#include <QRegularExpression>
+#include <QThread>
+#include <QtConcurrent>
+#include <QDebug>
+
+
+// Combine 2 images of the same view with a black and a white background: the pixels that changed from black to white become transparent
+static QImage removeBackground(const QImage &black, const QImage &white){
+    QImage result = black.convertToFormat(QImage::Format_ARGB32);
+    QImage light = white.convertToFormat(QImage::Format_ARGB32);
+    if (light.size() != result.size()){
+        return result;
+    }
+
+    for (int y = 0; y < result.height(); y++){
+        QRgb *dst = reinterpret_cast<QRgb *>(result.scanLine(y));
+        const QRgb *src = reinterpret_cast<const QRgb *>(light.constScanLine(y));
+        for (int x = 0; x < result.width(); x++){
+            QRgb b = dst[x];
+            QRgb w = src[x];
+            bool background = qRed(w) - qRed(b) == 255 && qGreen(w) - qGreen(b) == 255 && qBlue(w) - qBlue(b) == 255;
+            dst[x] = background ? qRgba(0, 0, 0, 0) : qRgba(qRed(b), qGreen(b), qBlue(b), 255);
+        }
+    }
+    return result;
+}
+
+// Crop an image to the bounding box of its opaque pixels, keeping one pixel around it. Optionally pad the result to the ratio of the original image.
+static QImage boundingBox(const QImage &image, bool keep_ratio){
+    int min_x = image.width();
+    int min_y = image.height();
+    int max_x = -1;
+    int max_y = -1;
+    for (int y = 0; y < image.height(); y++){
+        const QRgb *line = reinterpret_cast<const QRgb *>(image.constScanLine(y));
+        for (int x = 0; x < image.width(); x++){
+            if (qAlpha(line[x]) != 0){
+                min_x = qMin(min_x, x);
+                max_x = qMax(max_x, x);
+                min_y = qMin(min_y, y);
+                max_y = qMax(max_y, y);
+            }
+        }
+    }
+    if (max_x < 0){
+        return image;
+    }
+
+    QRect roi(QPoint(qMax(0, min_x - 1), qMax(0, min_y - 1)), QPoint(qMin(image.width() - 1, max_x + 1), qMin(image.height() - 1, max_y + 1)));
+    QImage cropped = image.copy(roi);
+    if (!keep_ratio){
+        return cropped;
+    }
+
+    // Pad with transparent pixels to get the ratio of the original image
+    double ratio = static_cast<double>(image.height()) / image.width();
+    int width = cropped.width();
+    int height = cropped.height();
+    if (height > width * ratio){
+        width = qRound(height / ratio);
+    } else {
+        height = qRound(width * ratio);
+    }
+    QImage padded(width, height, QImage::Format_ARGB32);
+    padded.fill(Qt::transparent);
+    QPainter painter(&padded);
+    painter.drawImage((width - cropped.width()) / 2, (height - cropped.height()) / 2, cropped);
+    painter.end();
+    return padded;
+}
+
+
+SnapshotPipeline::SnapshotPipeline(RoboDK *rdk, QObject *parent) : QObject(parent), RDK(rdk) {
+    capture_timer.setSingleShot(false);
+    connect(&capture_timer, SIGNAL(timeout()), this, SLOT(captureNext()));
+}
+
+SnapshotPipeline::~SnapshotPipeline(){
+    Stop();
+    waitForDone();
+}
+
+bool SnapshotPipeline::LoadPoses(const QString &filename, QList<Mat> &poses){
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)){
+        qDebug() << "Unable to open pose file: " << filename;
+        return false;
+    }
+
+    poses.clear();
+    QTextStream stream(&file);
+    int line_number = 0;
+    while (!stream.atEnd()){
+        QString line = stream.readLine().trimmed();
+        line_number++;
+        if (line.isEmpty() || line.startsWith('#')){
+            continue;
+        }
+
+        QStringList fields = line.split(QRegularExpression("[,;\\s]+"));
+        fields.removeAll(QString());
+        double values[16];
+        bool ok = fields.size() == 6 || fields.size() == 16;
+        for (int i = 0; ok && i < fields.size(); i++){
+            values[i] = fields[i].toDouble(&ok);
+        }
+        if (!ok){
+            qDebug() << "Invalid pose on line " << line_number << " of " << filename;
+            return false;
+        }
+
+        if (fields.size() == 6){
+            poses.append(Mat::XYZRPW_2_Mat(values[0], values[1], values[2], values[3], values[4], values[5]));
+        } else {
+            poses.append(Mat(values));
+        }
+    }
+    return !poses.isEmpty();
+}
+
+bool SnapshotPipeline::Start(const QList<Mat> &pose_list){
+    if (isRunning() || pose_list.isEmpty() || settings.output_dir.isEmpty()){
+        return false;
+    }
+    if (!QDir().mkpath(settings.output_dir)){
+        qDebug() << "Unable to create the output directory: " << settings.output_dir;
+        return false;
+    }
+    if (!settings.view_mode && !createCameras()){
+        return false;
+    }
+
+    poses = pose_list;
+    next = 0;
+    captured = 0;
+    encoded = 0;
+    failed = 0;
+
+    pool.setMaxThreadCount(settings.workers > 0 ? settings.workers : qMax(1, QThread::idealThreadCount() - 1));
+
+    capturing = true;
+    capture_timer.start(0);
+    qDebug() << "Snapshot dataset started: " << poses.size() << " frames with " << pool.maxThreadCount() << " workers";
+    return true;
+}
+
+void SnapshotPipeline::Stop(){
+    if (!capturing){
+        return;
+    }
+    finishCapture();
+}
+
+void SnapshotPipeline::waitForDone(){
+    pool.waitForDone();
+}
+
+QString SnapshotPipeline::Status() const {
+    QString state = isRunning() ? "RUNNING" : (poses.isEmpty() ? "IDLE" : "DONE");
+    return QString("%1 %2 %3 %4 %5").arg(state).arg(captured).arg(encoded.load()).arg(failed.load()).arg(poses.size());
+}
+
+bool SnapshotPipeline::createCameras(){
+    camera_frame = RDK->AddFrame("Snapshot Dataset Frame");
+    if (camera_frame == nullptr){
+        return false;
+    }
+    camera_frame->setVisible(false);
+
+    if (settings.remove_background){
+        camera_black = RDK->Cam2D_Add(camera_frame, settings.camera_params + " BG_COLOR=black MINIMIZED");
+        camera_white = RDK->Cam2D_Add(camera_frame, settings.camera_params + " BG_COLOR=white MINIMIZED");
+    } else {
+        camera_black = RDK->Cam2D_Add(camera_frame, settings.camera_params + " MINIMIZED");
+    }
+    if (camera_black == nullptr || (settings.remove_background && camera_white == nullptr)){
+        qDebug() << "Unable to create the snapshot camera";
+        deleteCameras();
+        return false;
+    }
+    return true;
+}
+
+void SnapshotPipeline::deleteCameras(){
+    if (camera_white != nullptr && RDK->Valid(camera_white)){
+        camera_white->Delete();
+    }
+    if (camera_black != nullptr && RDK->Valid(camera_black)){
+        camera_black->Delete();
+    }
+    if (camera_frame != nullptr && RDK->Valid(camera_frame)){
+        camera_frame->Delete();
+    }
+    camera_white = nullptr;
+    camera_black = nullptr;
+    camera_frame = nullptr;
+}
+
+void SnapshotPipeline::finishCapture(){
+    capture_timer.stop();
+    capturing = false;
+    deleteCameras();
+    qDebug() << "Snapshot dataset captured: " << Status();
+    emit captureFinished();
+}
+
+void SnapshotPipeline::captureNext(){
+    if (next >= poses.size()){
+        finishCapture();
+        return;
+    }
+
+    // Backpressure: wait for the workers when the queue is full (check again in 1 ms instead of spinning)
+    if (in_flight.load() >= qMax(1, settings.queue_size)){
+        capture_timer.setInterval(1);
+        return;
+    }
+    capture_timer.setInterval(0);
+
+    const Mat &pose = poses[next];
+    QImage image;
+    QImage white;
+    if (settings.view_mode){
+        RDK->setViewPose(pose);
+        image = RDK->Cam2D_Snapshot("", nullptr);
+    } else {
+        camera_frame->setPose(pose);
+        RDK->Render(RoboDK::RenderUpdateOnly);
+        image = RDK->Cam2D_Snapshot("", camera_black);
+        if (settings.remove_background){
+            white = RDK->Cam2D_Snapshot("", camera_white);
+        }
+    }
+
+    if (image.isNull()){
+        failed++;
+    } else {
+        captured++;
+        in_flight++;
+        QString filename = QDir(settings.output_dir).filePath(QString("frame_%1.%2").arg(next, 6, 10, QChar('0')).arg(settings.format));
+        snapshot_settings_t frame_settings = settings;
+        QtConcurrent::run(&pool, [this, image, white, frame_settings, filename](){
+            if (ProcessFrame(image, white, frame_settings, filename)){
+                encoded++;
+            } else {
+                failed++;
+            }
+            in_flight--;
+        });
+    }
+    next++;
+}
+
+bool SnapshotPipeline::ProcessFrame(const QImage &image, const QImage &white, const snapshot_settings_t &settings, const QString &filename){
+    QImage result = image;
+    if (settings.remove_background && !white.isNull()){
+        result = removeBackground(image, white);
+        if (settings.crop){
+            result = boundingBox(result, settings.keep_ratio);
+        }
+    }
+
+    if (settings.output_size.isValid() && result.size() != settings.output_size){
+        result = result.scaled(settings.output_size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    }
+
+    // JPEG has no transparency: use a white background
+    QByteArray format = settings.format.toUpper().toLatin1();
+    if (result.hasAlphaChannel() && (format == "JPG" || format == "JPEG")){
+        QImage opaque(result.size(), QImage::Format_RGB32);
+        opaque.fill(Qt::white);
+        QPainter painter(&opaque);
+        painter.drawImage(0, 0, result);
+        painter.end();
+        result = opaque;
+    }
+
+    if (!result.save(filename, format.constData(), settings.quality)){
+        qDebug() << "Unable to save snapshot: " << filename;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,132 @@
+#ifndef SNAPSHOTPIPELINE_H
+#define SNAPSHOTPIPELINE_H
+
+
+#include <QObject>
+#include <QImage>
+#include <QSize>
+#include <QTimer>
+#include <QThreadPool>
+#include "robodktypes.h"
+
+#include <atomic>
+
+
+/// Settings of a snapshot dataset
+struct snapshot_settings_t
+{
+    /// True to take snapshots of the main 3D view (the poses are view poses), false to use a simulated camera (the poses are camera poses)
+    bool view_mode { false };
+
+    /// Parameters of the simulated camera (see Cam2D_Add)
+    QString camera_params { "SIZE=640x480" };
+
+    /// Remove the background (requires 2 snapshots per frame: black and white background)
+    bool remove_background { false };
+
+    /// Crop the images to the region of interest (requires removing the background)
+    bool crop { false };
+
+    /// Keep the ratio of the original image when cropping
+    bool keep_ratio { true };
+
+    /// Size of the saved images. Leave invalid to keep the size of the snapshot.
+    QSize output_size;
+
+    /// Directory and format of the saved images ("png" or "jpg")
+    QString output_dir;
+    QString format { "png" };
+
+    /// Quality of the saved images (0 to 100, -1 for the default)
+    int quality { -1 };
+
+    /// Number of worker threads and maximum number of frames waiting to be encoded
+    int workers { 0 };
+    int queue_size { 16 };
+};
+
+
+///
+/// \brief The SnapshotPipeline class generates a dataset of images from a list of poses.
+/// Snapshots are taken back-to-back on the GUI thread (the RoboDK API is not thread safe).
+/// Each image is then processed (background removal, cropping, resizing) and encoded by a pool of worker threads.
+/// The number of frames waiting for a worker is bounded: capture pauses when the workers fall behind.
+///
+class SnapshotPipeline : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SnapshotPipeline(RoboDK *rdk, QObject *parent = nullptr);
+    ~SnapshotPipeline();
+
+    /// \brief Load a list of poses from a text file, one pose per line.
+    /// A line has 6 values (x,y,z,r,p,w in mm and deg, see Mat::XYZRPW_2_Mat) or 16 values (column-major, see Mat(const double[16])).
+    /// Values can be separated by commas or spaces. Lines starting with # are ignored.
+    static bool LoadPoses(const QString &filename, QList<Mat> &poses);
+
+    /// Settings used by the next call to \ref Start
+    snapshot_settings_t &Settings() { return settings; }
+
+    /// Start generating the dataset. Returns false if already running or if the settings are invalid.
+    bool Start(const QList<Mat> &poses);
+
+    /// Stop taking snapshots. Frames already captured are still encoded.
+    void Stop();
+
+    /// Wait until all captured frames are encoded
+    void waitForDone();
+
+    /// Returns true while snapshots are being taken
+    bool isCapturing() const { return capturing; }
+
+    /// Returns true while snapshots are being taken or encoded
+    bool isRunning() const { return capturing || in_flight.load() > 0; }
+
+    /// Progress of the current (or last) dataset
+    int Total() const { return poses.size(); }
+    int Captured() const { return captured; }
+    int Encoded() const { return encoded.load(); }
+    int Failed() const { return failed.load(); }
+
+    /// Status string: RUNNING, DONE or IDLE followed by captured, encoded, failed and total frames
+    QString Status() const;
+
+    /// Process and save one frame (runs on a worker thread)
+    static bool ProcessFrame(const QImage &image, const QImage &white, const snapshot_settings_t &settings, const QString &filename);
+
+signals:
+    /// Emitted when all snapshots were taken
+    void captureFinished();
+
+private slots:
+    void captureNext();
+
+private:
+    bool createCameras();
+    void deleteCameras();
+    void finishCapture();
+
+    RoboDK *RDK { nullptr };
+    snapshot_settings_t settings;
+
+    QList<Mat> poses;
+    int next { 0 };
+    int captured { 0 };
+    bool capturing { false };
+
+    /// Temporary items used in camera mode
+    Item camera_frame { nullptr };
+    Item camera_black { nullptr };
+    Item camera_white { nullptr };
+
+    QTimer capture_timer;
+    QThreadPool pool;
+
+    std::atomic<int> in_flight { 0 };
+    std::atomic<int> encoded { 0 };
+    std::atomic<int> failed { 0 };
+};
+
+
+#endif // SNAPSHOTPIPELINE_H